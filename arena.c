@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+Arena* arena_create(){
+    Arena* a = (Arena*)malloc(sizeof(Arena));
+    if (!a){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    a->head=NULL;
+    a->total=0;
+
+    return a;
+}
+
+//size is already aligned, oversized requests get a block of their own
+void* arena_alloc_slow(Arena* a, size_t size){
+    size_t block_size = size>ARENA_BLOCK ? size : ARENA_BLOCK;
+
+    ArenaBlock* b = (ArenaBlock*)aligned_alloc(ARENA_ALIGN, (sizeof(ArenaBlock)+block_size+ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1));
+    if (!b){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    b->size=block_size;
+    b->used=size;
+
+    if (a->head && block_size>ARENA_BLOCK){//keep bumping the current block
+        b->prev=a->head->prev;
+        a->head->prev=b;
+    } else {
+        b->prev=a->head;
+        a->head=b;
+    }
+
+    a->total+=size;
+    return b->data;
+}
+
+void* arena_calloc(Arena* a, size_t size){
+    void* p = arena_alloc(a, size);
+    memset(p, 0, size);
+    return p;
+}
+
+void arena_free(Arena* a){
+    if (!a) return;
+
+    ArenaBlock* b = a->head;
+    while (b){
+        ArenaBlock* prev = b->prev;
+        free(b);
+        b=prev;
+    }
+
+    free(a);
+}
@@ -0,0 +1,43 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//bump allocator, everything is released at once by arena_free()
+
+#define ARENA_BLOCK (64*1024)
+#define ARENA_ALIGN 16
+
+typedef struct ArenaBlock {
+    struct ArenaBlock* prev;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+} ArenaBlock;
+
+typedef struct {
+    ArenaBlock* head;//block being bumped, older blocks hang off prev
+    size_t total;//bytes handed out
+} Arena;
+
+Arena* arena_create();
+void* arena_alloc_slow(Arena* a, size_t size);
+void* arena_calloc(Arena* a, size_t size);
+void arena_free(Arena* a);
+
+static inline void* arena_alloc(Arena* a, size_t size){
+    size = (size+ARENA_ALIGN-1) & ~(size_t)(ARENA_ALIGN-1);
+
+    ArenaBlock* b = a->head;
+    if (b && b->size-b->used>=size){
+        void* p = b->data+b->used;
+        b->used+=size;
+        a->total+=size;
+        return p;
+    }
+
+    return arena_alloc_slow(a, size);
+}
+
+#endif
@@ -2,209 +2,439 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <stdarg.h>
 
 #include "ast.h"
-#include "map.h"
+#include "jit.h"
+#include "batch.h"
+#include "par.h"
 
-ScopeData* curr_scope = NULL;//global scope
+__thread AstPool* ast_pool = NULL;
 
-static ASTNode* create_node(){
-    ASTNode* n = (ASTNode*)malloc(sizeof(ASTNode));
+static void* ast_alloc(size_t size){
+    if (!ast_pool){
+        fprintf(stderr, "error: AST node created outside of a program\n");
+        exit(EXIT_FAILURE);
+    }
 
-    n->left=NULL;
-    n->right=NULL;
+    return arena_alloc(ast_pool->arena, size);
+}
 
-    if (!n){
-        fprintf(stderr, "memory allocation failed\n");
+//first id of a fresh chunk. worker views register theirs in the program
+//pool's table, so ids stay valid everywhere while each worker fills its own
+static NodeId claim_chunk(AstPool* pool){
+    AstPool* owner = pool->shared ? pool->shared : pool;
+    ASTNode* chunk = (ASTNode*)arena_alloc(pool->arena, sizeof(ASTNode)*NODE_CHUNK);
+
+    if (pool->shared) pthread_mutex_lock(&owner->lock);
+
+    if (owner->chunk_count==owner->chunk_capacity){//outgrown tables stay in the arena, views may still read them
+        ASTNode** grown = (ASTNode**)arena_alloc(owner->arena, sizeof(ASTNode*)*owner->chunk_capacity*2);
+        memcpy(grown, owner->chunks, sizeof(ASTNode*)*owner->chunk_count);
+        owner->chunks=grown;
+        owner->chunk_capacity*=2;
+    }
+
+    uint32_t c = owner->chunk_count++;
+    owner->chunks[c]=chunk;
+    pool->chunks=owner->chunks;
+
+    if (pool->shared) pthread_mutex_unlock(&owner->lock);
+
+    return c<<NODE_CHUNK_SHIFT;
+}
+
+static void init_syms(AstPool* pool){
+    pool->sym_capacity=64;
+    pool->syms=(char**)arena_alloc(pool->arena, sizeof(char*)*pool->sym_capacity);
+    pool->syms[0]="";
+    pool->sym_count=1;
+    pool->sym_mask=127;
+    pool->sym_slots=(SymId*)arena_calloc(pool->arena, sizeof(SymId)*(pool->sym_mask+1));
+}
+
+static AstPool* create_pool(){
+    Arena* arena = arena_create();
+    AstPool* pool = (AstPool*)arena_calloc(arena, sizeof(AstPool));
+
+    pool->arena=arena;
+    pool->chunk_capacity=16;
+    pool->chunks=(ASTNode**)arena_alloc(arena, sizeof(ASTNode*)*pool->chunk_capacity);
+    pool->chunk_count=0;
+    claim_chunk(pool);
+    pool->node_count=1;//id 0 stays unused as the null node
+
+    init_syms(pool);
+    pthread_mutex_init(&pool->lock, NULL);
+
+    return pool;
+}
+
+//node_count is the next free id, a new chunk is claimed whenever it runs off the end of one
+static NodeId create_node(){
+    AstPool* pool = ast_pool;
+    if (!pool){
+        fprintf(stderr, "error: AST node created outside of a program\n");
         exit(EXIT_FAILURE);
     }
 
-    return n;
+    NodeId id = pool->node_count;
+    if (!(id & (NODE_CHUNK-1))) id=claim_chunk(pool);
+    pool->node_count=id+1;
+
+    ASTNode* n = ast_node(id);
+    n->op=0;
+    n->vtype=0;
+    n->sym=0;
+    n->left=0;
+    n->right=0;
+
+    return id;
 }
 
-ASTNode* create_dec_node_num(ASTNode* expr, const char id[VAR_LEN]){
-    ASTNode* n = (ASTNode*)malloc(sizeof(ASTNode));
+void join_ast_pool(AstPool* program){
+    Arena* arena = arena_create();
+    AstPool* view = (AstPool*)arena_calloc(arena, sizeof(AstPool));
 
-    n->val.num=0;
-    strcpy(n->val.id, id);
-    n->type=NUM_DEC;
-    n->left=expr;
-    n->right=NULL;
+    view->arena=arena;
+    view->node_count=0;//claims a chunk on the first node
+    view->shared=program;
+    init_syms(view);
 
-    return n;
+    pthread_mutex_lock(&program->lock);
+    view->next_worker=program->workers;
+    program->workers=view;
+    pthread_mutex_unlock(&program->lock);
+
+    ast_pool=view;
 }
 
-ASTNode* create_ref_node_num(const char id[VAR_LEN]){
-    ASTNode* n = (ASTNode*)malloc(sizeof(ASTNode));
+static uint32_t hash_id(const char* id, size_t len){
+    uint32_t hash = 2166136261u;
+    for (size_t i=0; i<len; i++){
+        hash ^= (unsigned char)id[i];
+        hash *= 16777619u;
+    }
 
-    n->type=NUM_REF;
-    n->left=NULL; n->right=NULL;
-    strcpy(n->val.id, id);
+    return hash;
+}
 
-    return n;
+static SymId intern_in(AstPool* pool, const char* id, size_t len){
+    uint32_t slot = hash_id(id, len) & pool->sym_mask;
+    while (pool->sym_slots[slot]){
+        const char* name = pool->syms[pool->sym_slots[slot]];
+        if (strncmp(name, id, len)==0 && name[len]=='\0') return pool->sym_slots[slot];
+        slot = (slot+1) & pool->sym_mask;
+    }
+
+    if (pool->sym_count==pool->sym_capacity){
+        char** grown = (char**)arena_alloc(pool->arena, sizeof(char*)*pool->sym_capacity*2);
+        memcpy(grown, pool->syms, sizeof(char*)*pool->sym_count);
+        pool->syms=grown;
+        pool->sym_capacity*=2;
+    }
+
+    char* name = (char*)arena_alloc(pool->arena, len+1);
+    memcpy(name, id, len);
+    name[len]='\0';
+
+    SymId sym = pool->sym_count++;
+    pool->syms[sym]=name;
+    pool->sym_slots[slot]=sym;
+
+    if (pool->sym_count*2>pool->sym_mask){//keep the table at most half full
+        uint32_t mask = pool->sym_mask*2+1;
+        SymId* slots = (SymId*)arena_calloc(pool->arena, sizeof(SymId)*(mask+1));
+
+        for (SymId s=1; s<pool->sym_count; s++){
+            uint32_t i = hash_id(pool->syms[s], strlen(pool->syms[s])) & mask;
+            while (slots[i]) i = (i+1) & mask;
+            slots[i]=s;
+        }
+
+        pool->sym_slots=slots;
+        pool->sym_mask=mask;
+    }
+
+    return sym;
 }
 
-ASTNode* create_var_ref_node(const char id[VAR_LEN]){
-    ASTNode* n = create_node();
+//ids are interned straight from the source view, truncated to VAR_LEN-1
+SymId intern_sym(const char* id, size_t len){
+    AstPool* pool = ast_pool;
+    if (len>VAR_LEN-1) len=VAR_LEN-1;
+
+    if (!pool->shared) return intern_in(pool, id, len);
+
+    //views keep a table of their own in front of the program's, so the
+    //lock is only taken for names this worker has not seen yet
+    uint32_t seen = pool->sym_count;
+    SymId local = intern_in(pool, id, len);
+    if (pool->sym_count==seen) return pool->shared_ids[local];
+
+    if (local>=pool->shared_ids_capacity){
+        uint32_t capacity = pool->sym_capacity;
+        SymId* grown = (SymId*)arena_alloc(pool->arena, sizeof(SymId)*capacity);
+        if (pool->shared_ids) memcpy(grown, pool->shared_ids, sizeof(SymId)*pool->shared_ids_capacity);
+        pool->shared_ids=grown;
+        pool->shared_ids_capacity=capacity;
+    }
 
-    n->type=VAR_REF;
-    strcpy(n->val.id, id);
-    return n;
+    pthread_mutex_lock(&pool->shared->lock);
+    pool->shared_ids[local]=intern_in(pool->shared, id, len);
+    pthread_mutex_unlock(&pool->shared->lock);
+
+    return pool->shared_ids[local];
 }
 
-ASTNode* create_macro_node(MacroT t, ASTNode* left){
-    ASTNode* n = (ASTNode*)malloc(sizeof(ASTNode));
-    n->type=MACRO;
-    n->val.mtype=t;
+static NodeId create_sym_node(ASTNodeT type, const char* id, size_t len, NodeId left){
+    NodeId i = create_node();
+    ASTNode* n = ast_node(i);
 
+    n->type=type;
+    n->sym=intern_sym(id, len);
     n->left=left;
-    n->right=NULL;
 
-    return n;
+    return i;
 }
 
-ASTNode* create_num_node(double x){
-    ASTNode* new = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!new) {
-        fprintf(stderr, "memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+NodeId create_dec_node_num(NodeId expr, const char* id, size_t len){
+    return create_sym_node(NUM_DEC, id, len, expr);
+}
+
+NodeId create_ref_node_num(const char* id, size_t len){
+    return create_sym_node(NUM_REF, id, len, 0);
+}
+
+NodeId create_var_ref_node(const char* id, size_t len){
+    return create_sym_node(VAR_REF, id, len, 0);
+}
+
+NodeId create_macro_node(MacroT t, NodeId left){
+    NodeId i = create_node();
+    ASTNode* n = ast_node(i);
+
+    n->type=MACRO;
+    n->op=t;
+    n->left=left;
+
+    return i;
+}
 
-    new->type=NUM_VAL;
-    new->val.num=x;
-    new->left=NULL;
-    new->right=NULL;
+NodeId create_num_node(double x){
+    NodeId i = create_node();
+    ASTNode* n = ast_node(i);
 
-    return new;
+    n->type=NUM_VAL;
+    n->val.num=x;
+
+    return i;
 }
 
-ASTNode* create_bool_node(int x){
-    ASTNode* n = create_node();
+NodeId create_bool_node(int x){
+    NodeId i = create_node();
+    ASTNode* n = ast_node(i);
+
     n->type=BOOL_VAL;
     n->val.bool_val=x;
 
-    return n;
+    return i;
 }
 
-ASTNode* create_dec_node_bool(ASTNode* expr, const char id[VAR_LEN]){
-    ASTNode* n = create_node();
+NodeId create_dec_node_bool(NodeId expr, const char* id, size_t len){
+    return create_sym_node(BOOL_DEC, id, len, expr);
+}
 
-    strcpy(n->val.id, id);
-    n->type=BOOL_DEC;
-    n->left=expr;
+NodeId create_ref_node_bool(const char* id, size_t len){
+    return create_sym_node(BOOL_REF, id, len, 0);
+}
 
-    return n;
+static BinOpT bin_op_level(BinOpT t){
+    if (t==MINUS) return PLUS;
+    if (t==DIV) return MULT;
+    return t;
 }
 
-ASTNode* create_ref_node_bool(const char id[VAR_LEN]){
-    ASTNode* n = create_node();
+static void nary_push(NaryData* nary, NodeId arg, BinOpT t){
+    if (nary->count==nary->capacity){//outgrown arrays stay in the arena
+        uint32_t capacity = nary->capacity*2;
+        NodeId* args = (NodeId*)ast_alloc(sizeof(NodeId)*capacity);
+        uint8_t* ops = (uint8_t*)ast_alloc(capacity);
+
+        memcpy(args, nary->args, sizeof(NodeId)*nary->count);
+        memcpy(ops, nary->ops, nary->count);
+        nary->args=args;
+        nary->ops=ops;
+        nary->capacity=capacity;
+    }
 
-    n->type=BOOL_REF;
-    strcpy(n->val.id, id);
+    nary->args[nary->count]=arg;
+    nary->ops[nary->count]=t;
+    nary->count++;
+}
 
-    return n;
+//turns the B_OP n into an N_OP holding its two operands in evaluation order
+static void nary_from_bin_op(ASTNode* n){
+    NaryData* nary = (NaryData*)ast_alloc(sizeof(NaryData));
+    nary->count=0;
+    nary->capacity=8;
+    nary->args=(NodeId*)ast_alloc(sizeof(NodeId)*nary->capacity);
+    nary->ops=(uint8_t*)ast_alloc(nary->capacity);
+
+    BinOpT t = n->op;
+    if (t==POW){
+        nary_push(nary, n->right, POW);
+        nary_push(nary, n->left, POW);
+    } else {
+        nary_push(nary, n->left, t);
+        nary_push(nary, n->right, t);
+    }
+
+    n->type=N_OP;
+    n->op=bin_op_level(t);
+    n->val.nary=nary;
 }
 
-ASTNode* create_bin_op_node(BinOpT t, ASTNode* left, ASTNode* right){
-    ASTNode* new = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!new){
-        fprintf(stderr, "memory allocatin failed\n");
-        exit(EXIT_FAILURE);
+NodeId create_bin_op_node(BinOpT t, NodeId left, NodeId right){
+    //(a+b)+c is a+b+c and a**(b**c) is a**b**c, so the chain grows on the
+    //side the operator associates to and no deep spine is built
+    BinOpT level = bin_op_level(t);
+    NodeId chain = level==POW ? right : left;
+    NodeId arg = level==POW ? left : right;
+
+    ASTNode* c = ast_node(chain);
+    if (c->type==B_OP && bin_op_level(c->op)==level) nary_from_bin_op(c);
+    if (c->type==N_OP && c->op==level){
+        nary_push(c->val.nary, arg, t);
+        return chain;
     }
 
-    new->type=B_OP;
-    new->left=left;
-    new->right=right;
-    new->val.type=t;
+    NodeId i = create_node();
+    ASTNode* n = ast_node(i);
 
-    return new;
+    n->type=B_OP;
+    n->op=t;
+    n->left=left;
+    n->right=right;
+
+    return i;
 }
 
-ASTNode* create_cond_node(CondT t, ASTNode* l, ASTNode* r){
-    ASTNode* n = (ASTNode*)malloc(sizeof(ASTNode));
+NodeId create_hoist_node(NodeId expr){
+    NodeId i = create_node();
+    ASTNode* n = ast_node(i);
 
-    if (!n){
-        fprintf(stderr, "memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+    n->type=HOIST;
+    n->left=expr;
+
+    return i;
+}
+
+NodeId create_induction_node(NodeId expr, const double* init, uint32_t degree){
+    NodeId i = create_node();
+    InductionData* data = (InductionData*)ast_alloc(sizeof(InductionData));
+    memcpy(data->init, init, sizeof(data->init));
+    memcpy(data->v, init, sizeof(data->v));
+    data->degree=degree;
+
+    ASTNode* n = ast_node(i);
+    n->type=INDUCTION;
+    n->left=expr;
+    n->val.ind=data;
+
+    return i;
+}
+
+NodeId create_native_node(NodeId loop, struct JitLoop* code){
+    NodeId i = create_node();
+    ASTNode* n = ast_node(i);
+
+    n->type=NATIVE;
+    n->left=loop;
+    n->val.native=code;
+
+    return i;
+}
+
+NodeId create_batch_node(NodeId loop, struct BatchLoop* batch){
+    NodeId i = create_node();
+    ASTNode* n = ast_node(i);
+
+    n->type=BATCH;
+    n->left=loop;
+    n->val.batch=batch;
+
+    return i;
+}
+
+NodeId copy_node(NodeId id){
+    NodeId i = create_node();
+    *ast_node(i)=*ast_node(id);
+    return i;
+}
+
+NodeId create_cond_node(CondT t, NodeId l, NodeId r){
+    NodeId i = create_node();
+    ASTNode* n = ast_node(i);
 
     n->type=COND;
+    n->op=t;
     n->left=l;
     n->right=r;
-    n->val.ctype=t;
 
-    return n;
+    return i;
 }
 
-ASTNode* create_if_node(ASTNode* cond, ASTNode* code){
-    ASTNode* n = create_node();
+NodeId create_if_node(NodeId cond, NodeId code){
+    NodeId i = create_node();
+    NodeId body = code;
+
+    ASTNodeT code_type = ast_node(code)->type;
+    if (code_type!=SCOPE && code_type!=BLOCK){
+        body = create_scope_node(NULL);
+        add_stmt_to_scope(body, code);
+    }
 
+    ASTNode* n = ast_node(i);
     n->type=IF;
     n->left=cond;
+    n->right=body;
 
-    if (code->type!=SCOPE && code->type!=BLOCK){
-        ASTNode* scope_node = create_scope_node(NULL);
-
-        add_stmt_to_scope(scope_node, code);
-        n->right=scope_node;
-    } else {
-        n->right=code;
-    }
-
-    return n;
+    return i;
 }
 
-ASTNode* create_loop_node(ASTNode* code, const char iter[VAR_LEN], int start, int end){
-    ASTNode* n = create_node();
-    n->type=LOOP;
-    n->val.max_loop=end;
-    strcpy(n->val.id, iter);
+NodeId create_loop_node(NodeId code, const char* iter, size_t len, int start, int end){
+    NodeId i = create_node();
 
-    ASTNode* scope_node = create_scope_node(NULL);
-    ASTNode* iter_dec = create_dec_node_num(create_num_node(start), iter); //initializing the iter var
+    NodeId scope_node = create_scope_node(NULL);
+    NodeId iter_dec = create_dec_node_num(create_num_node(start), iter, len); //initializing the iter var
 
     add_stmt_to_scope(scope_node, iter_dec);
 
-    if (code->type!=SCOPE && code->type != BLOCK){
+    ASTNode* code_node = ast_node(code);
+    if (code_node->type!=SCOPE && code_node->type != BLOCK){
         add_stmt_to_scope(scope_node, code);
     } else {
-        for (int i=0; i<code->val.scope->stmt_count; i++){
-            add_stmt_to_scope(scope_node, code->val.scope->statements[i]);
+        for (int s=0; s<code_node->val.scope->stmt_count; s++){
+            add_stmt_to_scope(scope_node, code_node->val.scope->statements[s]);
         }
     }
 
+    ASTNode* n = ast_node(i);
+    n->type=LOOP;
+    n->sym=intern_sym(iter, len);
+    n->val.num=end;
     n->right = scope_node;
-    return n;
-}
 
-ASTNode* create_reassign_node_num(const char id[VAR_LEN], ASTNode* expr){
-    ASTNode* n = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!n){
-        fprintf(stderr, "memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
-
-    n->type=NUM_REASSIGN;
-    strcpy(n->val.id, id);
-    n->left = expr;
-    n->right = NULL;
-
-    return n;
+    return i;
 }
 
-ASTNode* create_reassign_node_bool(const char id[VAR_LEN], ASTNode* expr){
-    ASTNode* n = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!n){
-        fprintf(stderr, "memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
-
-    n->type=BOOL_REASSIGN;
-    strcpy(n->val.id, id);
-    n->left = expr;
-    n->right = NULL;
+NodeId create_reassign_node_num(const char* id, size_t len, NodeId expr){
+    return create_sym_node(NUM_REASSIGN, id, len, expr);
+}
 
-    return n;
+NodeId create_reassign_node_bool(const char* id, size_t len, NodeId expr){
+    return create_sym_node(BOOL_REASSIGN, id, len, expr);
 }
 
 ExecutionContext* create_execution_context(){
@@ -214,7 +444,9 @@ ExecutionContext* create_execution_context(){
         exit(EXIT_FAILURE);
     }
     ctx->curr_scope=NULL;
-    ctx->global_vars=create_map();
+    ctx->undo=NULL;
+    ctx->out=NULL;
+    ctx->worker=0;
     return ctx;
 }
 
@@ -222,23 +454,26 @@ ExecutionContext* create_execution_context(){
 
 
 ScopeData* init_scope_data(ScopeData* parent){
-    ScopeData* scope = (ScopeData*)malloc(sizeof(ScopeData));
-    if (!scope){
-        fprintf(stderr, "memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
+    ScopeData* scope = (ScopeData*)ast_alloc(sizeof(ScopeData));
 
-    scope->variables=create_map();
+    scope->frame=NULL;//sized by resolve()
+    scope->slot_info=NULL;
+    scope->slot_count=0;
+    scope->slot_capacity=0;
+    scope->worker_stride=0;
     scope->statements=NULL;
     scope->stmt_count=0;
+    scope->stmt_capacity=0;
     scope->parent=parent;
+    scope->arena=ast_pool->arena;
+    scope->pool=NULL;
 
     return scope;
 }
 
-ASTNode* create_block_node(ASTNode** statements, int count, ScopeData* parent_scope){
-    ASTNode* node = create_scope_node(parent_scope);
-    node->type=BLOCK;
+NodeId create_block_node(NodeId* statements, int count, ScopeData* parent_scope){
+    NodeId node = create_scope_node(parent_scope);
+    ast_node(node)->type=BLOCK;
 
     for (int i=0; i<count; i++){
         add_stmt_to_scope(node, statements[i]);
@@ -247,86 +482,238 @@ ASTNode* create_block_node(ASTNode** statements, int count, ScopeData* parent_sc
     return node;
 }
 
-ASTNode* create_scope_node(ScopeData* parent) {
-    ASTNode* n = create_node();
+//root of a program, owns the pool everything below it is allocated from
+NodeId create_program_node(){
+    ast_pool = create_pool();
 
-    n->type = SCOPE;
-    n->left = NULL;
-    n->right = NULL;
-    n->val.scope = init_scope_data(parent);
+    NodeId n = create_scope_node(NULL);
+    ast_node(n)->val.scope->pool=ast_pool;
 
     return n;
 }
 
-void add_stmt_to_scope(ASTNode *scope, ASTNode *stmt){
-    if (scope->type!=SCOPE && scope->type!=BLOCK){
+NodeId create_scope_node(ScopeData* parent) {
+    NodeId i = create_node();
+    ScopeData* data = init_scope_data(parent);
+
+    ASTNode* n = ast_node(i);
+    n->type = SCOPE;
+    n->val.scope = data;
+
+    return i;
+}
+
+void add_stmt_to_scope(NodeId scope, NodeId stmt){
+    ASTNode* n = ast_node(scope);
+    if (n->type!=SCOPE && n->type!=BLOCK){
         fprintf(stderr, "not a scope or a block node\n");
         return;
     }
 
-    ScopeData* scoped = scope->val.scope;
+    ScopeData* scoped = n->val.scope;
 
-    scoped->stmt_count++;
-    scoped->statements=(ASTNode**)realloc(scoped->statements, sizeof(ASTNode*) * scoped->stmt_count);
+    if (scoped->stmt_count==scoped->stmt_capacity){//outgrown lists stay in the arena
+        int capacity = scoped->stmt_capacity ? scoped->stmt_capacity*2 : 4;
+        NodeId* grown = (NodeId*)arena_alloc(scoped->arena, sizeof(NodeId)*capacity);
 
-    if (!scoped){
-        fprintf(stderr, "memory allocation failed\n");
-        exit(EXIT_FAILURE);
+        if (scoped->stmt_count) memcpy(grown, scoped->statements, sizeof(NodeId)*scoped->stmt_count);
+        scoped->statements=grown;
+        scoped->stmt_capacity=capacity;
+    }
+
+    scoped->statements[scoped->stmt_count++]=stmt;
+}
+
+static void undo_save(UndoLog* log, Slot* slot){
+    if (log->count==log->capacity){
+        log->capacity = log->capacity ? log->capacity*2 : 256;
+        log->entries=(UndoEntry*)realloc(log->entries, sizeof(UndoEntry)*log->capacity);
+        if (!log->entries){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
     }
 
-    scoped->statements[scoped->stmt_count-1]=stmt;
+    UndoEntry* e = &log->entries[log->count++];
+    e->slot=slot;
+    e->saved=*slot;
 }
 
-Var* get_var_from_scope(ScopeData* scope, const char id[VAR_LEN]){
-    if (!scope) return NULL;
+static inline size_t undo_hash(Slot* slot){
+    uint64_t h = (uint64_t)((uintptr_t)slot>>3)*0x9E3779B97F4A7C15ull;
+    return (size_t)(h^(h>>32));
+}
 
-    Var* var = get_var(scope->variables, id);
+static void undo_seen_grow(UndoLog* log){
+    UndoSeen* old = log->seen;
+    size_t old_capacity = log->seen_capacity;
 
-    if (!var&&scope->parent){
-        return get_var_from_scope(scope->parent, id);
+    log->seen_capacity = old_capacity ? old_capacity*2 : 256;
+    log->seen=(UndoSeen*)calloc(log->seen_capacity, sizeof(UndoSeen));
+    if (!log->seen){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
     }
 
-    return var;
+    size_t mask = log->seen_capacity-1;
+    for (size_t i=0; i<old_capacity; i++){
+        if (old[i].epoch!=log->epoch) continue;
+
+        size_t j = undo_hash(old[i].slot)&mask;
+        while (log->seen[j].epoch==log->epoch) j=(j+1)&mask;
+        log->seen[j]=old[i];
+    }
+    free(old);
 }
 
-void add_num_var_to_scope(ScopeData *scope, const char *id, double val){
-    if (!scope){
-        fprintf(stderr, "error: NULL scope\n");
-        exit(EXIT_FAILURE);
+//whether this is the slot's first write since the last checkpoint
+static int undo_first_write(UndoLog* log, Slot* slot){
+    if (log->seen_count*2>=log->seen_capacity) undo_seen_grow(log);
+
+    size_t mask = log->seen_capacity-1;
+    for (size_t i=undo_hash(slot)&mask; ; i=(i+1)&mask){
+        UndoSeen* e = &log->seen[i];
+        if (e->epoch!=log->epoch){
+            e->slot=slot;
+            e->epoch=log->epoch;
+            log->seen_count++;
+            return 1;
+        }
+        if (e->slot==slot) return 0;
     }
+}
 
-    Var* var = (Var*)malloc(sizeof(Var));
-    if (!var){
+//call before writing to slot
+static inline void undo_note(ExecutionContext* ctx, Slot* slot){
+    if (ctx->undo && undo_first_write(ctx->undo, slot)) undo_save(ctx->undo, slot);
+}
+
+void enable_undo(ExecutionContext* ctx){
+    if (ctx->undo) return;
+
+    ctx->undo=(UndoLog*)calloc(1, sizeof(UndoLog));
+    if (!ctx->undo){
         fprintf(stderr, "memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
+    ctx->undo->epoch=1;
+}
+
+size_t undo_checkpoint(ExecutionContext* ctx){
+    ctx->undo->epoch++;
+    ctx->undo->seen_count=0;
+    return ctx->undo->count;
+}
+
+void undo_to(ExecutionContext* ctx, size_t mark){
+    UndoLog* log = ctx->undo;
 
-    var->type = NUM;
-    var->val.num=val;
-    var->next=NULL;
-    strcpy(var->id, id);
+    while (log->count>mark){
+        UndoEntry* e = &log->entries[--log->count];
+        *e->slot=e->saved;
+    }
 
-    insert_var(scope->variables, var);
+    log->epoch++;
+    log->seen_count=0;
 }
 
-void add_bool_var_to_scope(ScopeData *scope, const char *id, int val){
-    if (!scope){
-        fprintf(stderr, "error: NULL scope\n");
-        exit(EXIT_FAILURE);
+void undo_rebase(ExecutionContext* ctx, Slot* from, Slot* to, uint32_t count){
+    UndoLog* log = ctx->undo;
+
+    for (size_t i=0; i<log->count; i++){
+        Slot* slot = log->entries[i].slot;
+        if (slot>=from && slot<from+count) log->entries[i].slot=to+(slot-from);
     }
 
-    Var* var = (Var*)malloc(sizeof(Var));
-    if (!var){
-        fprintf(stderr, "memory allocation failed\n");
-        exit(EXIT_FAILURE);
+    //moved entries hash elsewhere now, they just get saved again
+    log->epoch++;
+    log->seen_count=0;
+}
+
+__thread RuntimeTrap* runtime_trap = NULL;
+
+void runtime_error(const char* fmt, const char* name){
+    if (runtime_trap){
+        snprintf(runtime_trap->msg, sizeof(runtime_trap->msg), fmt, name);
+        longjmp(runtime_trap->env, 1);
+    }
+
+    fprintf(stderr, fmt, name);
+    exit(EXIT_FAILURE);
+}
+
+void exec_printf(ExecutionContext* ctx, const char* fmt, ...){
+    va_list args;
+    va_start(args, fmt);
+
+    OutBuf* b = ctx->out;
+    if (!b){
+        vprintf(fmt, args);
+        va_end(args);
+        return;
+    }
+
+    va_list again;
+    va_copy(again, args);
+    int n = vsnprintf(b->data+b->count, b->capacity-b->count, fmt, args);
+    if (n>=0 && b->count+n>=b->capacity){
+        b->capacity = b->capacity ? b->capacity*2 : 4096;
+        while (b->capacity<=b->count+n) b->capacity*=2;
+        b->data=(char*)realloc(b->data, b->capacity);
+        if (!b->data){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        n=vsnprintf(b->data+b->count, b->capacity-b->count, fmt, again);
+    }
+    if (n>0) b->count+=n;
+
+    va_end(again);
+    va_end(args);
+}
+
+//the running context's copy of a slot, frames inside a parallel loop have one per worker
+static inline Slot* frame_slot(ScopeData* scope, uint32_t slot, ExecutionContext* ctx){
+    return &scope->frame[slot+ctx->worker*scope->worker_stride];
+}
+
+static void var_not_found(ASTNode* node){
+    runtime_error("error: variable '%s' not found in scope\n", sym_name(node->sym));
+}
+
+//slot a resolved name refers to, NULL if there is none. a declaration only
+//hides outer variables of the same name once it has run, until then the
+//slot's outer link is followed
+static inline Slot* lookup_slot(ASTNode* node, ExecutionContext* ctx){
+    uint32_t depth = node->val.var.depth;
+    if (depth==VAR_UNRESOLVED) return NULL;
+
+    ScopeData* scope = ctx->curr_scope;
+    while (depth--) scope=scope->parent;
+
+    uint32_t slot = node->val.var.slot;
+    while (frame_slot(scope, slot, ctx)->v==VAL_UNDEF){
+        SlotInfo* info = &scope->slot_info[slot];
+        if (!info->outer_depth) return NULL;
+
+        for (uint32_t d=0; d<info->outer_depth; d++) scope=scope->parent;
+        slot=info->outer_slot;
     }
 
-    var->type=BOOL;
-    var->val.b=val;
-    var->next=NULL;
-    strcpy(var->id, id);
+    return frame_slot(scope, slot, ctx);
+}
 
-    insert_var(scope->variables, var);
+Slot* find_slot(ASTNode* node, ExecutionContext* ctx){
+    return lookup_slot(node, ctx);
+}
+
+//declarations land in the running scope, a redeclaration (e.g. every loop
+//iteration) overwrites the same slot
+static inline Slot* declare_slot(ASTNode* node, ExecutionContext* ctx){
+    Slot* slot = frame_slot(ctx->curr_scope, node->val.var.slot, ctx);
+    undo_note(ctx, slot);
+
+    return slot;
 }
 
 
@@ -335,16 +722,16 @@ void add_bool_var_to_scope(ScopeData *scope, const char *id, int val){
 void execute_scope(ASTNode* scope, ExecutionContext* ctx){
     if (!scope) return;
     if (scope->type!=BLOCK && scope->type!=SCOPE){
-        fprintf(stderr, "not a scope or a block node\n");
-        exit(EXIT_FAILURE);
+        runtime_error("not a scope or a block node\n", "");
     }
 
     ScopeData* data = scope->val.scope;
     ScopeData* prev_scope = ctx->curr_scope;
+    if (data->parent!=prev_scope) data->parent=prev_scope;//an `if true` body optimize() hoisted into its place
     ctx->curr_scope=data;
 
     for (int i=0; i<data->stmt_count; i++){
-        execute(data->statements[i], ctx);
+        execute(ast_node(data->statements[i]), ctx);
     }
 
     ctx->curr_scope=prev_scope;
@@ -353,112 +740,122 @@ void execute_scope(ASTNode* scope, ExecutionContext* ctx){
 double execute_ref_num(ASTNode* node, ExecutionContext* ctx){
     if (node->type!=NUM_REF) return 0;
 
-    // return get_ref(node->val.id)->val.num;
-    if (ctx->curr_scope){
-        Var* var=get_var_from_scope(ctx->curr_scope, node->val.id);
-        if (var) return var->val.num;
+    Slot* var = lookup_slot(node, ctx);
+    if (!var){//typecheck() made sure it is a num if it exists
+        runtime_error("error: expecred numeric variable '%s'\n", sym_name(node->sym));
     }
 
-    //return get_ref(node->val.id)->val.num;
-    Var* var = get_var(ctx->global_vars, node->val.id);
-    if (!var){
-        fprintf(stderr, "error: variable '%s' not found in scope\n", node->val.id);
-        exit(EXIT_FAILURE);
-    }
-
-    return var->val.num;
+    return value_num(var->v);
 }
 
 int execute_ref_bool(ASTNode* node, ExecutionContext* ctx){
     if (node->type!=BOOL_REF) return 0;
 
-    if (ctx->curr_scope){
-        Var* var = get_var_from_scope(ctx->curr_scope, node->val.id);
-        if (var && var->type==BOOL) return var->val.b;
-    }
-
-    Var* var = get_var(ctx->global_vars, node->val.id);
-    if (!var||var->type!=BOOL){
-        fprintf(stderr, "error: bool variable '%s' not found in scope\n", node->val.id);
-        exit(EXIT_FAILURE);
-    }
-
-    return var->val.b;
-}
-
-Var* get_var_ref(const char* id, ExecutionContext* ctx){
-    if (ctx->curr_scope){
-        Var* var = get_var_from_scope(ctx->curr_scope, id);
-        return var;
+    Slot* var = lookup_slot(node, ctx);
+    if (!var||!value_is_bool(var->v)){
+        runtime_error("error: bool variable '%s' not found in scope\n", sym_name(node->sym));
     }
 
-    return get_var(ctx->global_vars, id);
+    return value_bool(var->v);
 }
 
 double num_evaluate_ast(ASTNode* node, ExecutionContext* ctx){
     switch (node->type){
         case (NUM_VAL): return node->val.num;
         case (B_OP): {
-            double a=num_evaluate_ast(node->left, ctx);
+            double a=num_evaluate_ast(ast_node(node->left), ctx);
             //free(node->left);
-            double b=num_evaluate_ast(node->right, ctx);
+            double b=num_evaluate_ast(ast_node(node->right), ctx);
             //free(node->right);
-            switch (node->val.type){
+            switch (node->op){
                 case (PLUS): return a+b;
                 case (MINUS): return a-b;
                 case (MULT): return a*b;
                 case (DIV): {
                     if (b!=0) return a/b;
-                    fprintf(stderr, "error: division with 0!\n");
-                    exit(EXIT_FAILURE);
+                    runtime_error("error: division with 0!\n", "");
                 };
                 case POW: return pow(a,b);
                 default: return 0;
             }
         };
+        case N_OP: {
+            NaryData* nary = node->val.nary;
+            double acc = num_evaluate_ast(ast_node(nary->args[0]), ctx);
+
+            for (uint32_t i=1; i<nary->count; i++){
+                double v = num_evaluate_ast(ast_node(nary->args[i]), ctx);
+                switch (nary->ops[i]){
+                    case PLUS: acc+=v; break;
+                    case MINUS: acc-=v; break;
+                    case MULT: acc*=v; break;
+                    case DIV: {
+                        if (v==0){
+                            runtime_error("error: division with 0!\n", "");
+                        }
+                        acc/=v;
+                    } break;
+                    case POW: acc=pow(v, acc); break;//args run right to left
+                }
+            }
+
+            return acc;
+        }
         case VAR_REF: {
-            Var* var = get_var_ref(node->val.id, ctx);
-            if (var&&var->type==NUM){
-                return var->val.num;
+            Slot* var = lookup_slot(node, ctx);
+            if (var&&value_is_num(var->v)){
+                return value_num(var->v);
             } else {
-                fprintf(stderr, "error: expecred numeric variable '%s'\n", node->val.id);
-                exit(EXIT_FAILURE);
+                runtime_error("error: expecred numeric variable '%s'\n", sym_name(node->sym));
             }
         }
-        case NUM_REF: return get_var_ref(node->val.id, ctx)->val.num;
+        case NUM_REF: return execute_ref_num(node, ctx);
+        case HOIST:
+            if (!node->op){//reset by execute_loop()
+                node->val.num=num_evaluate_ast(ast_node(node->left), ctx);
+                node->op=1;
+            }
+            return node->val.num;
+        case INDUCTION: return node->val.ind->v[0];
         default: return 0;
     }
 }
 
 int bool_evaluate_ast(ASTNode *node, ExecutionContext *ctx){
     if (!node||!ctx) {
-        fprintf(stderr, "null");
-        exit(EXIT_FAILURE);
+        runtime_error("null", "");
     }
 
     switch (node->type){
         case BOOL_VAL: return node->val.bool_val;
         case COND: return execute_cond(node, ctx);
-        case BOOL_REF: return get_var_ref(node->val.id, ctx)->val.b;
+        case BOOL_REF:
+        case NUM_REF: {//typecheck() made sure of the type if it exists
+            Slot* var = lookup_slot(node, ctx);
+            if (!var){
+                runtime_error("error: expected boolean variable '%s'\n", sym_name(node->sym));
+            }
+            return node->type==BOOL_REF ? value_bool(var->v) : value_num(var->v)!=0;
+        }
         case VAR_REF: {
-            Var* var = get_var_ref(node->val.id, ctx);
-            if (var && var->type==BOOL){
-                return var->val.b;
-            } else if (var && var->type==NUM){
-                return var->val.num!=0;
+            Slot* var = lookup_slot(node, ctx);
+            if (var && value_is_bool(var->v)){
+                return value_bool(var->v);
+            } else if (var && value_is_num(var->v)){
+                return value_num(var->v)!=0;
             } else {
-                fprintf(stderr, "error: expected boolean variable '%s'\n", node->val.id);
-                exit(EXIT_FAILURE);
+                runtime_error("error: expected boolean variable '%s'\n", sym_name(node->sym));
             }
             return 0;
         }
         case NUM_VAL:
-        case NUM_REF:
         case B_OP:
+        case N_OP:
+        case HOIST:
+        case INDUCTION:
             return num_evaluate_ast(node, ctx) != 0;
         default: {
-            fprintf(stderr, "error: non-boolean expr\n");
-            exit(EXIT_FAILURE);
+            runtime_error("error: non-boolean expr\n", "");
         }
     }
 }
@@ -466,51 +863,44 @@ int bool_evaluate_ast(ASTNode *node, ExecutionContext *ctx){
 void execute_dec_bool(ASTNode *node, ExecutionContext *ctx){
     if (node->type!=BOOL_DEC) return;
 
-    int val = bool_evaluate_ast(node->left, ctx);
+    int val = bool_evaluate_ast(ast_node(node->left), ctx);
 
-    if (ctx->curr_scope){
-        add_bool_var_to_scope(ctx->curr_scope, node->val.id, val);
-    } else {
-        Var* n = (Var*)malloc(sizeof(Var));
-        n->type=BOOL;
-        n->val.b = val;
-        n->next=NULL;
-        strcpy(n->id, node->val.id);
-        insert_var(ctx->global_vars, n);
-    }
+    Slot* var = declare_slot(node, ctx);
+    var->v=bool_value(val);
 }
 
 void execute_macro(ASTNode* node, ExecutionContext* ctx){
     if (node->type!=MACRO) return;
 
-    //printf("print type: %d\n", node->left->type);
+    ASTNode* val = ast_node(node->left);
+    //printf("print type: %d\n", val->type);
 
-    if (node->left->type==VAR_REF){
-        Var* var = get_var_ref(node->left->val.id, ctx);
+    if (val->type==VAR_REF){
+        Slot* var = lookup_slot(val, ctx);
         if (var){
-            if (var->type==BOOL){
-                printf("%s", var->val.b ? "true" : "false");
-            } else if (var->type==NUM){
-                printf("%f", var->val.num);
+            if (value_is_bool(var->v)){
+                exec_printf(ctx, "%s", value_bool(var->v) ? "true" : "false");
+            } else if (value_is_num(var->v)){
+                exec_printf(ctx, "%f", value_num(var->v));
             }
-            if (node->val.mtype==PRINTLN) printf("\n");
+            if (node->op==PRINTLN) exec_printf(ctx, "\n");
         }
         return;
     }
 
-    switch (node->val.mtype){
+    switch (node->op){
         case PRINT: {
-            if (node->left->type==NUM_VAL||node->left->type==NUM_REF||node->left->type==B_OP){
-                printf("%f", num_evaluate_ast(node->left, ctx));
-            } else if (node->left->type==BOOL_VAL||node->left->type==BOOL_REF||node->left->type==COND){
-                printf("%s", bool_evaluate_ast(node->left, ctx) ? "true":"false");
+            if (val->type==NUM_VAL||val->type==NUM_REF||val->type==B_OP||val->type==N_OP){
+                exec_printf(ctx, "%f", num_evaluate_ast(val, ctx));
+            } else if (val->type==BOOL_VAL||val->type==BOOL_REF||val->type==COND){
+                exec_printf(ctx, "%s", bool_evaluate_ast(val, ctx) ? "true":"false");
             }
         } break;
         case PRINTLN: {
-            if (node->left->type==NUM_VAL||node->left->type==NUM_REF||node->left->type==B_OP){
-                printf("%f\n", num_evaluate_ast(node->left, ctx));
-            } else if (node->left->type==BOOL_VAL||node->left->type==BOOL_REF||node->left->type==COND){
-                printf("%s\n", bool_evaluate_ast(node->left, ctx) ? "true":"false");
+            if (val->type==NUM_VAL||val->type==NUM_REF||val->type==B_OP||val->type==N_OP){
+                exec_printf(ctx, "%f\n", num_evaluate_ast(val, ctx));
+            } else if (val->type==BOOL_VAL||val->type==BOOL_REF||val->type==COND){
+                exec_printf(ctx, "%s\n", bool_evaluate_ast(val, ctx) ? "true":"false");
             }
             } break;
         default: break;
@@ -520,21 +910,13 @@ void execute_macro(ASTNode* node, ExecutionContext* ctx){
 void execute_dec(ASTNode* node, ExecutionContext* ctx){
     if (node->type!=NUM_DEC) return; //!!!!
 
-    double val = num_evaluate_ast(node->left, ctx);
+    double val = num_evaluate_ast(ast_node(node->left), ctx);
 
-    if (ctx->curr_scope){
-        add_num_var_to_scope(ctx->curr_scope, node->val.id, val);
-    } else {
-        Var* n = (Var*)malloc(sizeof(Var));
-        n->type=NUM;
-        n->val.num=val;
-        n->next=NULL;
-        strcpy(n->id, node->val.id);
-        insert_var(ctx->global_vars, n);
-    }
+    Slot* var = declare_slot(node, ctx);
+    var->v=num_value(val);
 
     // switch (node->type){
-    //     case NUM_DEC: add_var_num(num_evaluate_ast(node->left), node->val.id); break;
+    //     case NUM_DEC: add_var_num(num_evaluate_ast(node->left), sym_name(node->sym)); break;
     //     default: break;
     // }
 }
@@ -544,10 +926,10 @@ int execute_cond(ASTNode* node, ExecutionContext* ctx){
 
     if (node->type!=COND) return 0;
 
-    double a = num_evaluate_ast(node->left, ctx);
-    double b = num_evaluate_ast(node->right, ctx);
+    double a = num_evaluate_ast(ast_node(node->left), ctx);
+    double b = num_evaluate_ast(ast_node(node->right), ctx);
 
-    switch (node->val.ctype){
+    switch (node->op){
         case EQ: return a==b;
         case SMALLER_THAN: return a<b;
         case BIGGER_THAN: return a>b;
@@ -562,144 +944,217 @@ void execute_if(ASTNode* n, ExecutionContext* ctx){
     if (n->type!=IF) exit(EXIT_FAILURE);
 
     int condition=0;
-    if (n->left->type==VAR_REF){//str!!!!!
-        Var* var = get_var_ref(n->left->val.id, ctx);
-        if (var->type==BOOL){
-            condition = var->val.b;
-        } else if (var->type==NUM){
-            condition = var->val.num!=0;
+    ASTNode* cond = ast_node(n->left);
+    if (cond->type==VAR_REF){//str!!!!!
+        Slot* var = lookup_slot(cond, ctx);
+        if (!var) var_not_found(cond);
+        if (value_is_bool(var->v)){
+            condition = value_bool(var->v);
+        } else if (value_is_num(var->v)){
+            condition = value_num(var->v)!=0;
         } else {
-            fprintf(stderr, "invalid type for if\n");
-            exit(EXIT_FAILURE);
+            runtime_error("invalid type for if\n", "");
         }
-    } else if (n->left->type == COND) {
-        condition = execute_cond(n->left, ctx);
-    } else if (n->left->type == BOOL_REF || n->left->type == BOOL_VAL) {
-        condition = bool_evaluate_ast(n->left, ctx);
-    } else if (n->left->type == NUM_REF || n->left->type == NUM_VAL || n->left->type == B_OP) {
-        condition = num_evaluate_ast(n->left, ctx) != 0;
+    } else if (cond->type == COND) {
+        condition = execute_cond(cond, ctx);
+    } else if (cond->type == BOOL_REF || cond->type == BOOL_VAL) {
+        condition = bool_evaluate_ast(cond, ctx);
+    } else if (cond->type == NUM_REF || cond->type == NUM_VAL || cond->type == B_OP || cond->type == N_OP) {
+        condition = num_evaluate_ast(cond, ctx) != 0;
     } else {
-        fprintf(stderr, "Error: Invalid condition type in if statement\n");
-        exit(EXIT_FAILURE);
+        runtime_error("Error: Invalid condition type in if statement\n", "");
     }
 
     if (condition == 1){
-        if (n->right->type==SCOPE || n->right->type==BLOCK){
-            n->right->val.scope->parent=ctx->curr_scope;
+        ASTNode* body = ast_node(n->right);
+        if ((body->type==SCOPE || body->type==BLOCK) && body->val.scope->parent!=ctx->curr_scope){
+            body->val.scope->parent=ctx->curr_scope;//written once, parallel workers only read it
         }
-        execute(n->right, ctx);
+        execute(body, ctx);
     }
 }
 
-void execute_loop(ASTNode* n, ExecutionContext* ctx){
+//batch, if any, runs what it can of the iterations after the first
+static void run_loop(ASTNode* n, BatchLoop* batch, ExecutionContext* ctx){
     if (!n) exit(EXIT_FAILURE);
     if (n->type!=LOOP) exit(EXIT_FAILURE);
 
-    if (n->right->type!=SCOPE && n->right->type!=BLOCK){
-        fprintf(stderr, "loop must be a scope\n");
-        exit(EXIT_FAILURE);
+    ASTNode* scope_node = ast_node(n->right);
+    if (scope_node->type!=SCOPE && scope_node->type!=BLOCK){
+        runtime_error("loop must be a scope\n", "");
     }
 
-    n->right->val.scope->parent=ctx->curr_scope;
+    ScopeData* body = scope_node->val.scope;
+    if (body->parent!=ctx->curr_scope) body->parent=ctx->curr_scope;
 
-    ASTNode* iter_dec = n->right->val.scope->statements[0];
+    ASTNode* iter_dec = ast_node(body->statements[0]);
     if (iter_dec->type!=NUM_DEC){
-        fprintf(stderr, "first stmt in loop isnt num\n");
-        exit(EXIT_FAILURE);
+        runtime_error("first stmt in loop isnt num\n", "");
     }
 
     ScopeData* prev_scope = ctx->curr_scope;
-    ctx->curr_scope = n->right->val.scope;
+    ctx->curr_scope = body;
     execute_dec(iter_dec, ctx);
     ctx->curr_scope = prev_scope;
 
-    while (1){
-        Var* iter_var = get_var_from_scope(n->right->val.scope, n->val.id);
-        if (!iter_var){
-            fprintf(stderr, "iterator var not found\n");
-            exit(EXIT_FAILURE);
+    Slot* iter_var = frame_slot(body, iter_dec->val.var.slot, ctx);
+
+    //INDUCTIONs come first in the list, then HOISTs
+    for (NodeId h=n->left; h; h=ast_node(h)->right){
+        ASTNode* m = ast_node(h);
+        if (m->type==HOIST){
+            m->op=0;
+        } else {
+            memcpy(m->val.ind->v, m->val.ind->init, sizeof(m->val.ind->v));
         }
+    }
+
+    if ((n->op&LOOP_PARALLEL) && par_run(n, ctx)) return;
 
-        if (iter_var->val.num>=n->val.max_loop-1){
+    int first = 1;
+    while (1){
+        if (value_num(iter_var->v)>=n->val.num){//start->end runs start..end-1
             break;
         }
 
+        if (batch && !first && batch_run(batch, n, ctx)) continue;
+        first=0;
+
         ScopeData* prev_scope = ctx->curr_scope;
-        ctx->curr_scope = n->right->val.scope;
+        ctx->curr_scope = body;
 
-        for (int i=1; i<n->right->val.scope->stmt_count; i++){
-            execute(n->right->val.scope->statements[i], ctx);
+        for (int i=1; i<body->stmt_count; i++){
+            execute(ast_node(body->statements[i]), ctx);
         }
 
         ctx->curr_scope=prev_scope;
 
-        iter_var = get_var_from_scope(n->right->val.scope, n->val.id);
-        iter_var->val.num++;
+        undo_note(ctx, iter_var);
+        iter_var->v=num_value(value_num(iter_var->v)+1);
+
+        for (NodeId h=n->left; h && ast_node(h)->type==INDUCTION; h=ast_node(h)->right){
+            InductionData* ind = ast_node(h)->val.ind;
+            for (uint32_t k=0; k<ind->degree; k++) ind->v[k]+=ind->v[k+1];
+        }
     }
 }
 
+void execute_loop(ASTNode* n, ExecutionContext* ctx){
+    run_loop(n, NULL, ctx);
+}
+
 void execute_reassign_num(ASTNode *node, ExecutionContext *ctx){
     if (node->type!=NUM_REASSIGN) return;
 
-    double new_val = num_evaluate_ast(node->left, ctx);
-
-    if (ctx->curr_scope){
-        Var* var = get_var_from_scope(ctx->curr_scope, node->val.id);
-        if (var){
-            if (var->type==NUM){
-                var->val.num=new_val;
-                return;
-            } else {
-                fprintf(stderr, "error: cannot assign numeric value to non-numeric variable '%s'\n", node->val.id);
-                exit(EXIT_FAILURE);
-            }
-        }
-    }
+    double new_val = num_evaluate_ast(ast_node(node->left), ctx);
 
-    Var* var = get_var(ctx->global_vars, node->val.id);
+    Slot* var = lookup_slot(node, ctx);
     if (!var){
-        fprintf(stderr, "error: varible '%s' not found\n", node->val.id);
-        exit(EXIT_FAILURE);
+        runtime_error("error: varible '%s' not found\n", sym_name(node->sym));
     }
 
-    if (var->type!=NUM){
-        fprintf(stderr, "error: cannot assign numeric value to non-numeric varible '%s'\n", node->val.id);
-        exit(EXIT_FAILURE);
+    if (!value_is_num(var->v)){
+        runtime_error("error: cannot assign numeric value to non-numeric variable '%s'\n", sym_name(node->sym));
     }
 
-    var->val.num = new_val;
+    undo_note(ctx, var);
+    var->v = num_value(new_val);
 }
 
 void execute_reassign_bool(ASTNode* node, ExecutionContext* ctx) {
     if (node->type != BOOL_REASSIGN) return;
 
-    int new_val = bool_evaluate_ast(node->left, ctx);
+    int new_val = bool_evaluate_ast(ast_node(node->left), ctx);
 
-    if (ctx->curr_scope) {
-        Var* var = get_var_from_scope(ctx->curr_scope, node->val.id);
-        if (var) {
-            if (var->type == BOOL) {
-                var->val.b = new_val;
-                return;
-            } else {
-                fprintf(stderr, "error: cannot assign boolean value to non-boolean variable '%s'\n", node->val.id);
-                exit(EXIT_FAILURE);
-            }
+    Slot* var = lookup_slot(node, ctx);
+    if (!var) {
+        runtime_error("error: variable '%s' not found for reassignment\n", sym_name(node->sym));
+    }
+
+    if (!value_is_bool(var->v)) {
+        runtime_error("error: cannot assign boolean value to non-boolean variable '%s'\n", sym_name(node->sym));
+    }
+
+    undo_note(ctx, var);
+    var->v = bool_value(new_val);
+}
+
+//typecheck()'d statements, their operands cannot have the wrong type
+static void execute_print_num(ASTNode* node, ExecutionContext* ctx){
+    ASTNode* val = ast_node(node->left);
+    double x;
+
+    if (val->type==NUM_REF){//a missing variable prints nothing, as in execute_macro()
+        Slot* var = lookup_slot(val, ctx);
+        if (!var) return;
+        x=value_num(var->v);
+    } else {
+        x=num_evaluate_ast(val, ctx);
+    }
+
+    exec_printf(ctx, node->op==PRINTLN ? "%f\n" : "%f", x);
+}
+
+static void execute_print_bool(ASTNode* node, ExecutionContext* ctx){
+    ASTNode* val = ast_node(node->left);
+    int b;
+
+    if (val->type==BOOL_REF){
+        Slot* var = lookup_slot(val, ctx);
+        if (!var) return;
+        b=value_bool(var->v);
+    } else {
+        b=bool_evaluate_ast(val, ctx);
+    }
+
+    exec_printf(ctx, node->op==PRINTLN ? "%s\n" : "%s", b ? "true" : "false");
+}
+
+static void execute_if_typed(ASTNode* n, ExecutionContext* ctx){
+    ASTNode* cond = ast_node(n->left);
+    int condition;
+
+    if (cond->type==NUM_REF || cond->type==BOOL_REF){
+        Slot* var = lookup_slot(cond, ctx);
+        if (!var) var_not_found(cond);
+        condition = cond->type==BOOL_REF ? value_bool(var->v) : value_num(var->v)!=0;
+    } else if (n->type==IF_NUM){
+        condition = num_evaluate_ast(cond, ctx)!=0;
+    } else {
+        condition = bool_evaluate_ast(cond, ctx);
+    }
+
+    if (condition){
+        ASTNode* body = ast_node(n->right);
+        if ((body->type==SCOPE || body->type==BLOCK) && body->val.scope->parent!=ctx->curr_scope){
+            body->val.scope->parent=ctx->curr_scope;//written once, parallel workers only read it
         }
+        execute(body, ctx);
     }
+}
 
-    Var* var = get_var(ctx->global_vars, node->val.id);
-    if (!var) {
-        fprintf(stderr, "error: variable '%s' not found for reassignment\n", node->val.id);
-        exit(EXIT_FAILURE);
+static void execute_set_num(ASTNode* node, ExecutionContext* ctx){
+    double new_val = num_evaluate_ast(ast_node(node->left), ctx);
+
+    Slot* var = lookup_slot(node, ctx);
+    if (!var){
+        runtime_error("error: varible '%s' not found\n", sym_name(node->sym));
     }
 
-    if (var->type != BOOL) {
-        fprintf(stderr, "error: cannot assign boolean value to non-boolean variable '%s'\n", node->val.id);
-        exit(EXIT_FAILURE);
+    undo_note(ctx, var);
+    var->v = num_value(new_val);
+}
+
+static void execute_set_bool(ASTNode* node, ExecutionContext* ctx){
+    int new_val = bool_evaluate_ast(ast_node(node->left), ctx);
+
+    Slot* var = lookup_slot(node, ctx);
+    if (!var){
+        runtime_error("error: variable '%s' not found for reassignment\n", sym_name(node->sym));
     }
 
-    var->val.b = new_val;
+    undo_note(ctx, var);
+    var->v = bool_value(new_val);
 }
 
 void execute(ASTNode* node, ExecutionContext* ctx){
@@ -735,41 +1190,63 @@ void execute(ASTNode* node, ExecutionContext* ctx){
         case BOOL_REASSIGN:
             execute_reassign_bool(node, ctx);
             return;
+        case PRINT_NUM:
+            execute_print_num(node, ctx);
+            return;
+        case PRINT_BOOL:
+            execute_print_bool(node, ctx);
+            return;
+        case IF_NUM:
+        case IF_BOOL:
+            execute_if_typed(node, ctx);
+            return;
+        case NUM_SET:
+            execute_set_num(node, ctx);
+            return;
+        case BOOL_SET:
+            execute_set_bool(node, ctx);
+            return;
+        case NATIVE:
+            if (!jit_enter(node->val.native)) execute_loop(ast_node(node->left), ctx);
+            return;
+        case BATCH:
+            run_loop(ast_node(node->left), node->val.batch, ctx);
+            return;
         default:
             printf("Unknown node type: %d\n", node->type);
             break;
     }
 }
 
-void free_scope(ScopeData* scope){
-    if (!scope) return;
-
-    //for (int i=0; i<scope->stmt_count; i++)
-    free(scope->statements);
-    free_map(scope->variables);
-    free(scope);
-}
-
+//nodes, scopes and their variables all sit in the program arena, so only
+//the program root releases anything and there is no tree walk
 void free_ast(ASTNode* node){
     if (!node) return;
+    if (node->type!=SCOPE && node->type!=BLOCK) return;
 
-    if (node->type==SCOPE||node->type==BLOCK){
-        for (int i=0; i<node->val.scope->stmt_count; i++){
-            free_ast(node->val.scope->statements[i]);
-        }
+    AstPool* pool = node->val.scope->pool;
+    if (!pool) return;
 
-        free_scope(node->val.scope);
-    } else {
-        free_ast(node->left);
-        free_ast(node->right);
+    if (ast_pool==pool) ast_pool=NULL;
+
+    AstPool* view = pool->workers;
+    while (view){
+        AstPool* next = view->next_worker;
+        arena_free(view->arena);
+        view=next;
     }
 
-    free(node);
+    pthread_mutex_destroy(&pool->lock);
+    arena_free(pool->arena);//the pool lives in its own arena
 }
 
 void free_execution_context(ExecutionContext* ctx){
     if (!ctx) return;
 
-    free_map(ctx->global_vars);
+    if (ctx->undo){
+        free(ctx->undo->entries);
+        free(ctx->undo->seen);
+        free(ctx->undo);
+    }
     free(ctx);
 }
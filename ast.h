@@ -2,9 +2,13 @@
 #define AST_H
 
 #include <math.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <setjmp.h>
 
 #include "main.h"
-#include "map.h"
+#include "arena.h"
+#include "value.h"
 
 typedef enum {
     PLUS,
@@ -29,6 +33,7 @@ typedef enum{
     NUM_VAL,
     BOOL_VAL,
     B_OP,
+    N_OP,//chain of 3+ operands of one precedence level
     NUM_DEC,
     BOOL_DEC,
     NUM_REF,
@@ -44,86 +49,254 @@ typedef enum{
     LOOP,//for loop
     NUM_REASSIGN,
     BOOL_REASSIGN,
+
+    //specialized by typecheck(), operands are known to have the right type
+    PRINT_NUM,
+    PRINT_BOOL,
+    IF_NUM,//condition is a number, taken if nonzero
+    IF_BOOL,
+    NUM_SET,//reassignment of a variable that is only ever a num
+    BOOL_SET,
+
+    //moved out of a loop body by optimize(), linked from the LOOP's left
+    //through right
+    HOIST,//left does not change while the loop runs, evaluated once per entry
+    INDUCTION,//polynomial in the iterator (left), kept up to date by the loop
+
+    NATIVE,//a LOOP jit_program() compiled, left is the loop for when it cannot run
+    BATCH,//a LOOP batch_program() vectorized, left is the loop
 } ASTNodeT;
 
+#define LOOP_PARALLEL 1//op of a LOOP whose iterations run on the --threads pool
+
+//static types, a variable declared as both is TY_ANY and checked at runtime
+#define TY_NUM 1
+#define TY_BOOL 2
+#define TY_ANY (TY_NUM|TY_BOOL)
+
 typedef struct ScopeData ScopeData ;
+struct JitLoop;
+struct BatchLoop;
+
+typedef uint32_t NodeId;//index into the program's node pool, 0 is no node
+typedef uint32_t SymId;//interned identifier
+
+//operands of an N_OP. op is PLUS (ops[i] is PLUS or MINUS), MULT (MULT or
+//DIV) or POW, whose args are stored right to left since it associates right
+typedef struct NaryData {
+    uint32_t count;
+    uint32_t capacity;
+    NodeId* args;
+    uint8_t* ops;//ops[i] combines args[i], ops[0] is unused
+} NaryData;
+
+//finite differences of an INDUCTION's polynomial, v[k]+=v[k+1] per iteration
+typedef struct InductionData {
+    double init[4];//at the first iteration
+    double v[4];//at the current one, v[0] is the value
+    uint32_t degree;
+} InductionData;
 
-typedef struct ASTNode{
-    ASTNodeT type;
+#define NODE_CHUNK_SHIFT 12
+#define NODE_CHUNK (1<<NODE_CHUNK_SHIFT)//nodes per pool chunk, chunks never move
+
+#define VAR_LEN 31//identifiers are cut to VAR_LEN-1 characters
+#define VAR_UNRESOLVED UINT32_MAX//depth of a name no enclosing scope declares
+
+typedef struct ASTNode{//24 bytes
+    uint8_t type;//ASTNodeT
+    uint8_t op;//BinOpT, MacroT or CondT
+    uint8_t vtype;//TY_* of an expression, 0 until typecheck() ran
+    SymId sym;//decs, refs, reassigns and the loop iterator
     union{
-        double num;
-        BinOpT type;
-        char id[30+1];
-        MacroT mtype;
-        CondT ctype;
-        ScopeData* scope;
-        double max_loop;//for loops
+        double num;//NUM_VAL, loop end for LOOP
         int bool_val;
+        ScopeData* scope;
+        NaryData* nary;
+        InductionData* ind;
+        struct JitLoop* native;
+        struct BatchLoop* batch;
+        struct {
+            uint32_t depth;//scopes up from the one running the node
+            uint32_t slot;
+        } var;//decs, refs and reassigns once resolved
     } val;
-    struct ASTNode* left;
-    struct ASTNode* right;
+    NodeId left;
+    NodeId right;
 } ASTNode;
 
+//storage of one variable, VAL_UNDEF until its declaration ran and lookups
+//pass over it
+typedef struct Slot {
+    Value v;
+} Slot;
+
+//a slot's name and where the same name lives in the nearest enclosing
+//scope that declares it, read while the slot is not live
+typedef struct SlotInfo {
+    SymId sym;
+    uint8_t type;//TY_* of the declarations into it
+    uint32_t outer_depth;//0 if no enclosing scope declares it
+    uint32_t outer_slot;
+} SlotInfo;
+
 typedef struct ScopeData {
-    Map* variables;
-    struct ASTNode** statements;
+    Slot* frame;//a slot per name declared directly in the scope, see resolve()
+    SlotInfo* slot_info;
+    uint32_t slot_count;
+    uint32_t slot_capacity;
+    uint32_t worker_stride;//slot_count inside a parallel loop, whose workers each have a copy of the frame
+    NodeId* statements;
     int stmt_count;
+    int stmt_capacity;
     struct ScopeData* parent;
+    Arena* arena;//of the program this scope belongs to
+    struct AstPool* pool;//program root only, owns the arena
 } ScopeData;
 
+//per-program storage: nodes in fixed-size chunks and the symbol table,
+//all of it inside one arena
+typedef struct AstPool {
+    Arena* arena;
+    ASTNode** chunks;//shared table, a node's id is its chunk and slot
+    uint32_t chunk_count;
+    uint32_t chunk_capacity;
+    uint32_t node_count;
+
+    char** syms;//names truncated to VAR_LEN-1, indexed by SymId
+    uint32_t sym_count;
+    uint32_t sym_capacity;
+    SymId* sym_slots;//open addressing, 0 is empty
+    uint32_t sym_mask;
+
+    //parallel parsing: each worker thread builds into a view with its own
+    //arena and chunks, claiming chunks and symbols from the program's pool
+    struct AstPool* shared;//set on worker views
+    SymId* shared_ids;//views: own symbol -> program symbol, syms above are the view's own
+    uint32_t shared_ids_capacity;
+    struct AstPool* workers;//program pool: its views, freed with it
+    struct AstPool* next_worker;
+    pthread_mutex_t lock;//program pool: taken by views
+} AstPool;
+
+extern __thread AstPool* ast_pool;//pool of the program being built or run
+
+static inline ASTNode* ast_node(NodeId id){
+    return id ? &ast_pool->chunks[id>>NODE_CHUNK_SHIFT][id&(NODE_CHUNK-1)] : NULL;
+}
+
+static inline const char* sym_name(SymId sym){
+    return ast_pool->syms[sym];
+}
+
+//variable writes since a checkpoint, so execution can be rolled back to it.
+//a slot is saved once per checkpoint, on its first write after it
+typedef struct {
+    Slot* slot;
+    Slot saved;
+} UndoEntry;
+
+//slots saved since the last checkpoint, open addressing on the address.
+//entries from older epochs count as empty
+typedef struct {
+    Slot* slot;
+    uint32_t epoch;
+} UndoSeen;
+
+typedef struct UndoLog {
+    UndoEntry* entries;
+    size_t count;
+    size_t capacity;
+    uint32_t epoch;
+    UndoSeen* seen;
+    size_t seen_count;//this epoch's
+    size_t seen_capacity;//power of 2
+} UndoLog;
+
+//what a parallel loop's worker prints, written out in iteration order
+typedef struct OutBuf {
+    char* data;
+    size_t count;
+    size_t capacity;
+} OutBuf;
+
 typedef struct{
     ScopeData* curr_scope;
-    Map* global_vars;
+    UndoLog* undo;//NULL unless execution gets rolled back (--watch)
+    OutBuf* out;//NULL prints straight to stdout
+    uint32_t worker;//whose copy of parallel loop frames it uses
     //int max_iter->inf loops
     //error handling
 } ExecutionContext;
 
-ASTNode* create_var_ref_node(const char id[VAR_LEN]);
+SymId intern_sym(const char* id, size_t len);
 
-ASTNode* create_bool_node(int val);
-ASTNode* create_dec_node_bool(ASTNode* expr, const char id[VAR_LEN]);
-ASTNode* create_ref_node_bool(const char id[VAR_LEN]);
+NodeId create_var_ref_node(const char* id, size_t len);
+
+NodeId create_bool_node(int val);
+NodeId create_dec_node_bool(NodeId expr, const char* id, size_t len);
+NodeId create_ref_node_bool(const char* id, size_t len);
 
 int bool_evaluate_ast(ASTNode* node, ExecutionContext* ctx);
 void execute_dec_bool(ASTNode* node, ExecutionContext* ctx);
 int execute_ref_bool(ASTNode* node, ExecutionContext* ctx);//!, &&, ||
 
-ASTNode* create_num_node(double x);
-ASTNode* create_bin_op_node(BinOpT t, ASTNode* left, ASTNode* right);
-ASTNode* create_macro_node(MacroT t, ASTNode* left);
-ASTNode* create_dec_node_num(ASTNode* expr, const char id[VAR_LEN]);//AST Node ----> exec: add_var_num
-ASTNode* create_ref_node_num(const char id[VAR_LEN]);
-ASTNode* create_cond_node(CondT t, ASTNode* l, ASTNode* r);
-ASTNode* create_if_node(ASTNode* cond, ASTNode* code);
-ASTNode* create_loop_node(ASTNode* code, const char iter[VAR_LEN], int start, int end);
-ASTNode* create_reassign_node_num(const char id[VAR_LEN], ASTNode* expr);
-ASTNode* create_reassign_node_bool(const char id[VAR_LEN], ASTNode* expr);
-
-ASTNode* create_scope_node(ScopeData* parent);
-ASTNode* create_block_node(ASTNode** statements, int count, ScopeData* parent);
-void add_stmt_to_scope(ASTNode* scope, ASTNode* stmt);
-Var* get_var_from_scope(ScopeData* scope, const char id[VAR_LEN]);
-void add_num_var_to_scope(ScopeData* scope, const char id[VAR_LEN], double val);//num only
-void add_bool_var_to_scope(ScopeData* scope, const char id[VAR_LEN], int val);
+NodeId create_num_node(double x);
+NodeId create_bin_op_node(BinOpT t, NodeId left, NodeId right);//folds same-level chains into N_OP
+NodeId create_macro_node(MacroT t, NodeId left);
+NodeId create_dec_node_num(NodeId expr, const char* id, size_t len);//AST Node ----> exec: execute_dec
+NodeId create_ref_node_num(const char* id, size_t len);
+NodeId create_cond_node(CondT t, NodeId l, NodeId r);
+NodeId create_if_node(NodeId cond, NodeId code);
+NodeId create_loop_node(NodeId code, const char* iter, size_t len, int start, int end);
+NodeId create_reassign_node_num(const char* id, size_t len, NodeId expr);
+NodeId create_reassign_node_bool(const char* id, size_t len, NodeId expr);
+NodeId create_hoist_node(NodeId expr);
+NodeId create_induction_node(NodeId expr, const double* init, uint32_t degree);
+NodeId create_native_node(NodeId loop, struct JitLoop* code);
+NodeId create_batch_node(NodeId loop, struct BatchLoop* batch);
+NodeId copy_node(NodeId id);//shallow, for rewrites that move a node under a new one
+
+NodeId create_program_node();//starts a new pool, build the rest of the tree after this
+void join_ast_pool(AstPool* program);//points this thread's ast_pool at a new worker view
+NodeId create_scope_node(ScopeData* parent);
+NodeId create_block_node(NodeId* statements, int count, ScopeData* parent);
+void add_stmt_to_scope(NodeId scope, NodeId stmt);
 
 double num_evaluate_ast(ASTNode* node, ExecutionContext* ctx);
 void execute_macro(ASTNode* node, ExecutionContext* ctx);
+void exec_printf(ExecutionContext* ctx, const char* fmt, ...);//printf() to stdout or the running parallel worker's buffer
 void execute(ASTNode* node, ExecutionContext* ctx);//->AST: type of evaluation depends on the type of var it goes into
 void execute_dec(ASTNode* node, ExecutionContext* ctx);
 double execute_ref_num(ASTNode* node, ExecutionContext* ctx);
 int execute_cond(ASTNode* node, ExecutionContext* ctx);
 void execute_if(ASTNode* n, ExecutionContext* ctx);
 void execute_loop(ASTNode *node, ExecutionContext *ctx);
+Slot* find_slot(ASTNode* node, ExecutionContext* ctx);//a resolved name's slot from the running scope, NULL if none
 void execute_reassign_num(ASTNode* node, ExecutionContext* ctx);
 void execute_reassign_bool(ASTNode *node, ExecutionContext *ctx);
 
 void execute_scope(ASTNode* scope, ExecutionContext* ctx);
 void execute_block(ASTNode* block, ExecutionContext* ctx);
 
-void free_scope(ScopeData* scope);
-void free_ast(ASTNode* node);
+//a runtime error ends the program. on a parallel loop's worker it ends the
+//iteration instead, with the message kept in the trap
+typedef struct RuntimeTrap {
+    jmp_buf env;
+    char msg[256];
+} RuntimeTrap;
+
+extern __thread RuntimeTrap* runtime_trap;
+_Noreturn void runtime_error(const char* fmt, const char* name);//fmt takes name as its only %s
+
+void free_ast(ASTNode* node);//program root only, releases the whole tree
 
 ExecutionContext* create_execution_context();
 void free_execution_context(ExecutionContext* ctx);
 
+void enable_undo(ExecutionContext* ctx);
+size_t undo_checkpoint(ExecutionContext* ctx);//mark to roll back to
+void undo_to(ExecutionContext* ctx, size_t mark);
+void undo_rebase(ExecutionContext* ctx, Slot* from, Slot* to, uint32_t count);//a frame moved
+
 #endif
@@ -0,0 +1,589 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "batch.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define BATCH_X86_64
+#endif
+
+static BatchLoop* batch_loops;//all planned loops, for batch_free()
+
+//runs one BatchOp over all BATCH_WIDTH lanes, returns the lanes that
+//divided by zero
+typedef uint64_t (*BatchKernel)(uint8_t op, double* dst, const double* a, const double* b);
+static BatchKernel batch_kernel;
+static int batch_workers;//copies of each loop's registers, see par_program()
+
+typedef struct {
+    BatchLoop* b;
+    ASTNode* loop;
+    ScopeData* body;
+    uint32_t iter_slot;
+    uint32_t* slot_regs;//body slot -> register of its declaration so far, UINT32_MAX before
+    uint32_t op_capacity;
+    uint32_t src_capacity;
+    uint32_t step_capacity;
+    uint32_t acc_capacity;
+    int failed;//the body does something that is not batched
+} Planner;
+
+static void* batch_grow(void* p, uint32_t* capacity, uint32_t count, size_t size){
+    if (count<*capacity) return p;
+
+    *capacity = *capacity ? *capacity*2 : 16;
+    p=realloc(p, size*(*capacity));
+    if (!p){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static uint64_t kernel_scalar(uint8_t op, double* dst, const double* a, const double* b){
+    uint64_t zero = 0;
+
+    switch (op){
+        case PLUS: for (int k=0; k<BATCH_WIDTH; k++) dst[k]=a[k]+b[k]; break;
+        case MINUS: for (int k=0; k<BATCH_WIDTH; k++) dst[k]=a[k]-b[k]; break;
+        case MULT: for (int k=0; k<BATCH_WIDTH; k++) dst[k]=a[k]*b[k]; break;
+        case DIV:
+            for (int k=0; k<BATCH_WIDTH; k++){
+                if (b[k]==0) zero|=1ull<<k;
+                dst[k]=a[k]/b[k];
+            }
+            break;
+        case POW: for (int k=0; k<BATCH_WIDTH; k++) dst[k]=pow(a[k], b[k]); break;
+    }
+
+    return zero;
+}
+
+#ifdef BATCH_X86_64
+
+static uint64_t kernel_sse2(uint8_t op, double* dst, const double* a, const double* b){
+    uint64_t zero = 0;
+    const __m128d z = _mm_setzero_pd();
+
+    switch (op){
+        case PLUS:
+            for (int k=0; k<BATCH_WIDTH; k+=2) _mm_storeu_pd(dst+k, _mm_add_pd(_mm_loadu_pd(a+k), _mm_loadu_pd(b+k)));
+            break;
+        case MINUS:
+            for (int k=0; k<BATCH_WIDTH; k+=2) _mm_storeu_pd(dst+k, _mm_sub_pd(_mm_loadu_pd(a+k), _mm_loadu_pd(b+k)));
+            break;
+        case MULT:
+            for (int k=0; k<BATCH_WIDTH; k+=2) _mm_storeu_pd(dst+k, _mm_mul_pd(_mm_loadu_pd(a+k), _mm_loadu_pd(b+k)));
+            break;
+        case DIV:
+            for (int k=0; k<BATCH_WIDTH; k+=2){
+                __m128d y = _mm_loadu_pd(b+k);
+                zero|=(uint64_t)_mm_movemask_pd(_mm_cmpeq_pd(y, z))<<k;
+                _mm_storeu_pd(dst+k, _mm_div_pd(_mm_loadu_pd(a+k), y));
+            }
+            break;
+        case POW: return kernel_scalar(op, dst, a, b);
+    }
+
+    return zero;
+}
+
+__attribute__((target("avx2")))
+static uint64_t kernel_avx2(uint8_t op, double* dst, const double* a, const double* b){
+    uint64_t zero = 0;
+    const __m256d z = _mm256_setzero_pd();
+
+    switch (op){
+        case PLUS:
+            for (int k=0; k<BATCH_WIDTH; k+=4) _mm256_storeu_pd(dst+k, _mm256_add_pd(_mm256_loadu_pd(a+k), _mm256_loadu_pd(b+k)));
+            break;
+        case MINUS:
+            for (int k=0; k<BATCH_WIDTH; k+=4) _mm256_storeu_pd(dst+k, _mm256_sub_pd(_mm256_loadu_pd(a+k), _mm256_loadu_pd(b+k)));
+            break;
+        case MULT:
+            for (int k=0; k<BATCH_WIDTH; k+=4) _mm256_storeu_pd(dst+k, _mm256_mul_pd(_mm256_loadu_pd(a+k), _mm256_loadu_pd(b+k)));
+            break;
+        case DIV:
+            for (int k=0; k<BATCH_WIDTH; k+=4){
+                __m256d y = _mm256_loadu_pd(b+k);
+                zero|=(uint64_t)_mm256_movemask_pd(_mm256_cmp_pd(y, z, _CMP_EQ_OQ))<<k;
+                _mm256_storeu_pd(dst+k, _mm256_div_pd(_mm256_loadu_pd(a+k), y));
+            }
+            break;
+        case POW: return kernel_scalar(op, dst, a, b);
+    }
+
+    return zero;
+}
+
+#endif
+
+static uint32_t new_reg(Planner* p){
+    return p->b->reg_count++;
+}
+
+static uint32_t add_src(Planner* p, uint8_t kind, NodeId node, double k){
+    BatchLoop* b = p->b;
+
+    for (uint32_t i=0; i<b->src_count; i++){
+        BatchSrc* s = &b->srcs[i];
+        if (s->kind!=kind) continue;
+        if (kind==SRC_CONST && memcmp(&s->k, &k, sizeof(k))==0) return s->reg;
+        if (kind==SRC_HOIST || kind==SRC_INDUCTION || kind==SRC_OUTER_INDUCTION){
+            if (s->node==node) return s->reg;
+        }
+        if (kind==SRC_REF){//same place, same lookup
+            ASTNode* m = ast_node(s->node);
+            ASTNode* n = ast_node(node);
+            if (m->val.var.depth==n->val.var.depth && m->val.var.slot==n->val.var.slot) return s->reg;
+        }
+    }
+
+    b->srcs=(BatchSrc*)batch_grow(b->srcs, &p->src_capacity, b->src_count, sizeof(BatchSrc));
+    BatchSrc* s = &b->srcs[b->src_count++];
+    s->kind=kind;
+    s->node=node;
+    s->k=k;
+    s->reg=new_reg(p);
+    return s->reg;
+}
+
+static void add_step(Planner* p, uint8_t kind, uint8_t op, uint32_t acc, uint32_t reg){
+    BatchLoop* b = p->b;
+
+    b->steps=(BatchStep*)batch_grow(b->steps, &p->step_capacity, b->step_count, sizeof(BatchStep));
+    BatchStep* s = &b->steps[b->step_count++];
+    s->kind=kind;
+    s->op=op;
+    s->acc=acc;
+    s->reg=reg;
+}
+
+static uint32_t add_op(Planner* p, uint8_t op, uint32_t a, uint32_t b){
+    BatchLoop* l = p->b;
+
+    l->ops=(BatchOp*)batch_grow(l->ops, &p->op_capacity, l->op_count, sizeof(BatchOp));
+    BatchOp* o = &l->ops[l->op_count++];
+    o->op=op;
+    o->dst=new_reg(p);
+    o->a=a;
+    o->b=b;
+    return o->dst;
+}
+
+//the accumulator a reassignment of an outer variable writes, UINT32_MAX if
+//n does not refer to one
+static uint32_t acc_of(Planner* p, ASTNode* n){
+    for (uint32_t i=0; i<p->b->acc_count; i++){
+        ASTNode* m = ast_node(p->b->accs[i]);
+        if (m->sym==n->sym) return i;
+    }
+    return UINT32_MAX;
+}
+
+//same variable as the accumulator
+static int is_acc_ref(Planner* p, ASTNode* n, uint32_t acc){
+    ASTNode* m = ast_node(p->b->accs[acc]);
+    return (n->type==NUM_REF || n->type==VAR_REF) &&
+           n->sym==m->sym && n->val.var.depth==m->val.var.depth && n->val.var.slot==m->val.var.slot;
+}
+
+//one of the INDUCTIONs the batched loop steps, not an enclosing loop's
+static int own_induction(Planner* p, NodeId id){
+    for (NodeId h=p->loop->left; h && ast_node(h)->type==INDUCTION; h=ast_node(h)->right){
+        if (h==id) return 1;
+    }
+    return 0;
+}
+
+//register holding the expression for every lane. anything reading a
+//variable the loop writes, or that is not arithmetic, fails
+static uint32_t expr(Planner* p, NodeId id){
+    ASTNode* n = ast_node(id);
+    if (p->failed || !n){
+        p->failed=1;
+        return 0;
+    }
+
+    switch (n->type){
+        case NUM_VAL:
+            return add_src(p, SRC_CONST, 0, n->val.num);
+        case NUM_REF:
+        case VAR_REF:
+            if (n->val.var.depth==VAR_UNRESOLVED || acc_of(p, n)!=UINT32_MAX) break;
+            if (n->val.var.depth==0){//declared earlier in the same iteration, or the iterator
+                if (n->val.var.slot==p->iter_slot) return 0;
+                if (p->slot_regs[n->val.var.slot]==UINT32_MAX) break;
+                return p->slot_regs[n->val.var.slot];
+            }
+            return add_src(p, SRC_REF, id, 0);
+        case HOIST:
+            return add_src(p, SRC_HOIST, id, 0);
+        case INDUCTION:
+            if (!own_induction(p, id)) return add_src(p, SRC_OUTER_INDUCTION, id, 0);
+            return add_src(p, SRC_INDUCTION, id, 0);
+        case B_OP: {
+            if (n->op>POW) break;
+            uint32_t a = expr(p, n->left);
+            uint32_t b = expr(p, n->right);
+            return p->failed ? 0 : add_op(p, n->op, a, b);
+        }
+        case N_OP: {
+            NaryData* nary = n->val.nary;
+            uint32_t acc = expr(p, nary->args[0]);
+
+            for (uint32_t i=1; i<nary->count && !p->failed; i++){
+                uint32_t v = expr(p, nary->args[i]);
+                if (p->failed) break;
+                if (nary->ops[i]==POW) acc=add_op(p, POW, v, acc);//args run right to left
+                else acc=add_op(p, nary->ops[i], acc, v);
+            }
+            return acc;
+        }
+        default: break;
+    }
+
+    p->failed=1;
+    return 0;
+}
+
+//acc = acc op ... with the ops applied lane by lane, or acc = expr
+static void assign(Planner* p, ASTNode* n){
+    uint32_t acc = acc_of(p, n);
+    ASTNode* val = ast_node(n->left);
+
+    if (val->type==B_OP && val->op<=POW && is_acc_ref(p, ast_node(val->left), acc)){
+        uint32_t r = expr(p, val->right);
+        add_step(p, STEP_FOLD, val->op, acc, r);
+    } else if (val->type==N_OP && val->op!=POW && is_acc_ref(p, ast_node(val->val.nary->args[0]), acc)){
+        NaryData* nary = val->val.nary;
+        for (uint32_t i=1; i<nary->count && !p->failed; i++){
+            uint32_t r = expr(p, nary->args[i]);
+            add_step(p, STEP_FOLD, nary->ops[i], acc, r);
+        }
+    } else {
+        uint32_t r = expr(p, n->left);
+        add_step(p, STEP_SET, 0, acc, r);
+    }
+}
+
+static void plan_stmt(Planner* p, ASTNode* n){
+    switch (n->type){
+        case NUM_DEC: {
+            uint32_t slot = n->val.var.slot;
+            uint32_t r = expr(p, n->left);
+            if (slot==p->iter_slot) p->failed=1;//would move the loop
+            p->slot_regs[slot]=r;
+        } break;
+        case PRINT_NUM: {
+            ASTNode* val = ast_node(n->left);
+            if (val->type==NUM_REF && val->val.var.depth!=0 && acc_of(p, val)!=UINT32_MAX){
+                uint32_t acc = acc_of(p, val);
+                if (!is_acc_ref(p, val, acc)) p->failed=1;
+                add_step(p, STEP_PRINT_ACC, n->op, acc, 0);
+            } else {
+                add_step(p, STEP_PRINT, n->op, 0, expr(p, n->left));
+            }
+        } break;
+        case NUM_SET:
+        case NUM_REASSIGN:
+            assign(p, n);
+            break;
+        default:
+            p->failed=1;
+            break;
+    }
+}
+
+static void free_batch(BatchLoop* b){
+    free(b->regs);
+    free(b->ops);
+    free(b->srcs);
+    free(b->steps);
+    free(b->accs);
+    free(b->acc_slots);
+    free(b->acc_values);
+    free(b->temps);
+    free(b);
+}
+
+static BatchLoop* plan(ASTNode* loop){
+    ASTNode* scope_node = ast_node(loop->right);
+    if (scope_node->type!=SCOPE && scope_node->type!=BLOCK) return NULL;
+
+    ScopeData* body = scope_node->val.scope;
+    ASTNode* iter_dec = ast_node(body->statements[0]);
+    if (!iter_dec || iter_dec->type!=NUM_DEC || body->stmt_count<2) return NULL;
+
+    Planner p;
+    memset(&p, 0, sizeof(p));
+    p.loop=loop;
+    p.body=body;
+    p.iter_slot=iter_dec->val.var.slot;
+    p.b=(BatchLoop*)calloc(1, sizeof(BatchLoop));
+    p.slot_regs=(uint32_t*)malloc(sizeof(uint32_t)*(body->slot_count+1));
+    if (!p.b || !p.slot_regs){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i=0; i<body->slot_count; i++) p.slot_regs[i]=UINT32_MAX;
+    new_reg(&p);//the iterator
+
+    //outer variables written anywhere in the body are never read as values
+    //that stay the same for a batch
+    for (int i=1; i<body->stmt_count; i++){
+        ASTNode* n = ast_node(body->statements[i]);
+        if (!n || (n->type!=NUM_SET && n->type!=NUM_REASSIGN)) continue;
+        if (n->val.var.depth==VAR_UNRESOLVED || n->val.var.depth==0){
+            p.failed=1;
+            break;
+        }
+
+        uint32_t acc = acc_of(&p, n);
+        if (acc!=UINT32_MAX){
+            ASTNode* m = ast_node(p.b->accs[acc]);
+            if (m->val.var.depth!=n->val.var.depth || m->val.var.slot!=n->val.var.slot) p.failed=1;
+            continue;
+        }
+
+        p.b->accs=(NodeId*)batch_grow(p.b->accs, &p.acc_capacity, p.b->acc_count, sizeof(NodeId));
+        p.b->accs[p.b->acc_count++]=body->statements[i];
+    }
+
+    for (int i=1; i<body->stmt_count && !p.failed; i++){
+        ASTNode* n = ast_node(body->statements[i]);
+        if (!n){
+            p.failed=1;
+            break;
+        }
+        plan_stmt(&p, n);
+    }
+
+    BatchLoop* b = p.b;
+    if (p.failed){
+        free(p.slot_regs);
+        free_batch(b);
+        return NULL;
+    }
+
+    for (uint32_t i=0; i<body->slot_count; i++){
+        if (p.slot_regs[i]==UINT32_MAX) continue;
+        b->temps=(uint32_t*)realloc(b->temps, sizeof(uint32_t)*2*(b->temp_count+1));
+        if (!b->temps){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        b->temps[2*b->temp_count]=i;
+        b->temps[2*b->temp_count+1]=p.slot_regs[i];
+        b->temp_count++;
+    }
+    free(p.slot_regs);
+
+    b->regs=(double*)calloc((size_t)b->reg_count*BATCH_WIDTH*batch_workers, sizeof(double));
+    b->acc_slots=(Slot**)malloc(sizeof(Slot*)*(b->acc_count*batch_workers+1));
+    b->acc_values=(double*)malloc(sizeof(double)*(b->acc_count*batch_workers+1));
+    if (!b->regs || !b->acc_slots || !b->acc_values){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int w=0; w<batch_workers; w++){
+        for (uint32_t i=0; i<b->src_count; i++){
+            if (b->srcs[i].kind!=SRC_CONST) continue;
+            double* r = b->regs+((size_t)w*b->reg_count+b->srcs[i].reg)*BATCH_WIDTH;
+            for (int k=0; k<BATCH_WIDTH; k++) r[k]=b->srcs[i].k;
+        }
+    }
+
+    b->next=batch_loops;
+    batch_loops=b;
+    return b;
+}
+
+static void batch_scope(ScopeData* data){
+    for (int i=0; i<data->stmt_count; i++){
+        ASTNode* n = ast_node(data->statements[i]);
+        if (!n) continue;
+
+        switch (n->type){
+            case LOOP: {
+                BatchLoop* b = n->op&LOOP_PARALLEL ? NULL : plan(n);//runs on the workers, loops inside it can batch
+                if (b){
+                    data->statements[i]=create_batch_node(data->statements[i], b);
+                } else if (ast_node(n->right)->type==SCOPE || ast_node(n->right)->type==BLOCK){
+                    batch_scope(ast_node(n->right)->val.scope);
+                }
+            } break;
+            case IF:
+            case IF_NUM:
+            case IF_BOOL: {
+                ASTNode* body = ast_node(n->right);
+                if (body->type==SCOPE || body->type==BLOCK) batch_scope(body->val.scope);
+            } break;
+            case SCOPE:
+            case BLOCK:
+                batch_scope(n->val.scope);
+                break;
+            default: break;
+        }
+    }
+}
+
+void batch_program(ASTNode* program, int workers){
+    if (!program) return;
+    batch_workers = workers>1 ? workers : 1;
+
+    if (!batch_kernel){
+#ifdef BATCH_X86_64
+        batch_kernel = __builtin_cpu_supports("avx2") ? kernel_avx2 : kernel_sse2;
+#else
+        batch_kernel = kernel_scalar;
+#endif
+    }
+
+    batch_scope(program->val.scope);
+}
+
+//the registers sources fill, 0 if one of them is not there
+static int fill(BatchLoop* b, double* regs, double x, uint32_t n, InductionData* steps, ExecutionContext* ctx){
+    double* iter = regs;
+    for (int k=0; k<BATCH_WIDTH; k++) iter[k]=x+k;
+
+    uint32_t ind = 0;
+    for (uint32_t i=0; i<b->src_count; i++){
+        BatchSrc* s = &b->srcs[i];
+        double* r = regs+(size_t)s->reg*BATCH_WIDTH;
+        ASTNode* node = ast_node(s->node);
+
+        switch (s->kind){
+            case SRC_REF: {
+                Slot* var = find_slot(node, ctx);
+                if (!var || !value_is_num(var->v)) return 0;
+                double v = value_num(var->v);
+                for (int k=0; k<BATCH_WIDTH; k++) r[k]=v;
+            } break;
+            case SRC_HOIST:
+                if (!node->op) return 0;
+                for (int k=0; k<BATCH_WIDTH; k++) r[k]=node->val.num;
+                break;
+            case SRC_OUTER_INDUCTION:
+                for (int k=0; k<BATCH_WIDTH; k++) r[k]=node->val.ind->v[0];
+                break;
+            case SRC_INDUCTION: {//v[0] at each lane, the state after n of them kept
+                InductionData d = *node->val.ind;
+                for (int k=0; k<BATCH_WIDTH; k++){
+                    if ((uint32_t)k==n) steps[ind]=d;
+                    r[k]=d.v[0];
+                    for (uint32_t j=0; j<d.degree; j++) d.v[j]+=d.v[j+1];
+                }
+                if (n==BATCH_WIDTH) steps[ind]=d;
+                ind++;
+            } break;
+            default: break;
+        }
+    }
+
+    Slot** acc_slots = b->acc_slots+(size_t)ctx->worker*b->acc_count;
+    double* acc_values = b->acc_values+(size_t)ctx->worker*b->acc_count;
+    for (uint32_t i=0; i<b->acc_count; i++){
+        Slot* var = find_slot(ast_node(b->accs[i]), ctx);
+        if (!var || !value_is_num(var->v)) return 0;
+        acc_slots[i]=var;
+        acc_values[i]=value_num(var->v);
+    }
+
+    return 1;
+}
+
+#define MAX_BATCH_INDUCTIONS 64
+
+int batch_run(BatchLoop* b, ASTNode* loop, ExecutionContext* ctx){
+    if (ctx->undo) return 0;//--watch logs every write
+
+    ScopeData* body = ast_node(loop->right)->val.scope;
+    Slot* frame = body->frame+(size_t)ctx->worker*body->worker_stride;
+    Slot* iter_var = &frame[ast_node(body->statements[0])->val.var.slot];
+    double x = value_num(iter_var->v);
+    double* regs = b->regs+(size_t)ctx->worker*b->reg_count*BATCH_WIDTH;
+
+    uint32_t n = 0;//iterations left, up to a batch
+    while (n<BATCH_WIDTH && x+n<loop->val.num) n++;
+    if (n<2) return 0;
+
+    InductionData steps[MAX_BATCH_INDUCTIONS];
+    uint32_t induction_count = 0;
+    for (uint32_t i=0; i<b->src_count; i++) induction_count+=b->srcs[i].kind==SRC_INDUCTION;
+    if (induction_count>MAX_BATCH_INDUCTIONS) return 0;
+
+    ScopeData* prev_scope = ctx->curr_scope;
+    ctx->curr_scope=body;
+    int ok = fill(b, regs, x, n, steps, ctx);
+    ctx->curr_scope=prev_scope;
+    if (!ok) return 0;
+
+    uint64_t lanes = n==64 ? ~0ull : (1ull<<n)-1;
+    for (uint32_t i=0; i<b->op_count; i++){
+        BatchOp* o = &b->ops[i];
+        double* r = regs;
+        uint64_t zero = batch_kernel(o->op, r+(size_t)o->dst*BATCH_WIDTH, r+(size_t)o->a*BATCH_WIDTH, r+(size_t)o->b*BATCH_WIDTH);
+        if (zero&lanes) return 0;//nothing ran yet, the LOOP fails at the right statement
+    }
+
+    double* acc = b->acc_values+(size_t)ctx->worker*b->acc_count;
+    for (uint32_t k=0; k<n; k++){
+        for (uint32_t i=0; i<b->step_count; i++){
+            BatchStep* s = &b->steps[i];
+            double v = regs[(size_t)s->reg*BATCH_WIDTH+k];
+
+            switch (s->kind){
+                case STEP_PRINT:
+                    exec_printf(ctx, s->op==PRINTLN ? "%f\n" : "%f", v);
+                    break;
+                case STEP_PRINT_ACC:
+                    exec_printf(ctx, s->op==PRINTLN ? "%f\n" : "%f", acc[s->acc]);
+                    break;
+                case STEP_SET:
+                    acc[s->acc]=v;
+                    break;
+                case STEP_FOLD:
+                    switch (s->op){
+                        case PLUS: acc[s->acc]+=v; break;
+                        case MINUS: acc[s->acc]-=v; break;
+                        case MULT: acc[s->acc]*=v; break;
+                        case DIV:
+                            if (v==0) runtime_error("error: division with 0!\n", "");
+                            acc[s->acc]/=v;
+                            break;
+                        case POW: acc[s->acc]=pow(acc[s->acc], v); break;
+                    }
+                    break;
+            }
+        }
+    }
+
+    Slot** acc_slots = b->acc_slots+(size_t)ctx->worker*b->acc_count;
+    for (uint32_t i=0; i<b->acc_count; i++) acc_slots[i]->v=num_value(acc[i]);
+    for (uint32_t i=0; i<b->temp_count; i++){
+        frame[b->temps[2*i]].v=num_value(regs[(size_t)b->temps[2*i+1]*BATCH_WIDTH+n-1]);
+    }
+    iter_var->v=num_value(x+n);
+
+    uint32_t ind = 0;
+    for (uint32_t i=0; i<b->src_count; i++){
+        if (b->srcs[i].kind!=SRC_INDUCTION) continue;
+        memcpy(ast_node(b->srcs[i].node)->val.ind->v, steps[ind++].v, sizeof(steps[0].v));
+    }
+
+    return 1;
+}
+
+void batch_free(){
+    while (batch_loops){
+        BatchLoop* b = batch_loops;
+        batch_loops=b->next;
+        free_batch(b);
+    }
+}
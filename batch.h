@@ -0,0 +1,75 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "ast.h"
+
+//for loops whose body only declares, prints and accumulates numbers computed
+//from the iterator and values the loop does not write become a BATCH node
+//over the LOOP after typecheck(). the first iteration runs as usual, the
+//rest BATCH_WIDTH at a time: every expression of the body for all of them
+//at once (AVX2 or SSE2 where there is one), then the prints and
+//accumulations lane by lane in statement order, so output and rounding are
+//those of the scalar loop. a batch that would divide by zero, or whose
+//variables are not all declared, runs through the LOOP instead. loops inside
+//a parallel loop are batched too, with registers for each worker
+
+#define BATCH_WIDTH 64//iterations per batch, a multiple of every vector width
+
+//dst = a op b for every lane of the registers
+typedef struct BatchOp {
+    uint8_t op;//BinOpT
+    uint32_t dst;
+    uint32_t a;
+    uint32_t b;
+} BatchOp;
+
+#define SRC_CONST 0//filled once
+#define SRC_REF 1//a variable the loop does not write, looked up per batch
+#define SRC_HOIST 2//cached by the first iteration
+#define SRC_INDUCTION 3//stepped per lane
+#define SRC_OUTER_INDUCTION 4//an enclosing loop's, the same for a whole batch
+
+//a register whose lanes come from outside the body's arithmetic
+typedef struct BatchSrc {
+    uint8_t kind;
+    NodeId node;
+    double k;//SRC_CONST
+    uint32_t reg;
+} BatchSrc;
+
+#define STEP_PRINT 0//reg
+#define STEP_PRINT_ACC 1//an accumulator's running value
+#define STEP_SET 2//acc = reg
+#define STEP_FOLD 3//acc = acc op reg
+
+//what one iteration does with the registers, in statement order
+typedef struct BatchStep {
+    uint8_t kind;
+    uint8_t op;//MacroT for prints, BinOpT for STEP_FOLD
+    uint32_t acc;
+    uint32_t reg;
+} BatchStep;
+
+typedef struct BatchLoop {
+    double* regs;//reg_count registers of BATCH_WIDTH lanes per worker, 0 is the iterator
+    uint32_t reg_count;
+    BatchOp* ops;
+    uint32_t op_count;
+    BatchSrc* srcs;
+    uint32_t src_count;
+    BatchStep* steps;
+    uint32_t step_count;
+    NodeId* accs;//a reassignment of each outer variable the loop writes
+    Slot** acc_slots;//acc_count per worker, like acc_values
+    double* acc_values;
+    uint32_t acc_count;
+    uint32_t* temps;//body slot, register of its last declaration, pairwise
+    uint32_t temp_count;
+    struct BatchLoop* next;
+} BatchLoop;
+
+void batch_program(ASTNode* program, int workers);//after resolve(), typecheck(), par_program() and jit_program()
+int batch_run(BatchLoop* batch, ASTNode* loop, ExecutionContext* ctx);//0 if the next iteration has to run through the LOOP
+void batch_free();
+
+#endif
@@ -0,0 +1,734 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+
+#include "emit.h"
+
+typedef struct {
+    char* data;
+    size_t count;
+    size_t capacity;
+} Buf;
+
+typedef struct {
+    Buf decls;//main()'s locals, known once the whole tree was seen
+    Buf body;
+    ScopeData** scopes;//by nesting level
+    uint32_t* ids;//of the scopes, for naming their slots
+    uint32_t scope_capacity;
+    uint32_t scope_count;
+    ScopeData** known;//open addressing, a scope entered from several places keeps its locals
+    uint32_t* known_ids;
+    uint32_t known_capacity;
+    uint32_t temps;
+    int indent;
+} Emitter;
+
+static const char* prelude =
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "#include <stdint.h>\n"
+    "#include <math.h>\n"
+    "#include <time.h>\n"
+    "\n"
+    "static void fail(const char* fmt, const char* name){\n"
+    "    fprintf(stderr, fmt, name);\n"
+    "    exit(EXIT_FAILURE);\n"
+    "}\n"
+    "\n"
+    "static double bits(uint64_t u){\n"
+    "    double x;\n"
+    "    memcpy(&x, &u, sizeof(x));\n"
+    "    return x;\n"
+    "}\n"
+    "\n"
+    "static double divide(double a, double b){\n"
+    "    if (b==0) fail(\"error: division with 0!\\n\", \"\");\n"
+    "    return a/b;\n"
+    "}\n"
+    "\n";
+
+static void out(Buf* b, const char* fmt, ...){
+    va_list args;
+
+    while (1){
+        va_start(args, fmt);
+        int n = vsnprintf(b->data+b->count, b->capacity-b->count, fmt, args);
+        va_end(args);
+
+        if (n<0){
+            fprintf(stderr, "error: emitting C failed\n");
+            exit(EXIT_FAILURE);
+        }
+        if (b->count+n<b->capacity){
+            b->count+=n;
+            return;
+        }
+
+        b->capacity = b->capacity ? b->capacity*2 : 4096;
+        while (b->capacity<=b->count+n) b->capacity*=2;
+        b->data=(char*)realloc(b->data, b->capacity);
+        if (!b->data){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+//a statement line of the body
+static void line(Emitter* e, const char* fmt, ...){
+    va_list args;
+    char buf[512];
+
+    va_start(args, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+
+    out(&e->body, "%*s%s\n", e->indent*4, "", buf);
+}
+
+//exact: hex floats, raw bits for what has no literal
+static void literal(char* buf, size_t size, double x){
+    if (isfinite(x)){
+        snprintf(buf, size, "%a", x);
+    } else {
+        uint64_t u;
+        memcpy(&u, &x, sizeof(u));
+        snprintf(buf, size, "bits(0x%016llxull)", (unsigned long long)u);
+    }
+}
+
+static uint8_t slot_type(ScopeData* scope, uint32_t slot){
+    uint8_t type = scope->slot_info[slot].type;
+    return type ? type : TY_NUM;
+}
+
+//every slot of a scope becomes locals named after its id
+static void open_scope(Emitter* e, ScopeData* data, uint32_t level){
+    if (level>=e->scope_capacity){
+        e->scope_capacity = e->scope_capacity ? e->scope_capacity*2 : 16;
+        e->scopes=(ScopeData**)realloc(e->scopes, sizeof(ScopeData*)*e->scope_capacity);
+        e->ids=(uint32_t*)realloc(e->ids, sizeof(uint32_t)*e->scope_capacity);
+        if (!e->scopes || !e->ids){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (2*(e->scope_count+1)>e->known_capacity){
+        uint32_t capacity = e->known_capacity ? e->known_capacity*2 : 64;
+        ScopeData** known = (ScopeData**)calloc(capacity, sizeof(ScopeData*));
+        uint32_t* known_ids = (uint32_t*)malloc(sizeof(uint32_t)*capacity);
+        if (!known || !known_ids){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (uint32_t i=0; i<e->known_capacity; i++){
+            if (!e->known[i]) continue;
+            uint32_t h = (uint32_t)(((uintptr_t)e->known[i]>>4)*2654435761u)&(capacity-1);
+            while (known[h]) h=(h+1)&(capacity-1);
+            known[h]=e->known[i];
+            known_ids[h]=e->known_ids[i];
+        }
+        free(e->known);
+        free(e->known_ids);
+        e->known=known;
+        e->known_ids=known_ids;
+        e->known_capacity=capacity;
+    }
+
+    e->scopes[level]=data;
+    uint32_t h = (uint32_t)(((uintptr_t)data>>4)*2654435761u)&(e->known_capacity-1);
+    while (e->known[h] && e->known[h]!=data) h=(h+1)&(e->known_capacity-1);
+    if (e->known[h]){
+        e->ids[level]=e->known_ids[h];
+        return;
+    }
+
+    uint32_t id = e->scope_count++;
+    e->known[h]=data;
+    e->known_ids[h]=id;
+    e->ids[level]=id;
+
+    for (uint32_t i=0; i<data->slot_count; i++){
+        uint8_t type = slot_type(data, i);
+        out(&e->decls, "    int l%u_%u = 0;//%s\n", id, i, sym_name(data->slot_info[i].sym));
+        if (type&TY_NUM) out(&e->decls, "    double n%u_%u = 0;\n", id, i);
+        if (type&TY_BOOL) out(&e->decls, "    int b%u_%u = 0;\n", id, i);
+        if (type==TY_ANY) out(&e->decls, "    int t%u_%u = 0;//1 while it is a bool\n", id, i);
+    }
+}
+
+//a slot lookup_slot() might return
+typedef struct {
+    uint32_t id;
+    uint32_t slot;
+    uint8_t type;
+} Cand;
+
+//candidates in order, returns how many
+static uint32_t cands_of(Emitter* e, ASTNode* n, uint32_t level, Cand* cands, uint32_t max){
+    if (n->val.var.depth==VAR_UNRESOLVED) return 0;
+
+    uint32_t l = level-n->val.var.depth;
+    uint32_t slot = n->val.var.slot;
+    uint32_t count = 0;
+
+    while (count<max){
+        cands[count].id=e->ids[l];
+        cands[count].slot=slot;
+        cands[count].type=slot_type(e->scopes[l], slot);
+        count++;
+
+        SlotInfo* info = &e->scopes[l]->slot_info[slot];
+        if (!info->outer_depth) break;
+        l-=info->outer_depth;
+        slot=info->outer_slot;
+    }
+
+    return count;
+}
+
+#define MAX_EMIT_CANDS 256
+
+//C expressions for a candidate: is it a bool, its num, its bool
+static void cand_exprs(Cand* c, char* is_bool, char* num, char* b, size_t size){
+    if (c->type==TY_ANY) snprintf(is_bool, size, "t%u_%u", c->id, c->slot);
+    else snprintf(is_bool, size, "%d", c->type==TY_BOOL);
+    if (c->type&TY_NUM) snprintf(num, size, "n%u_%u", c->id, c->slot);
+    else snprintf(num, size, "0.0");
+    if (c->type&TY_BOOL) snprintf(b, size, "b%u_%u", c->id, c->slot);
+    else snprintf(b, size, "0");
+}
+
+#define REF_NUM 0//NUM_REF in a numeric context, no type check
+#define REF_VAR_NUM 1//VAR_REF that has to be a num
+#define REF_BOOL 2//BOOL_REF as a bool
+#define REF_NUM_TRUTH 3//NUM_REF as a bool
+#define REF_VAR_BOOL 4//VAR_REF as a bool
+#define REF_IF 5//IF_NUM/IF_BOOL on a reference
+
+//t = the variable, through the first declared candidate. missing fails
+//with the interpreter's message for the context
+static uint32_t ref(Emitter* e, ASTNode* n, uint32_t level, int kind){
+    Cand cands[MAX_EMIT_CANDS];
+    uint32_t count = cands_of(e, n, level, cands, MAX_EMIT_CANDS);
+    uint32_t t = e->temps++;
+    const char* name = sym_name(n->sym);
+    int num = kind==REF_NUM || kind==REF_VAR_NUM;
+
+    line(e, "%s t%u;", num ? "double" : "int", t);
+    for (uint32_t i=0; i<count; i++){
+        char is_bool[64], x[64], b[64];
+        cand_exprs(&cands[i], is_bool, x, b, sizeof(x));
+
+        line(e, "%sif (l%u_%u){", i ? "else " : "", cands[i].id, cands[i].slot);
+        e->indent++;
+        switch (kind){
+            case REF_NUM:
+                line(e, "t%u = %s;", t, x);
+                break;
+            case REF_VAR_NUM:
+                line(e, "if (%s) fail(\"error: expecred numeric variable '%%s'\\n\", \"%s\");", is_bool, name);
+                line(e, "t%u = %s;", t, x);
+                break;
+            case REF_BOOL:
+                line(e, "t%u = %s;", t, b);
+                break;
+            case REF_NUM_TRUTH:
+                line(e, "t%u = %s!=0;", t, x);
+                break;
+            case REF_VAR_BOOL:
+            case REF_IF:
+                line(e, "t%u = %s ? %s : %s!=0;", t, is_bool, b, x);
+                break;
+        }
+        e->indent--;
+        line(e, "}");
+    }
+
+    const char* msg = kind==REF_NUM || kind==REF_VAR_NUM ? "error: expecred numeric variable '%s'\\n" :
+                      kind==REF_IF ? "error: variable '%s' not found in scope\\n" :
+                      "error: expected boolean variable '%s'\\n";
+    line(e, "%sfail(\"%s\", \"%s\");", count ? "else " : "", msg, name);
+    return t;
+}
+
+static uint32_t bool_expr(Emitter* e, NodeId id, uint32_t level);
+
+//num_evaluate_ast()
+static uint32_t num_expr(Emitter* e, NodeId id, uint32_t level){
+    ASTNode* n = ast_node(id);
+    char lit[64];
+
+    switch (n->type){
+        case NUM_VAL: {
+            uint32_t t = e->temps++;
+            literal(lit, sizeof(lit), n->val.num);
+            line(e, "double t%u = %s;", t, lit);
+            return t;
+        }
+        case B_OP: {
+            uint32_t a = num_expr(e, n->left, level);
+            uint32_t b = num_expr(e, n->right, level);
+            uint32_t t = e->temps++;
+            switch (n->op){
+                case PLUS: line(e, "double t%u = t%u+t%u;", t, a, b); break;
+                case MINUS: line(e, "double t%u = t%u-t%u;", t, a, b); break;
+                case MULT: line(e, "double t%u = t%u*t%u;", t, a, b); break;
+                case DIV: line(e, "double t%u = divide(t%u, t%u);", t, a, b); break;
+                case POW: line(e, "double t%u = pow(t%u, t%u);", t, a, b); break;
+                default: line(e, "double t%u = 0;", t); break;
+            }
+            return t;
+        }
+        case N_OP: {
+            NaryData* nary = n->val.nary;
+            uint32_t acc = num_expr(e, nary->args[0], level);
+
+            for (uint32_t i=1; i<nary->count; i++){
+                uint32_t v = num_expr(e, nary->args[i], level);
+                uint32_t t = e->temps++;
+                switch (nary->ops[i]){
+                    case PLUS: line(e, "double t%u = t%u+t%u;", t, acc, v); break;
+                    case MINUS: line(e, "double t%u = t%u-t%u;", t, acc, v); break;
+                    case MULT: line(e, "double t%u = t%u*t%u;", t, acc, v); break;
+                    case DIV: line(e, "double t%u = divide(t%u, t%u);", t, acc, v); break;
+                    case POW: line(e, "double t%u = pow(t%u, t%u);", t, v, acc); break;//args run right to left
+                    default: line(e, "double t%u = t%u;", t, acc); break;
+                }
+                acc=t;
+            }
+            return acc;
+        }
+        case VAR_REF:
+            return ref(e, n, level, REF_VAR_NUM);
+        case NUM_REF:
+            return ref(e, n, level, REF_NUM);
+        case HOIST: {
+            uint32_t t = e->temps++;
+            line(e, "double t%u;", t);
+            line(e, "if (!hv%u){", id);
+            e->indent++;
+            uint32_t v = num_expr(e, n->left, level);
+            line(e, "h%u = t%u;", id, v);
+            line(e, "hv%u = 1;", id);
+            e->indent--;
+            line(e, "}");
+            line(e, "t%u = h%u;", t, id);
+            return t;
+        }
+        case INDUCTION: {
+            uint32_t t = e->temps++;
+            line(e, "double t%u = ind%u[0];", t, id);
+            return t;
+        }
+        default: {//0 without evaluating it
+            uint32_t t = e->temps++;
+            line(e, "double t%u = 0;", t);
+            return t;
+        }
+    }
+}
+
+//bool_evaluate_ast()
+static uint32_t bool_expr(Emitter* e, NodeId id, uint32_t level){
+    ASTNode* n = ast_node(id);
+
+    switch (n->type){
+        case BOOL_VAL: {
+            uint32_t t = e->temps++;
+            line(e, "int t%u = %d;", t, n->val.bool_val);
+            return t;
+        }
+        case COND: {
+            uint32_t a = num_expr(e, n->left, level);
+            uint32_t b = num_expr(e, n->right, level);
+            uint32_t t = e->temps++;
+            static const char* ops[] = {"==", "<", ">"};
+            line(e, "int t%u = t%u%st%u;", t, a, ops[n->op], b);
+            return t;
+        }
+        case BOOL_REF:
+            return ref(e, n, level, REF_BOOL);
+        case NUM_REF:
+            return ref(e, n, level, REF_NUM_TRUTH);
+        case VAR_REF:
+            return ref(e, n, level, REF_VAR_BOOL);
+        case NUM_VAL:
+        case B_OP:
+        case N_OP:
+        case HOIST:
+        case INDUCTION: {
+            uint32_t v = num_expr(e, id, level);
+            uint32_t t = e->temps++;
+            line(e, "int t%u = t%u!=0;", t, v);
+            return t;
+        }
+        default: {
+            uint32_t t = e->temps++;
+            line(e, "int t%u = 0;", t);
+            line(e, "fail(\"%%s\", \"error: non-boolean expr\\n\");");
+            return t;
+        }
+    }
+}
+
+static void stmt(Emitter* e, NodeId id, uint32_t level);
+
+static void scope(Emitter* e, ScopeData* data, uint32_t level, int first){
+    for (int i=first; i<data->stmt_count; i++){
+        stmt(e, data->statements[i], level);
+    }
+}
+
+//the variable a declaration or reassignment writes
+static void store(Emitter* e, Cand* c, int boolean, uint32_t t){
+    if (boolean) line(e, "b%u_%u = t%u;", c->id, c->slot, t);
+    else line(e, "n%u_%u = t%u;", c->id, c->slot, t);
+    if (c->type==TY_ANY) line(e, "t%u_%u = %d;", c->id, c->slot, boolean);
+}
+
+static void declare(Emitter* e, ASTNode* n, uint32_t level, uint32_t t){
+    Cand c;
+    c.id=e->ids[level];
+    c.slot=n->val.var.slot;
+    c.type=slot_type(e->scopes[level], c.slot);
+
+    store(e, &c, n->type==BOOL_DEC, t);
+    line(e, "l%u_%u = 1;", c.id, c.slot);
+}
+
+//execute_reassign_*() and execute_set_*()
+static void assign(Emitter* e, ASTNode* n, uint32_t level, uint32_t t){
+    Cand cands[MAX_EMIT_CANDS];
+    uint32_t count = cands_of(e, n, level, cands, MAX_EMIT_CANDS);
+    int boolean = n->type==BOOL_REASSIGN || n->type==BOOL_SET;
+    int checked = n->type==NUM_REASSIGN || n->type==BOOL_REASSIGN;
+    const char* name = sym_name(n->sym);
+
+    for (uint32_t i=0; i<count; i++){
+        char is_bool[64], x[64], b[64];
+        cand_exprs(&cands[i], is_bool, x, b, sizeof(x));
+
+        line(e, "%sif (l%u_%u){", i ? "else " : "", cands[i].id, cands[i].slot);
+        e->indent++;
+        if (checked){
+            if (boolean) line(e, "if (!%s) fail(\"error: cannot assign boolean value to non-boolean variable '%%s'\\n\", \"%s\");", is_bool, name);
+            else line(e, "if (%s) fail(\"error: cannot assign numeric value to non-numeric variable '%%s'\\n\", \"%s\");", is_bool, name);
+        }
+        if ((cands[i].type&(boolean ? TY_BOOL : TY_NUM))) store(e, &cands[i], boolean, t);
+        e->indent--;
+        line(e, "}");
+    }
+
+    const char* msg = boolean ? "error: variable '%s' not found for reassignment\\n" : "error: varible '%s' not found\\n";
+    line(e, "%sfail(\"%s\", \"%s\");", count ? "else " : "", msg, name);
+}
+
+static void print_value(Emitter* e, int boolean, int ln, const char* value){
+    if (boolean) line(e, "printf(\"%s\", %s ? \"true\" : \"false\");", ln ? "%s\\n" : "%s", value);
+    else line(e, "printf(\"%s\", %s);", ln ? "%f\\n" : "%f", value);
+}
+
+//MACRO, PRINT_NUM and PRINT_BOOL
+static void print(Emitter* e, ASTNode* n, uint32_t level){
+    ASTNode* val = ast_node(n->left);
+    int ln = n->op==PRINTLN;
+    char t[32];
+
+    int quiet_ref = (n->type==PRINT_NUM && val->type==NUM_REF) || (n->type==PRINT_BOOL && val->type==BOOL_REF) ||
+                    (n->type==MACRO && val->type==VAR_REF);
+    if (quiet_ref){//prints nothing if it does not exist
+        Cand cands[MAX_EMIT_CANDS];
+        uint32_t count = cands_of(e, val, level, cands, MAX_EMIT_CANDS);
+
+        for (uint32_t i=0; i<count; i++){
+            char is_bool[64], x[64], b[64];
+            cand_exprs(&cands[i], is_bool, x, b, sizeof(x));
+
+            line(e, "%sif (l%u_%u){", i ? "else " : "", cands[i].id, cands[i].slot);
+            e->indent++;
+            if (n->type==PRINT_NUM){
+                print_value(e, 0, ln, x);
+            } else if (n->type==PRINT_BOOL){
+                print_value(e, 1, ln, b);
+            } else {
+                line(e, "if (%s) printf(\"%%s\", %s ? \"true\" : \"false\");", is_bool, b);
+                line(e, "else printf(\"%%f\", %s);", x);
+                if (ln) line(e, "printf(\"\\n\");");
+            }
+            e->indent--;
+            line(e, "}");
+        }
+        return;
+    }
+
+    int num = n->type==PRINT_NUM ||
+              (n->type==MACRO && (val->type==NUM_VAL || val->type==NUM_REF || val->type==B_OP || val->type==N_OP));
+    int boolean = n->type==PRINT_BOOL ||
+                  (n->type==MACRO && (val->type==BOOL_VAL || val->type==BOOL_REF || val->type==COND));
+
+    if (num){
+        snprintf(t, sizeof(t), "t%u", num_expr(e, n->left, level));
+        print_value(e, 0, ln, t);
+    } else if (boolean){
+        snprintf(t, sizeof(t), "t%u", bool_expr(e, n->left, level));
+        print_value(e, 1, ln, t);
+    }
+}
+
+//execute_if() and execute_if_typed()
+static void if_stmt(Emitter* e, ASTNode* n, uint32_t level){
+    ASTNode* cond = ast_node(n->left);
+    uint32_t t;
+
+    line(e, "{");
+    e->indent++;
+
+    if (n->type!=IF){
+        if (cond->type==NUM_REF || cond->type==BOOL_REF) t=ref(e, cond, level, REF_IF);
+        else if (n->type==IF_NUM){
+            uint32_t v = num_expr(e, n->left, level);
+            t=e->temps++;
+            line(e, "int t%u = t%u!=0;", t, v);
+        } else t=bool_expr(e, n->left, level);
+    } else {
+        switch (cond->type){
+            case VAR_REF:
+                t=ref(e, cond, level, REF_IF);
+                break;
+            case COND:
+            case BOOL_REF:
+            case BOOL_VAL:
+                t=bool_expr(e, n->left, level);
+                break;
+            case NUM_REF:
+            case NUM_VAL:
+            case B_OP:
+            case N_OP: {
+                uint32_t v = num_expr(e, n->left, level);
+                t=e->temps++;
+                line(e, "int t%u = t%u!=0;", t, v);
+            } break;
+            default:
+                t=e->temps++;
+                line(e, "int t%u = 0;", t);
+                line(e, "fail(\"%%s\", \"Error: Invalid condition type in if statement\\n\");");
+                break;
+        }
+    }
+
+    line(e, "if (t%u){", t);
+    e->indent++;
+    stmt(e, n->right, level);
+    e->indent--;
+    line(e, "}");
+
+    e->indent--;
+    line(e, "}");
+}
+
+static void loop(Emitter* e, ASTNode* n, uint32_t level){
+    ASTNode* scope_node = ast_node(n->right);
+    if (scope_node->type!=SCOPE && scope_node->type!=BLOCK){
+        line(e, "fail(\"%%s\", \"loop must be a scope\\n\");");
+        return;
+    }
+
+    ScopeData* body = scope_node->val.scope;
+    ASTNode* iter_dec = ast_node(body->statements[0]);
+    if (!iter_dec || iter_dec->type!=NUM_DEC){
+        line(e, "fail(\"%%s\", \"first stmt in loop isnt num\\n\");");
+        return;
+    }
+
+    open_scope(e, body, level+1);
+    line(e, "{");
+    e->indent++;
+
+    declare(e, iter_dec, level+1, num_expr(e, iter_dec->left, level+1));
+    char iter[32];
+    snprintf(iter, sizeof(iter), "n%u_%u", e->ids[level+1], iter_dec->val.var.slot);
+
+    for (NodeId h=n->left; h; h=ast_node(h)->right){
+        ASTNode* m = ast_node(h);
+        if (m->type==HOIST){
+            out(&e->decls, "    double h%u = 0;\n    int hv%u = 0;\n", h, h);
+            line(e, "hv%u = 0;", h);
+        } else {
+            out(&e->decls, "    double ind%u[4];\n", h);
+            for (int k=0; k<4; k++){
+                char lit[64];
+                literal(lit, sizeof(lit), m->val.ind->init[k]);
+                line(e, "ind%u[%d] = %s;", h, k, lit);
+            }
+        }
+    }
+
+    char end[64];
+    literal(end, sizeof(end), n->val.num);
+    line(e, "while (!(%s>=%s)){", iter, end);
+    e->indent++;
+
+    scope(e, body, level+1, 1);
+
+    line(e, "%s = %s+1;", iter, iter);
+    for (NodeId h=n->left; h && ast_node(h)->type==INDUCTION; h=ast_node(h)->right){
+        InductionData* ind = ast_node(h)->val.ind;
+        for (uint32_t k=0; k<ind->degree; k++) line(e, "ind%u[%u] += ind%u[%u];", h, k, h, k+1);
+    }
+
+    e->indent--;
+    line(e, "}");
+    e->indent--;
+    line(e, "}");
+}
+
+//execute()
+static void stmt(Emitter* e, NodeId id, uint32_t level){
+    ASTNode* n = ast_node(id);
+    if (!n){
+        line(e, "printf(\"Error: NULL node passed to execute\\n\");");
+        return;
+    }
+
+    switch (n->type){
+        case NUM_DEC:
+            line(e, "{");
+            e->indent++;
+            declare(e, n, level, num_expr(e, n->left, level));
+            e->indent--;
+            line(e, "}");
+            break;
+        case BOOL_DEC:
+            line(e, "{");
+            e->indent++;
+            declare(e, n, level, bool_expr(e, n->left, level));
+            e->indent--;
+            line(e, "}");
+            break;
+        case NUM_REASSIGN:
+        case NUM_SET:
+        case BOOL_REASSIGN:
+        case BOOL_SET: {
+            int boolean = n->type==BOOL_REASSIGN || n->type==BOOL_SET;
+            line(e, "{");
+            e->indent++;
+            assign(e, n, level, boolean ? bool_expr(e, n->left, level) : num_expr(e, n->left, level));
+            e->indent--;
+            line(e, "}");
+        } break;
+        case MACRO:
+        case PRINT_NUM:
+        case PRINT_BOOL:
+            line(e, "{");
+            e->indent++;
+            print(e, n, level);
+            e->indent--;
+            line(e, "}");
+            break;
+        case IF:
+        case IF_NUM:
+        case IF_BOOL:
+            if_stmt(e, n, level);
+            break;
+        case SCOPE:
+        case BLOCK:
+            open_scope(e, n->val.scope, level+1);
+            scope(e, n->val.scope, level+1, 0);
+            break;
+        case LOOP:
+            loop(e, n, level);
+            break;
+        case NATIVE:
+            stmt(e, n->left, level);
+            break;
+        default:
+            line(e, "printf(\"Unknown node type: %%d\\n\", %d);", n->type);
+            break;
+    }
+}
+
+int emit_c(ASTNode* program, FILE* file){
+    Emitter e;
+    memset(&e, 0, sizeof(e));
+    e.indent=1;
+
+    open_scope(&e, program->val.scope, 0);
+    scope(&e, program->val.scope, 0, 0);
+
+    fputs(prelude, file);
+    fputs("int main(void){\n", file);
+    fputs("    clock_t start = clock();\n\n", file);
+    if (e.decls.count) fwrite(e.decls.data, 1, e.decls.count, file);
+    fputs("\n", file);
+    if (e.body.count) fwrite(e.body.data, 1, e.body.count, file);
+    fputs("\n    double t = ((double)(clock()-start))/CLOCKS_PER_SEC;\n", file);
+    fputs("    printf(\"\\nexecution time: %f \\n\", t);\n", file);
+    fputs("    return 0;\n}\n", file);
+
+    free(e.decls.data);
+    free(e.body.data);
+    free(e.scopes);
+    free(e.ids);
+    free(e.known);
+    free(e.known_ids);
+
+    return ferror(file) ? -1 : 0;
+}
+
+int build_c(ASTNode* program, const char* filename){
+    size_t len = strlen(filename);
+    if (len<=5 || strcmp(filename+len-5, ".pavo")!=0 || strchr(filename, '\'')){
+        fprintf(stderr, "error: cannot build '%s'\n", filename);
+        return -1;
+    }
+
+    char* exe = (char*)malloc(len+3);
+    char* src = (char*)malloc(len+3);
+    if (!exe || !src){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(exe, filename, len-5);
+    exe[len-5]='\0';
+    snprintf(src, len+3, "%s.c", exe);
+
+    FILE* file = fopen(src, "w");
+    if (!file){
+        fprintf(stderr, "error: cannot write '%s'\n", src);
+        free(exe);
+        free(src);
+        return -1;
+    }
+    int status = emit_c(program, file);
+    if (fclose(file)!=0) status=-1;
+
+    if (status==0){
+        //no FMA contraction, results have to match the interpreter's bit for bit
+        const char* cc = getenv("CC");
+        if (!cc || !*cc) cc=EMIT_CC;
+
+        size_t size = strlen(cc)+2*len+64;
+        char* cmd = (char*)malloc(size);
+        if (!cmd){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        snprintf(cmd, size, "%s -O2 -ffp-contract=off -o '%s' '%s' -lm", cc, exe, src);
+
+        if (system(cmd)!=0){
+            fprintf(stderr, "error: '%s' failed\n", cmd);
+            status=-1;
+        }
+        free(cmd);
+    }
+
+    free(exe);
+    free(src);
+    return status;
+}
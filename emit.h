@@ -0,0 +1,19 @@
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <stdio.h>
+
+#include "ast.h"
+
+//--emit-c: the resolved, typechecked tree as a standalone C program with the
+//same output and errors. every slot is a local of main(), a double or an int
+//(both and a tag for a name declared as either) plus whether its declaration
+//ran yet, so lookups still take the outer variable until then. expressions
+//go through temporaries in the interpreter's evaluation order
+
+#define EMIT_CC "cc"//--build's compiler unless $CC is set
+
+int emit_c(ASTNode* program, FILE* out);
+int build_c(ASTNode* program, const char* filename);//--build, next to the source
+
+#endif
@@ -0,0 +1,905 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "jit.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define JIT_X86_64
+#endif
+
+static JitLoop* jit_loops;//all compiled loops, for jit_free()
+
+#ifdef JIT_X86_64
+
+#define JIT_TEMPS 8//xmm0-7 hold the temporaries of an expression
+#define JIT_CACHED 8//xmm8-15 hold variables
+#define SPILL_SIZE 128//temporaries, then cached variables, saved around calls
+#define MAX_CANDS 64
+#define JIT_MIN_WORK 64//iterations under which compiling a loop costs more than it saves
+
+#define RAX 0
+#define RCX 1
+#define RBX 3//the slot table
+#define RSP 4
+
+//condition codes of jcc
+#define CC_AE 0x3
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_P 0xA
+
+typedef struct {
+    uint8_t* code;//of every loop compiled so far, mapped at the end
+    size_t count;
+    size_t capacity;
+    size_t start;//of the function being compiled
+    int failed;//the loop uses something not supported here
+
+    ScopeData** scopes;//by nesting level, like the vm's compiler
+    uint32_t scope_capacity;
+    uint32_t base;//level of the loop's body, scopes from it on run inside the loop
+
+    Slot** declared;//slots inside the loop whose declaration ran earlier in the iteration
+    uint32_t declared_count;
+    uint32_t declared_capacity;
+
+    JitVar* vars;
+    uint32_t var_count;
+    uint32_t var_capacity;
+    Slot** cands;
+    uint32_t cand_count;
+    uint32_t cand_capacity;
+} Jit;
+
+static void* jit_grow(void* p, uint32_t* capacity, uint32_t count, size_t size){
+    if (count<*capacity) return p;
+
+    *capacity = *capacity ? *capacity*2 : 16;
+    p=realloc(p, size*(*capacity));
+    if (!p){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void byte(Jit* j, uint8_t b){
+    if (j->count==j->capacity){
+        j->capacity = j->capacity ? j->capacity*2 : 4096;
+        j->code=(uint8_t*)realloc(j->code, j->capacity);
+        if (!j->code){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    j->code[j->count++]=b;
+}
+
+static void imm32(Jit* j, uint32_t x){
+    for (int i=0; i<4; i++) byte(j, x>>(8*i));
+}
+
+static void imm64(Jit* j, uint64_t x){
+    for (int i=0; i<8; i++) byte(j, x>>(8*i));
+}
+
+//op xmm, xmm behind a mandatory prefix (0x66 or 0xF2)
+static void sse_rr(Jit* j, uint8_t prefix, uint8_t op, int dst, int src){
+    byte(j, prefix);
+    if (dst>=8 || src>=8) byte(j, 0x40 | (dst>=8)<<2 | (src>=8));
+    byte(j, 0x0F);
+    byte(j, op);
+    byte(j, 0xC0 | (dst&7)<<3 | (src&7));
+}
+
+//op xmm, [base+disp32]
+static void sse_rm(Jit* j, uint8_t prefix, uint8_t op, int reg, int base, int32_t disp){
+    byte(j, prefix);
+    if (reg>=8) byte(j, 0x44);
+    byte(j, 0x0F);
+    byte(j, op);
+    byte(j, 0x80 | (reg&7)<<3 | base);
+    if (base==RSP) byte(j, 0x24);
+    imm32(j, (uint32_t)disp);
+}
+
+#define MOVSD_LOAD(j, x, base, disp) sse_rm(j, 0xF2, 0x10, x, base, disp)
+#define MOVSD_STORE(j, x, base, disp) sse_rm(j, 0xF2, 0x11, x, base, disp)
+#define MOVAPD(j, dst, src) sse_rr(j, 0x66, 0x28, dst, src)
+#define XORPD(j, x) sse_rr(j, 0x66, 0x57, x, x)
+#define UCOMISD(j, a, b) sse_rr(j, 0x66, 0x2E, a, b)
+
+static void mov_rax_imm(Jit* j, uint64_t x){
+    byte(j, 0x48); byte(j, 0xB8); imm64(j, x);
+}
+
+static void mov_rcx_imm(Jit* j, uint64_t x){
+    byte(j, 0x48); byte(j, 0xB9); imm64(j, x);
+}
+
+//movq xmm, rax
+static void movq_x_rax(Jit* j, int x){
+    byte(j, 0x66); byte(j, 0x48 | (x>=8)<<2); byte(j, 0x0F); byte(j, 0x6E);
+    byte(j, 0xC0 | (x&7)<<3);
+}
+
+static void call_abs(Jit* j, const void* fn){
+    mov_rax_imm(j, (uint64_t)(uintptr_t)fn);
+    byte(j, 0xFF); byte(j, 0xD0);//call rax
+}
+
+static size_t jcc(Jit* j, uint8_t cc){
+    byte(j, 0x0F); byte(j, 0x80 | cc);
+    imm32(j, 0);
+    return j->count-4;
+}
+
+static size_t jmp(Jit* j){
+    byte(j, 0xE9);
+    imm32(j, 0);
+    return j->count-4;
+}
+
+static void patch(Jit* j, size_t at, size_t target){
+    int32_t rel = (int32_t)(target-(at+4));
+    memcpy(j->code+at, &rel, 4);
+}
+
+static void jmp_to(Jit* j, size_t target){
+    patch(j, jmp(j), target);
+}
+
+//eax = al, after a setcc
+static void movzx_eax_al(Jit* j){
+    byte(j, 0x0F); byte(j, 0xB6); byte(j, 0xC0);
+}
+
+//eax = x!=0 (a NaN is not 0), uses t
+static void truth(Jit* j, int x, int t){
+    XORPD(j, t);
+    UCOMISD(j, x, t);
+    byte(j, 0x0F); byte(j, 0x95); byte(j, 0xC0);//setne al
+    byte(j, 0x0F); byte(j, 0x9A); byte(j, 0xC1);//setp cl
+    byte(j, 0x08); byte(j, 0xC8);//or al, cl
+    movzx_eax_al(j);
+}
+
+static void const_num(Jit* j, int x, double v){
+    uint64_t bits = num_value(v);
+    if (!bits){
+        XORPD(j, x);
+        return;
+    }
+    mov_rax_imm(j, bits);
+    movq_x_rax(j, x);
+}
+
+//rax = the var's slot
+static void var_addr(Jit* j, uint32_t var){
+    byte(j, 0x48); byte(j, 0x8B); byte(j, 0x83);//mov rax, [rbx+disp32]
+    imm32(j, var*8);
+}
+
+static void load_num(Jit* j, uint32_t var, int x){
+    if (j->vars[var].reg>=0){
+        MOVAPD(j, x, 8+j->vars[var].reg);
+        return;
+    }
+    var_addr(j, var);
+    MOVSD_LOAD(j, x, RAX, 0);
+}
+
+static void store_num(Jit* j, uint32_t var, int x){
+    if (j->vars[var].reg>=0){
+        MOVAPD(j, 8+j->vars[var].reg, x);
+        return;
+    }
+    var_addr(j, var);
+    MOVSD_STORE(j, x, RAX, 0);
+}
+
+//eax = the bool in the var
+static void load_bool(Jit* j, uint32_t var){
+    var_addr(j, var);
+    byte(j, 0x48); byte(j, 0x8B); byte(j, 0x00);//mov rax, [rax]
+    mov_rcx_imm(j, VAL_TRUE);
+    byte(j, 0x48); byte(j, 0x39); byte(j, 0xC8);//cmp rax, rcx
+    byte(j, 0x0F); byte(j, 0x94); byte(j, 0xC0);//sete al
+    movzx_eax_al(j);
+}
+
+//the bool in eax into the var
+static void store_bool(Jit* j, uint32_t var){
+    mov_rcx_imm(j, VAL_FALSE);
+    byte(j, 0x48); byte(j, 0x01); byte(j, 0xC1);//add rcx, rax, VAL_TRUE is VAL_FALSE+1
+    var_addr(j, var);
+    byte(j, 0x48); byte(j, 0x89); byte(j, 0x08);//mov [rax], rcx
+}
+
+//calls clobber every xmm register
+static void save_cached(Jit* j, int load){
+    for (uint32_t i=0; i<j->var_count; i++){
+        int r = j->vars[i].reg;
+        if (r<0) continue;
+        if (load) MOVSD_LOAD(j, 8+r, RSP, JIT_TEMPS*8+r*8);
+        else MOVSD_STORE(j, 8+r, RSP, JIT_TEMPS*8+r*8);
+    }
+}
+
+static void save_temps(Jit* j, int count, int load){
+    for (int k=0; k<count; k++){
+        if (load) MOVSD_LOAD(j, k, RSP, k*8);
+        else MOVSD_STORE(j, k, RSP, k*8);
+    }
+}
+
+static void jit_print_num(double x, int ln){
+    printf(ln ? "%f\n" : "%f", x);
+}
+
+static void jit_print_bool(int b, int ln){
+    printf(ln ? "%s\n" : "%s", b ? "true" : "false");
+}
+
+static void jit_div_zero(){
+    fprintf(stderr, "error: division with 0!\n");
+    exit(EXIT_FAILURE);
+}
+
+//x(d) = pow(x(d), x(d+1)), or pow(x(d+1), x(d)) for N_OP's right to left args
+static void call_pow(Jit* j, int d, int reversed){
+    save_temps(j, d, 0);
+    save_cached(j, 0);
+
+    int a = reversed ? d+1 : d;
+    int b = reversed ? d : d+1;
+    if (a==1 && b==0){
+        MOVAPD(j, d+2, 0);
+        b=d+2;
+    }
+    if (a!=0) MOVAPD(j, 0, a);
+    if (b!=1) MOVAPD(j, 1, b);
+
+    call_abs(j, (const void*)&pow);
+    if (d!=0) MOVAPD(j, d, 0);
+
+    save_cached(j, 1);
+    save_temps(j, d, 1);
+}
+
+//x(d) op= x(d+1)
+static void arith(Jit* j, int op, int d, int reversed){
+    switch (op){
+        case PLUS: sse_rr(j, 0xF2, 0x58, d, d+1); break;
+        case MINUS: sse_rr(j, 0xF2, 0x5C, d, d+1); break;
+        case MULT: sse_rr(j, 0xF2, 0x59, d, d+1); break;
+        case DIV: {
+            XORPD(j, d+2);
+            UCOMISD(j, d+1, d+2);
+            size_t nan = jcc(j, CC_P);
+            size_t nonzero = jcc(j, CC_NE);
+            call_abs(j, (const void*)&jit_div_zero);
+            patch(j, nan, j->count);
+            patch(j, nonzero, j->count);
+            sse_rr(j, 0xF2, 0x5E, d, d+1);
+        } break;
+        case POW: call_pow(j, d, reversed); break;
+        default: j->failed=1; break;
+    }
+}
+
+static int is_declared(Jit* j, Slot* slot){
+    for (uint32_t i=0; i<j->declared_count; i++){
+        if (j->declared[i]==slot) return 1;
+    }
+    return 0;
+}
+
+static void declare(Jit* j, Slot* slot){
+    j->declared=(Slot**)jit_grow(j->declared, &j->declared_capacity, j->declared_count, sizeof(Slot*));
+    j->declared[j->declared_count++]=slot;
+}
+
+static uint32_t add_var(Jit* j, Slot** run, uint32_t len, int outer, int boolean){
+    for (uint32_t i=0; i<j->var_count; i++){
+        Slot** other = j->cands+j->vars[i].cand;
+        uint32_t k = 0;
+        while (k<len && other[k]==run[k]) k++;
+        if (k==len && !other[k]){
+            j->vars[i].uses++;
+            j->vars[i].boolean|=boolean;
+            return i;
+        }
+    }
+
+    j->vars=(JitVar*)jit_grow(j->vars, &j->var_capacity, j->var_count, sizeof(JitVar));
+    JitVar* v = &j->vars[j->var_count];
+    v->cand=j->cand_count;
+    v->uses=1;
+    v->outer=outer;
+    v->boolean=boolean;
+    v->reg=-1;
+
+    for (uint32_t k=0; k<=len; k++){
+        j->cands=(Slot**)jit_grow(j->cands, &j->cand_capacity, j->cand_count, sizeof(Slot*));
+        j->cands[j->cand_count++] = k<len ? run[k] : NULL;
+    }
+
+    return j->var_count++;
+}
+
+//the var a resolved name is at this point of the loop. one declared inside
+//the loop has to be declared before it in the same iteration, otherwise
+//what it is changes while the loop runs
+static uint32_t ref_var(Jit* j, ASTNode* n, uint32_t level, int boolean){
+    if (n->val.var.depth==VAR_UNRESOLVED || n->val.var.depth>level){
+        j->failed=1;
+        return 0;
+    }
+
+    uint32_t l = level-n->val.var.depth;
+    uint32_t slot = n->val.var.slot;
+    Slot* run[MAX_CANDS];
+
+    if (l>=j->base){
+        run[0]=&j->scopes[l]->frame[slot];
+        if (!is_declared(j, run[0])){
+            j->failed=1;
+            return 0;
+        }
+        return add_var(j, run, 1, 0, boolean);
+    }
+
+    uint32_t len = 0;
+    while (1){
+        if (len==MAX_CANDS){
+            j->failed=1;
+            return 0;
+        }
+        run[len++]=&j->scopes[l]->frame[slot];
+
+        SlotInfo* info = &j->scopes[l]->slot_info[slot];
+        if (!info->outer_depth) break;
+        l-=info->outer_depth;
+        slot=info->outer_slot;
+    }
+
+    return add_var(j, run, len, 1, boolean);
+}
+
+static uint32_t dec_var(Jit* j, ASTNode* n, uint32_t level, int boolean){
+    Slot* slot = &j->scopes[level]->frame[n->val.var.slot];
+    uint32_t var = add_var(j, &slot, 1, 0, boolean);
+    declare(j, slot);
+    return var;
+}
+
+static void enter_scope(Jit* j, ScopeData* scope, uint32_t level){
+    j->scopes=(ScopeData**)jit_grow(j->scopes, &j->scope_capacity, level, sizeof(ScopeData*));
+    j->scopes[level]=scope;
+}
+
+static void bool_expr(Jit* j, NodeId id, uint32_t level, int d);
+
+//x(d) = the expression, as num_evaluate_ast() computes it
+static void num_expr(Jit* j, NodeId id, uint32_t level, int d){
+    ASTNode* n = ast_node(id);
+    if (j->failed) return;
+    if (d+2>=JIT_TEMPS){
+        j->failed=1;
+        return;
+    }
+
+    switch (n->type){
+        case NUM_VAL:
+            const_num(j, d, n->val.num);
+            break;
+        case B_OP:
+            num_expr(j, n->left, level, d);
+            num_expr(j, n->right, level, d+1);
+            arith(j, n->op, d, 0);
+            break;
+        case N_OP: {
+            NaryData* nary = n->val.nary;
+            num_expr(j, nary->args[0], level, d);
+            for (uint32_t i=1; i<nary->count; i++){
+                num_expr(j, nary->args[i], level, d+1);
+                arith(j, nary->ops[i], d, 1);
+            }
+        } break;
+        case NUM_REF:
+            load_num(j, ref_var(j, n, level, 0), d);
+            break;
+        case HOIST: {
+            mov_rax_imm(j, (uint64_t)(uintptr_t)&n->op);
+            byte(j, 0x80); byte(j, 0x38); byte(j, 0x00);//cmp byte [rax], 0
+            size_t cached = jcc(j, CC_NE);
+
+            num_expr(j, n->left, level, d);
+            mov_rax_imm(j, (uint64_t)(uintptr_t)&n->val.num);
+            MOVSD_STORE(j, d, RAX, 0);
+            mov_rax_imm(j, (uint64_t)(uintptr_t)&n->op);
+            byte(j, 0xC6); byte(j, 0x00); byte(j, 0x01);//mov byte [rax], 1
+            size_t done = jmp(j);
+
+            patch(j, cached, j->count);
+            mov_rax_imm(j, (uint64_t)(uintptr_t)&n->val.num);
+            MOVSD_LOAD(j, d, RAX, 0);
+            patch(j, done, j->count);
+        } break;
+        case INDUCTION:
+            mov_rax_imm(j, (uint64_t)(uintptr_t)&n->val.ind->v[0]);
+            MOVSD_LOAD(j, d, RAX, 0);
+            break;
+        case VAR_REF://checked at runtime, left to the interpreter
+            j->failed=1;
+            break;
+        default://0 without running it, like num_evaluate_ast()
+            XORPD(j, d);
+            break;
+    }
+}
+
+//eax = the expression, as bool_evaluate_ast() computes it
+static void bool_expr(Jit* j, NodeId id, uint32_t level, int d){
+    ASTNode* n = ast_node(id);
+    if (j->failed) return;
+
+    switch (n->type){
+        case BOOL_VAL:
+            byte(j, 0xB8); imm32(j, n->val.bool_val!=0);//mov eax, imm32
+            break;
+        case COND:
+            num_expr(j, n->left, level, d);
+            num_expr(j, n->right, level, d+1);
+            if (n->op==SMALLER_THAN) UCOMISD(j, d+1, d);
+            else UCOMISD(j, d, d+1);
+
+            if (n->op==EQ){
+                byte(j, 0x0F); byte(j, 0x94); byte(j, 0xC0);//sete al
+                byte(j, 0x0F); byte(j, 0x9B); byte(j, 0xC1);//setnp cl
+                byte(j, 0x20); byte(j, 0xC8);//and al, cl
+            } else {
+                byte(j, 0x0F); byte(j, 0x97); byte(j, 0xC0);//seta al
+            }
+            movzx_eax_al(j);
+            break;
+        case BOOL_REF:
+            load_bool(j, ref_var(j, n, level, 1));
+            break;
+        case NUM_REF:
+        case NUM_VAL:
+        case B_OP:
+        case N_OP:
+        case HOIST:
+        case INDUCTION:
+            num_expr(j, id, level, d);
+            truth(j, d, d+1);
+            break;
+        default:
+            j->failed=1;
+            break;
+    }
+}
+
+static void stmt(Jit* j, NodeId id, uint32_t level);
+
+static void scope(Jit* j, ScopeData* data, uint32_t level, int first){
+    enter_scope(j, data, level);
+    uint32_t mark = j->declared_count;
+
+    for (int i=first; i<data->stmt_count && !j->failed; i++){
+        stmt(j, data->statements[i], level);
+    }
+
+    j->declared_count=mark;
+}
+
+static void loop(Jit* j, ASTNode* n, uint32_t level){
+    ASTNode* scope_node = ast_node(n->right);
+    if (scope_node->type!=SCOPE && scope_node->type!=BLOCK){
+        j->failed=1;
+        return;
+    }
+
+    ScopeData* body = scope_node->val.scope;
+    ASTNode* iter_dec = ast_node(body->statements[0]);
+    if (!iter_dec || iter_dec->type!=NUM_DEC){
+        j->failed=1;
+        return;
+    }
+
+    enter_scope(j, body, level+1);
+    uint32_t mark = j->declared_count;
+
+    num_expr(j, iter_dec->left, level+1, 0);
+    uint32_t iter = dec_var(j, iter_dec, level+1, 0);
+    store_num(j, iter, 0);
+
+    for (NodeId h=n->left; h; h=ast_node(h)->right){
+        ASTNode* m = ast_node(h);
+        if (m->type==HOIST){
+            mov_rax_imm(j, (uint64_t)(uintptr_t)&m->op);
+            byte(j, 0xC6); byte(j, 0x00); byte(j, 0x00);//mov byte [rax], 0
+        } else {
+            InductionData* ind = m->val.ind;
+            for (int k=0; k<4; k++){
+                const_num(j, 0, ind->init[k]);
+                mov_rax_imm(j, (uint64_t)(uintptr_t)&ind->v[k]);
+                MOVSD_STORE(j, 0, RAX, 0);
+            }
+        }
+    }
+
+    size_t top = j->count;
+    load_num(j, iter, 0);
+    const_num(j, 1, n->val.num);
+    UCOMISD(j, 0, 1);
+    size_t exit_jump = jcc(j, CC_AE);//start->end runs start..end-1
+
+    scope(j, body, level+1, 1);
+
+    load_num(j, iter, 0);
+    const_num(j, 1, 1);
+    sse_rr(j, 0xF2, 0x58, 0, 1);
+    store_num(j, iter, 0);
+
+    for (NodeId h=n->left; h && ast_node(h)->type==INDUCTION; h=ast_node(h)->right){
+        InductionData* ind = ast_node(h)->val.ind;
+        mov_rax_imm(j, (uint64_t)(uintptr_t)ind->v);
+        for (uint32_t k=0; k<ind->degree; k++){
+            MOVSD_LOAD(j, 0, RAX, k*8);
+            sse_rm(j, 0xF2, 0x58, 0, RAX, (k+1)*8);//addsd xmm0, [rax+8(k+1)]
+            MOVSD_STORE(j, 0, RAX, k*8);
+        }
+    }
+
+    jmp_to(j, top);
+    patch(j, exit_jump, j->count);
+
+    j->declared_count=mark;
+}
+
+static void print(Jit* j, ASTNode* n, uint32_t level){
+    ASTNode* val = ast_node(n->left);
+
+    if (n->type==PRINT_NUM){
+        if (val->type==NUM_REF) load_num(j, ref_var(j, val, level, 0), 0);
+        else num_expr(j, n->left, level, 0);
+    } else {
+        if (val->type==BOOL_REF) load_bool(j, ref_var(j, val, level, 1));
+        else bool_expr(j, n->left, level, 0);
+        byte(j, 0x89); byte(j, 0xC7);//mov edi, eax
+    }
+
+    save_cached(j, 0);
+    if (n->type==PRINT_NUM){
+        byte(j, 0xBF); imm32(j, n->op==PRINTLN);//mov edi, imm32
+        call_abs(j, (const void*)&jit_print_num);
+    } else {
+        byte(j, 0xBE); imm32(j, n->op==PRINTLN);//mov esi, imm32
+        call_abs(j, (const void*)&jit_print_bool);
+    }
+    save_cached(j, 1);
+}
+
+static void stmt(Jit* j, NodeId id, uint32_t level){
+    ASTNode* n = ast_node(id);
+    if (!n){
+        j->failed=1;
+        return;
+    }
+
+    switch (n->type){
+        case NUM_DEC:
+            num_expr(j, n->left, level, 0);
+            store_num(j, dec_var(j, n, level, 0), 0);
+            break;
+        case BOOL_DEC:
+            bool_expr(j, n->left, level, 0);
+            store_bool(j, dec_var(j, n, level, 1));
+            break;
+        case NUM_SET:
+            num_expr(j, n->left, level, 0);
+            store_num(j, ref_var(j, n, level, 0), 0);
+            break;
+        case BOOL_SET:
+            bool_expr(j, n->left, level, 0);
+            store_bool(j, ref_var(j, n, level, 1));
+            break;
+        case PRINT_NUM:
+        case PRINT_BOOL:
+            print(j, n, level);
+            break;
+        case IF_NUM:
+        case IF_BOOL: {
+            ASTNode* cond = ast_node(n->left);
+            if (cond->type==BOOL_REF){
+                load_bool(j, ref_var(j, cond, level, 1));
+            } else if (cond->type==NUM_REF || n->type==IF_NUM){
+                num_expr(j, n->left, level, 0);
+                truth(j, 0, 1);
+            } else {
+                bool_expr(j, n->left, level, 0);
+            }
+
+            byte(j, 0x85); byte(j, 0xC0);//test eax, eax
+            size_t skip = jcc(j, CC_E);
+            stmt(j, n->right, level);
+            patch(j, skip, j->count);
+        } break;
+        case SCOPE:
+        case BLOCK:
+            scope(j, n->val.scope, level+1, 0);
+            break;
+        case LOOP:
+            loop(j, n, level);
+            break;
+        default://generic statements check types at runtime
+            j->failed=1;
+            break;
+    }
+}
+
+//the whole function: void code(Slot** table)
+static void compile(Jit* j, ASTNode* n, uint32_t level){
+    j->count=j->start;
+    j->failed=0;
+    j->declared_count=0;
+    j->base=level+1;
+
+    byte(j, 0x53);//push rbx
+    byte(j, 0x48); byte(j, 0x81); byte(j, 0xEC); imm32(j, SPILL_SIZE);//sub rsp, SPILL_SIZE
+    byte(j, 0x48); byte(j, 0x89); byte(j, 0xFB);//mov rbx, rdi
+
+    for (uint32_t i=0; i<j->var_count; i++){
+        if (j->vars[i].reg<0) continue;
+        var_addr(j, i);
+        MOVSD_LOAD(j, 8+j->vars[i].reg, RAX, 0);
+    }
+
+    loop(j, n, level);
+
+    for (uint32_t i=0; i<j->var_count; i++){
+        if (j->vars[i].reg<0) continue;
+        var_addr(j, i);
+        MOVSD_STORE(j, 8+j->vars[i].reg, RAX, 0);
+    }
+
+    byte(j, 0x48); byte(j, 0x81); byte(j, 0xC4); imm32(j, SPILL_SIZE);//add rsp, SPILL_SIZE
+    byte(j, 0x5B);//pop rbx
+    byte(j, 0xC3);//ret
+}
+
+static int cached_any(Jit* j){
+    for (uint32_t i=0; i<j->var_count; i++){
+        if (j->vars[i].reg>=0) return 1;
+    }
+    return 0;
+}
+
+//numeric vars only ever in one slot go to registers, most used first
+static void assign_registers(Jit* j){
+    for (int r=0; r<JIT_CACHED; r++){
+        int best = -1;
+        for (uint32_t i=0; i<j->var_count; i++){
+            JitVar* v = &j->vars[i];
+            if (v->reg>=0 || v->boolean || j->cands[v->cand+1]) continue;
+
+            int shared = 0;//another var might end up in the same slot
+            for (uint32_t k=0; k<j->var_count && !shared; k++){
+                Slot** run = j->cands+j->vars[k].cand;
+                if (k==i || !run[1]) continue;
+                for (; *run; run++) shared |= *run==j->cands[v->cand];
+            }
+            if (shared) continue;
+
+            if (best<0 || v->uses>j->vars[best].uses) best=i;
+        }
+        if (best<0) break;
+        j->vars[best].reg=r;
+    }
+}
+
+static JitLoop* jit_loop(Jit* j, ASTNode* n, uint32_t level){
+    j->var_count=0;
+    j->cand_count=0;
+
+    compile(j, n, level);
+    if (j->failed){
+        j->count=j->start;
+        return NULL;
+    }
+
+    assign_registers(j);
+    if (cached_any(j)) compile(j, n, level);//the same code otherwise
+
+    JitLoop* l = (JitLoop*)calloc(1, sizeof(JitLoop));
+    if (!l){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    l->offset=j->start;
+    while (j->count%16) byte(j, 0xCC);//int3
+    j->start=j->count;
+
+    l->var_count=j->var_count;
+    l->vars=(JitVar*)malloc(sizeof(JitVar)*(j->var_count+1));
+    l->cands=(Slot**)malloc(sizeof(Slot*)*(j->cand_count+1));
+    l->table=(Slot**)malloc(sizeof(Slot*)*(j->var_count+1));
+    if (!l->vars || !l->cands || !l->table){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(l->vars, j->vars, sizeof(JitVar)*j->var_count);
+    memcpy(l->cands, j->cands, sizeof(Slot*)*j->cand_count);
+
+    l->next=jit_loops;
+    jit_loops=l;
+    return l;
+}
+
+static double scope_work(ScopeData* data);
+
+//iterations of the loop's body and of the loops nested in it
+static double loop_work(ASTNode* loop){
+    ASTNode* body = ast_node(loop->right);
+    if (body->type!=SCOPE && body->type!=BLOCK) return 0;
+
+    ASTNode* iter_dec = ast_node(body->val.scope->statements[0]);
+    if (!iter_dec || iter_dec->type!=NUM_DEC || ast_node(iter_dec->left)->type!=NUM_VAL) return 0;
+
+    double trips = loop->val.num-ast_node(iter_dec->left)->val.num;
+    if (!(trips>0)) return 0;
+    return trips*(1+scope_work(body->val.scope));
+}
+
+static double scope_work(ScopeData* data){
+    double work = 0;
+    for (int i=0; i<data->stmt_count; i++){
+        ASTNode* n = ast_node(data->statements[i]);
+        if (!n) continue;
+
+        if (n->type==LOOP){
+            work+=loop_work(n);
+        } else if (n->type==SCOPE || n->type==BLOCK){
+            work+=scope_work(n->val.scope);
+        } else if ((n->type==IF || n->type==IF_NUM || n->type==IF_BOOL) &&
+                   (ast_node(n->right)->type==SCOPE || ast_node(n->right)->type==BLOCK)){
+            work+=scope_work(ast_node(n->right)->val.scope);
+        }
+    }
+    return work;
+}
+
+//outermost loops first, the ones that cannot be compiled are searched for
+//loops that can
+static void jit_scope(Jit* j, ScopeData* data, uint32_t level){
+    enter_scope(j, data, level);
+
+    for (int i=0; i<data->stmt_count; i++){
+        ASTNode* n = ast_node(data->statements[i]);
+        if (!n) continue;
+
+        switch (n->type){
+            case LOOP: {
+                if (n->op&LOOP_PARALLEL) break;//its frames are per worker
+                JitLoop* l = loop_work(n)>=JIT_MIN_WORK ? jit_loop(j, n, level) : NULL;
+                enter_scope(j, data, level);
+                if (l){
+                    data->statements[i]=create_native_node(data->statements[i], l);
+                } else if (ast_node(n->right)->type==SCOPE || ast_node(n->right)->type==BLOCK){
+                    jit_scope(j, ast_node(n->right)->val.scope, level+1);
+                    enter_scope(j, data, level);
+                }
+            } break;
+            case IF:
+            case IF_NUM:
+            case IF_BOOL: {
+                ASTNode* body = ast_node(n->right);
+                if (body->type==SCOPE || body->type==BLOCK){
+                    jit_scope(j, body->val.scope, level+1);
+                    enter_scope(j, data, level);
+                }
+            } break;
+            case SCOPE:
+            case BLOCK:
+                jit_scope(j, n->val.scope, level+1);
+                enter_scope(j, data, level);
+                break;
+            default: break;
+        }
+    }
+}
+
+void jit_program(ASTNode* program){
+    if (!program) return;
+
+    Jit j;
+    memset(&j, 0, sizeof(j));
+    JitLoop* prev = jit_loops;
+    jit_scope(&j, program->val.scope, 0);
+
+    //one mapping for all of them, never writable and executable at once
+    if (jit_loops!=prev){
+        size_t size = (j.count+4095)&~(size_t)4095;
+        void* mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+        if (mem!=MAP_FAILED){
+            memcpy(mem, j.code, j.count);
+            if (mprotect(mem, size, PROT_READ|PROT_EXEC)!=0){
+                munmap(mem, size);
+                mem=MAP_FAILED;
+            }
+        }
+
+        for (JitLoop* l=jit_loops; l!=prev; l=l->next){
+            if (mem==MAP_FAILED) continue;//stays NULL, jit_enter() declines
+            void* code = (uint8_t*)mem+l->offset;
+            memcpy(&l->code, &code, sizeof(code));
+        }
+        if (mem!=MAP_FAILED){
+            jit_loops->region=mem;
+            jit_loops->region_size=size;
+        }
+    }
+
+    free(j.code);
+    free(j.scopes);
+    free(j.declared);
+    free(j.vars);
+    free(j.cands);
+}
+
+int jit_enter(JitLoop* loop){
+    if (!loop->code) return 0;
+
+    for (uint32_t i=0; i<loop->var_count; i++){
+        Slot** run = loop->cands+loop->vars[i].cand;
+        if (!loop->vars[i].outer){
+            loop->table[i]=run[0];
+            continue;
+        }
+
+        while (*run && (*run)->v==VAL_UNDEF) run++;
+        if (!*run) return 0;
+        loop->table[i]=*run;
+    }
+
+    loop->code(loop->table);
+    return 1;
+}
+
+void jit_free(){
+    while (jit_loops){
+        JitLoop* l = jit_loops;
+        jit_loops=l->next;
+
+        if (l->region) munmap(l->region, l->region_size);
+        free(l->vars);
+        free(l->cands);
+        free(l->table);
+        free(l);
+    }
+}
+
+#else
+
+void jit_program(ASTNode* program){
+    (void)program;
+}
+
+int jit_enter(JitLoop* loop){
+    (void)loop;
+    return 0;
+}
+
+void jit_free(){
+    (void)jit_loops;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "ast.h"
+
+//--jit: for loops over typed numbers and booleans compiled to x86-64 after
+//typecheck(). a compiled loop becomes a NATIVE node over the LOOP, which
+//still runs when the native code cannot. the hottest numeric variables stay
+//in xmm8-15 while it runs, the rest are read and written through the table
+//jit_enter() fills. loops using anything else are left alone, as is
+//everything on other targets
+
+typedef struct JitVar {
+    uint32_t cand;//its candidate run in the loop's cands, see vm.h
+    uint32_t uses;
+    uint8_t outer;//declared outside the loop, looked up on entry
+    uint8_t boolean;//read or written as a bool somewhere
+    int8_t reg;//xmm8+reg holds it while the loop runs, -1 if none
+} JitVar;
+
+typedef struct JitLoop {
+    void (*code)(Slot** table);
+    size_t offset;//of code in the program's mapping
+    void* region;//the mapping, on one loop of each program
+    size_t region_size;
+    JitVar* vars;
+    uint32_t var_count;
+    Slot** cands;
+    Slot** table;//each var's slot while it runs
+    struct JitLoop* next;
+} JitLoop;
+
+void jit_program(ASTNode* program);//after resolve() and typecheck()
+int jit_enter(JitLoop* loop);//0 if it did not run because a variable it reads is not declared
+void jit_free();
+
+#endif
@@ -1,7 +1,9 @@
 #include "lexer.h"
 #include "ast.h"
+#include "scan.h"
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 
 static int is_at_end(Lexer* l){
     return l->curr>=l->source_len;
@@ -39,15 +41,8 @@ static Token make_token(Lexer* l, TokenT t){
 
 static Token make_str_tok(Lexer* l, TokenT t, const char* start, int len){
     Token tok = make_token(l, t);
-    tok.val.str = (char*)malloc(len+1);
-
-    if (!tok.val.str){
-        fprintf(stderr, "memory allocation failed\n");
-        exit(EXIT_FAILURE);
-    }
-
-    memcpy(tok.val.str, start, len);
-    tok.val.str[len]='\0';
+    tok.val.str.offset = (uint32_t)(start-l->source);
+    tok.val.str.len = (uint32_t)len;
 
     return tok;
 }
@@ -58,110 +53,275 @@ static Token make_num_tok(Lexer* l, double x){
     return tok;
 }
 
-static Token error_tok(Lexer* l, const char* msg){
-    Token tok = make_token(l, ERR_TOK);
-    tok.val.str = strdup(msg);
+static Token error_tok(Lexer* l, const char* start, int len, const char* msg){
+    Token tok = make_str_tok(l, ERR_TOK, start, len);
+    l->error_msg=msg;
     l->had_error=1;
     return tok;
 }
 
+typedef enum {
+    CC_OTHER,//not valid outside comments
+    CC_SPACE,
+    CC_ALPHA,
+    CC_DIGIT,
+    CC_PUNCT,
+} CharClass;
+
+typedef struct {
+    unsigned char cls;
+    unsigned char tok;//token for a lone punctuation char
+    char next;//second char of a two-char token, 0 if there is none
+    unsigned char pair;//token when next follows
+} CharInfo;
+
+static const CharInfo char_table[256] = {
+    [' ']={CC_SPACE}, ['\t']={CC_SPACE}, ['\r']={CC_SPACE}, ['\n']={CC_SPACE},
+    ['a' ... 'z']={CC_ALPHA}, ['A' ... 'Z']={CC_ALPHA}, ['_']={CC_ALPHA},
+    ['0' ... '9']={CC_DIGIT},
+
+    ['(']={CC_PUNCT, LPAREN_TOK},
+    [')']={CC_PUNCT, RPAREN_TOK},
+    ['{']={CC_PUNCT, LBRACE_TOK},
+    ['}']={CC_PUNCT, RBRACE_TOK},
+    [';']={CC_PUNCT, SEMICOLON_TOK},
+    ['+']={CC_PUNCT, PLUS_TOK},
+    ['/']={CC_PUNCT, DIV_TOK},
+    ['>']={CC_PUNCT, BIGGER_THAN_TOK},
+    ['<']={CC_PUNCT, SMALLER_THAN_TOK},
+    [':']={CC_PUNCT, COLON_TOK, '=', COLON_ASSIGN_TOK},
+    ['-']={CC_PUNCT, MINUS_TOK, '>', ARROW_TOK},
+    ['*']={CC_PUNCT, MULT_TOK, '*', POW_TOK},
+    ['=']={CC_PUNCT, ASSIGN_TOK, '=', EQ_TOK},
+};
+
+static int char_class(char c){
+    return char_table[(unsigned char)c].cls;
+}
+
+static int is_digit(char c){
+    return char_class(c)==CC_DIGIT;
+}
+
+//keywords are found with one probe: the hash of length, first and last byte
+//is collision-free over the table below. a new keyword has to land on a free
+//slot, otherwise KW_HASH needs a new mix (or KW_SLOTS a larger power of 2)
+#define KW_SLOTS 16
+#define KW_HASH(len, first, last) ((unsigned)((len)^(unsigned char)(first)^(unsigned char)(last)) & (KW_SLOTS-1))
+#define KW_MIN_LEN 2
+#define KW_MAX_LEN 8
+
+typedef struct {
+    const char* name;
+    int len;
+    TokenT tok;
+} Keyword;
+
+#define KEYWORD(str, first, last, t) [KW_HASH(sizeof(str)-1, first, last)] = {str, sizeof(str)-1, t}
+
+static const Keyword keywords[KW_SLOTS] = {
+    KEYWORD("let", 'l', 't', LET_TOK),
+    KEYWORD("if", 'i', 'f', IF_TOK),
+    KEYWORD("for", 'f', 'r', FOR_TOK),
+    KEYWORD("parallel", 'p', 'l', PARALLEL_TOK),
+    KEYWORD("print", 'p', 't', PRINT_TOK),
+    KEYWORD("println", 'p', 'n', PRINTLN_TOK),
+    KEYWORD("true", 't', 'e', TRUE_TOK),
+    KEYWORD("false", 'f', 'e', FALSE_TOK),
+};
+
+static TokenT keyword_type(const char* start, int len){
+    if (len<KW_MIN_LEN || len>KW_MAX_LEN) return ID_TOK;
+
+    const Keyword* kw = &keywords[KW_HASH(len, start[0], start[len-1])];
+    if (kw->len!=len) return ID_TOK;
+
+    for (int i=0; i<len; i++){//short enough that a call to memcmp costs more
+        if (kw->name[i]!=start[i]) return ID_TOK;
+    }
+
+    return kw->tok;
+}
+
 static void skip_wspace(Lexer* l){
     while (1){
         char c = peek(l);
-        switch (c){
-            case ' ':
-            case '\r':
-            case '\t': advance(l); break;
-            case '\n':l->line++;advance(l);break;
-            case '/':{
-                if (peek_next(l)=='/'){
-                    while (peek(l)!='\n' && !is_at_end(l)){
-                        advance(l);
-                    }
-                } else {
-                    return;
-                }
-            } break;
-            default: return;
+
+        if (c==' ' || c=='\t' || c=='\r' || c=='\n'){
+            l->curr = scan_wspace(l->source, l->curr, l->source_len, &l->line);
+        } else if (c=='/' && peek_next(l)=='/'){
+            l->curr = scan_line_end(l->source, l->curr, l->source_len);
+        } else {
+            return;
         }
     }
 }
 
-static int is_alpha(char c){
-    return (c>='a'&&c<='z') || (c>='A'&&c<='Z') || c=='_';
+static Token word(Lexer* l){
+    const char* start = l->source+l->curr-1;
+
+    l->curr = scan_ident(l->source, l->curr, l->source_len);
+    int len = (int)(l->source+l->curr-start);
+
+    TokenT t = keyword_type(start, len);
+    if (t!=ID_TOK){
+        return make_token(l, t);
+    }
+
+    return make_str_tok(l, ID_TOK, start, len);
 }
 
-static int is_digit(char c){
-    return c>='0'&&c<='9';
+#define MAX_EXACT_INT (1ULL<<53)//every integer up to here is a double
+#define MAX_MANTISSA_DIGITS 19//still fits a uint64_t
+#define MAX_EXP10 100000//anything past this is 0 or inf anyway
+
+//10^0..10^22 are exact doubles, so m*10^e or m/10^e rounds once and is
+//correctly rounded when m is exact too (Clinger's fast path)
+static const double exact_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static int hex_val(char c){
+    if (c>='0'&&c<='9') return c-'0';
+    if (c>='a'&&c<='f') return c-'a'+10;
+    if (c>='A'&&c<='F') return c-'A'+10;
+    return -1;
 }
 
-static int is_alphanumeric(char c){
-    return is_alpha(c)||is_digit(c);
+//rare literals the fast paths cannot round exactly go through strtod,
+//pavo never calls setlocale so it parses in the "C" locale
+static Token number_slow(Lexer* l, const char* start, int len){
+    char buffer[256];
+    if (len>=(int)sizeof(buffer)){
+        return error_tok(l, start, len, "number too large");
+    }
+
+    memcpy(buffer, start, len);
+    buffer[len]='\0';
+
+    return make_num_tok(l, strtod(buffer, NULL));
 }
 
-static Token word(Lexer* l){
-    const char* start = l->source+l->curr-1;
-    int len = 1;
+//0x1F: up to 16 significant hex digits convert exactly through uint64_t
+static Token hex_number(Lexer* l, const char* start){
+    advance(l);//x
+
+    uint64_t mantissa=0;
+    int digits=0;
+    int d;
 
-    while (is_alphanumeric(peek(l))){
+    while ((d=hex_val(peek(l)))>=0){
         advance(l);
-        len++;
-    }
+        if (mantissa==0 && d==0) continue;
 
-    if (len==3 && strncmp(start, "let", 3)==0){
-        return make_token(l, LET_TOK);
-    }
-    if (len==2 && strncmp(start, "if", 2)==0){
-        return make_token(l, IF_TOK);
-    }
-    if (len==3 && strncmp(start, "for", 3)==0){
-        return make_token(l, FOR_TOK);
-    }
-    if (len==5 && strncmp(start, "print", 5)==0){
-        return make_token(l, PRINT_TOK);
+        if (digits<16) mantissa=mantissa*16+d;
+        digits++;
     }
-    if (len==7 && strncmp(start, "println", 7)==0){
-        return make_token(l, PRINTLN_TOK);
-    }
-    if (len==4 && strncmp(start, "true", 4)==0){
-        return make_token(l, TRUE_TOK);
-    }
-    if (len==5 && strncmp(start, "false", 5)==0){
-        return make_token(l, FALSE_TOK);
+
+    if (digits>16){
+        return number_slow(l, start, (int)(l->source+l->curr-start));
     }
 
-    return make_str_tok(l, ID_TOK, start, len);
+    return make_num_tok(l, (double)mantissa);
 }
 
+static int exp_follows(Lexer* l){
+    char c = peek(l);
+    if (c!='e' && c!='E') return 0;
+
+    char next = peek_next(l);
+    if (is_digit(next)) return 1;
+
+    return (next=='+'||next=='-') && l->curr+2<l->source_len && is_digit(l->source[l->curr+2]);
+}
+
+//digits[.digits][e[+-]digits] or 0x hexdigits, parsed in place
 static Token number(Lexer* l){
     const char* start = l->source + l->curr-1;
-    int len=1;
 
-    while (is_digit(peek(l))){
-        advance(l);
-        len++;
+    if (start[0]=='0' && (peek(l)=='x'||peek(l)=='X') && hex_val(peek_next(l))>=0){
+        return hex_number(l, start);
     }
 
+    uint64_t mantissa=0;
+    int digits=0;
+    int exp10=0;
+    int inexact=0;//nonzero digits did not fit the mantissa
+
+    const char* end = l->source+scan_digits(l->source, l->curr, l->source_len);
+    for (const char* c=start; c<end; c++){
+        int d = *c-'0';
+        if (mantissa==0 && d==0) continue;
+
+        if (digits<MAX_MANTISSA_DIGITS){
+            mantissa=mantissa*10+d;
+            digits++;
+        } else {
+            inexact|=d;
+            exp10++;
+        }
+    }
+    l->curr = end-l->source;
+
     if (peek(l)=='.' && is_digit(peek_next(l))){
         advance(l);
-        len++;
 
-        while (is_digit(peek(l))){
-            advance(l);
-            len++;
+        end = l->source+scan_digits(l->source, l->curr, l->source_len);
+        for (const char* c=l->source+l->curr; c<end; c++){
+            int d = *c-'0';
+            if (mantissa==0 && d==0){
+                exp10--;
+            } else if (digits<MAX_MANTISSA_DIGITS){
+                mantissa=mantissa*10+d;
+                digits++;
+                exp10--;
+            } else {
+                inexact|=d;
+            }
         }
+        l->curr = end-l->source;
     }
 
-    char buffer[256];
-    if (len>=sizeof(char)*256){
-        return error_tok(l, "number too large");
+    if (exp_follows(l)){
+        advance(l);
+
+        int sign=1;
+        if (peek(l)=='+'||peek(l)=='-'){
+            sign = advance(l)=='-' ? -1 : 1;
+        }
+
+        int e=0;
+        while (is_digit(peek(l))){
+            if (e<MAX_EXP10) e=e*10+(advance(l)-'0');
+            else advance(l);
+        }
+
+        exp10+=sign*e;
     }
 
-    strncpy(buffer, start, len);
-    buffer[len]='\0';
+    int len = (int)(l->source+l->curr-start);
+
+    if (!inexact && mantissa<=MAX_EXACT_INT){
+        double m = (double)mantissa;
+
+        if (mantissa==0) return make_num_tok(l, 0.0);
+        if (exp10==0) return make_num_tok(l, m);
+        if (exp10<0 && exp10>=-22) return make_num_tok(l, m/exact_pow10[-exp10]);
+        if (exp10>0 && exp10<=22) return make_num_tok(l, m*exact_pow10[exp10]);
+
+        //1234e25: move the extra powers into the mantissa while it stays exact
+        if (exp10>22 && exp10<=22+15){
+            uint64_t scaled = mantissa;
+            for (int i=22; i<exp10 && scaled<=MAX_EXACT_INT; i++) scaled*=10;
 
-    double val=strtod(buffer, NULL);
-    return make_num_tok(l, val);
+            if (scaled<=MAX_EXACT_INT){
+                return make_num_tok(l, (double)scaled*exact_pow10[22]);
+            }
+        }
+    }
+
+    return number_slow(l, start, len);
 }
 
 Token scan_tok(Lexer* l){
@@ -171,58 +331,18 @@ Token scan_tok(Lexer* l){
         return make_token(l, EOF_TOK);
     }
 
-    char c = advance(l);
-
-    if (is_alpha(c)) return word(l);
-    if (is_digit(c)) return number(l);
+    const CharInfo* info = &char_table[(unsigned char)advance(l)];
 
-    TokenT t=ERR_TOK;
-
-    switch (c){
-        case '(': t=LPAREN_TOK; break;
-        case ')': t=RPAREN_TOK; break;
-        case '{': t=LBRACE_TOK; break;
-        case '}': t=RBRACE_TOK; break;
-        case ':': {
-            if (match(l, '=')){
-                t=COLON_ASSIGN_TOK;
-            } else {
-                t=COLON_TOK;
-            }
-        } break;
-        case ';': t=SEMICOLON_TOK; break;
-        case '+': t=PLUS_TOK; break;
-        case '-': {
-            if (match(l, '>')){
-                t=ARROW_TOK;
-            } else {
-                t=MINUS_TOK;
-            }
-        } break;
-        case '/': t=DIV_TOK; break;
-        case '*': {
-            if (match(l, '*')){
-                t=POW_TOK;
-            } else {
-                t=MULT_TOK;
-            }
-        } break;
-        case '=': {
-            if (match(l, '=')){
-                t=EQ_TOK;
-            } else {
-                t=ASSIGN_TOK;
-            }
-        } break;
-        case '>': t=BIGGER_THAN_TOK; break;
-        case '<': t=SMALLER_THAN_TOK; break;
+    if (info->cls==CC_ALPHA) return word(l);
+    if (info->cls==CC_DIGIT) return number(l);
+    if (info->cls==CC_PUNCT){
+        if (info->next && match(l, info->next)){
+            return make_token(l, (TokenT)info->pair);
+        }
+        return make_token(l, (TokenT)info->tok);
     }
 
-    if (t==ERR_TOK){
-        return error_tok(l, "unexpected character");
-    } else {
-        return make_token(l, t);
-    }
+    return error_tok(l, l->source+l->curr-1, 1, "unexpected character");
 }
 
 static const char* token_type_to_string(TokenT type) {
@@ -231,6 +351,7 @@ static const char* token_type_to_string(TokenT type) {
         case IF_TOK: return "IF";
         case PRINT_TOK: return "PRINT";
         case PRINTLN_TOK: return "PRINTLN";
+        case PARALLEL_TOK: return "PARALLEL";
         case NUM_TOK: return "NUM";
         case ID_TOK: return "IDENTIFIER";
         case PLUS_TOK: return "PLUS";
@@ -255,19 +376,19 @@ static const char* token_type_to_string(TokenT type) {
     }
 }
 
-void print_tok(Token tok) {
+void print_tok(Token tok, const char* source) {
     printf("%-15s ", token_type_to_string(tok.type));
 
     // Print token-specific values
     switch (tok.type) {
         case ID_TOK:
-            printf("'%s'", tok.val.str);
+            printf("'%.*s'", (int)tok.val.str.len, source+tok.val.str.offset);
             break;
         case NUM_TOK:
             printf("%g", tok.val.num);
             break;
         case ERR_TOK:
-            printf("Error: %s", tok.val.str);
+            printf("Error: '%.*s'", (int)tok.val.str.len, source+tok.val.str.offset);
             break;
         default:
             // No additional value to print for other token types
@@ -279,36 +400,47 @@ void print_tok(Token tok) {
 }
 
 Lexer init_lexer(const char* source){
+    return init_lexer_len(source, strlen(source));
+}
+
+Lexer init_lexer_len(const char* source, size_t len){
+    scan_init();
+
     Lexer lexer;
     lexer.source=source;
-    lexer.source_len=strlen(source);
+    lexer.source_len=len;
     lexer.curr=0;
     lexer.line=1;
     lexer.had_error=0;
+    lexer.error_msg=NULL;
     return lexer;
 }
 
-void free_tok(Token tok){
-    if (tok.type==ID_TOK || tok.type==ERR_TOK){
-        free(tok.val.str);
-    }
+int tok_str_eq(const char* source, StrView str, const char* cmp){
+    size_t len = strlen(cmp);
+    return str.len==len && memcmp(source+str.offset, cmp, len)==0;
 }
 
-static TokenArr* init_token_arr(size_t initial_capacity){
+TokenArr* init_token_arr(size_t initial_capacity){
     TokenArr* arr = (TokenArr*)malloc(sizeof(TokenArr));
     if (!arr){
         fprintf(stderr, "memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
 
-    arr->tokens = (Token*)malloc(sizeof(Token)*initial_capacity);
-    if (!arr->tokens){
+    if (initial_capacity==0) initial_capacity=1;
+
+    arr->kinds = (uint8_t*)malloc(sizeof(uint8_t)*initial_capacity);
+    arr->vals = (TokenVal*)malloc(sizeof(TokenVal)*initial_capacity);
+    arr->lines = (int*)malloc(sizeof(int)*initial_capacity);
+    if (!arr->kinds || !arr->vals || !arr->lines){
         fprintf(stderr, "memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
 
     arr->count = 0;
     arr->capacity=initial_capacity;
+    arr->source=NULL;
 
     return arr;
 }
@@ -316,18 +448,21 @@ static TokenArr* init_token_arr(size_t initial_capacity){
 static void add_token(TokenArr* arr, Token tok){
     if (arr->count>=arr->capacity){
         arr->capacity*=2;
-        arr->tokens=(Token*)realloc(arr->tokens, sizeof(Token)*arr->capacity);
-        if (!arr){
+        arr->kinds=(uint8_t*)realloc(arr->kinds, sizeof(uint8_t)*arr->capacity);
+        arr->vals=(TokenVal*)realloc(arr->vals, sizeof(TokenVal)*arr->capacity);
+        arr->lines=(int*)realloc(arr->lines, sizeof(int)*arr->capacity);
+        if (!arr->kinds || !arr->vals || !arr->lines){
             fprintf(stderr, "memory reallocation failed\n");
             exit(EXIT_FAILURE);
         }
     }
 
-    arr->tokens[arr->count++] = tok;
+    token_put(arr, arr->count++, tok);
 }
 
 TokenArr* tokenize_all(Lexer* l){
     TokenArr* token_arr = init_token_arr(100);
+    token_arr->source = l->source;
 
     while (1){
         Token tok = scan_tok(l);
@@ -340,14 +475,183 @@ TokenArr* tokenize_all(Lexer* l){
     return token_arr;
 }
 
-void free_token_arr(TokenArr *arr){
-    if (!arr) return;
+//parallel lexing: no token spans a newline (comments stop at '\n', there
+//are no strings), so the source is cut right after newlines and the chunks
+//are lexed independently with line numbers fixed up afterwards
+
+typedef struct {
+    Lexer lexer;
+    TokenArr* tokens;
+    int line_offset;//newlines before the chunk
+    size_t out_offset;//first slot in the merged array
+} LexChunk;
+
+typedef struct {
+    LexChunk* chunks;
+    int n_chunks;
+    int next;//next chunk to claim
+    int copy_phase;
+    TokenArr* out;
+} LexJob;
+
+static void lex_chunk(LexChunk* c){
+    c->tokens = init_token_arr((c->lexer.source_len-c->lexer.curr)/4+16);
+    c->tokens->source = c->lexer.source;
+
+    while (1){
+        Token tok = scan_tok(&c->lexer);
+        add_token(c->tokens, tok);
+
+        if (tok.type==EOF_TOK || tok.type==ERR_TOK) break;
+    }
+}
+
+static void copy_chunk(LexChunk* c, TokenArr* out, int last){
+    size_t n = c->tokens->count;
+    if (!last) n--;//drop the chunk's EOF_TOK
+
+    TokenArr* src = c->tokens;
+    size_t at = c->out_offset;
+    memcpy(out->kinds+at, src->kinds, sizeof(uint8_t)*n);
+    memcpy(out->vals+at, src->vals, sizeof(TokenVal)*n);
+    for (size_t i=0; i<n; i++){
+        out->lines[at+i]=src->lines[i]+c->line_offset;
+    }
+}
 
-    for (size_t i=0; i<arr->count; i++){
-        free_tok(arr->tokens[i]);
+static void* lex_worker(void* arg){
+    LexJob* job = (LexJob*)arg;
+
+    while (1){
+        int i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i>=job->n_chunks) break;
+
+        if (job->copy_phase){
+            copy_chunk(&job->chunks[i], job->out, i==job->n_chunks-1);
+        } else {
+            lex_chunk(&job->chunks[i]);
+        }
     }
 
-    free(arr->tokens);
+    return NULL;
+}
+
+static void run_lex_job(LexJob* job, int n_threads){
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t)*n_threads);
+    if (!threads){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    job->next=0;
+    int started=0;
+    for (int i=1; i<n_threads; i++){//the calling thread is worker 0
+        if (pthread_create(&threads[i], NULL, lex_worker, job)!=0) break;
+        started=i;
+    }
+
+    lex_worker(job);
+
+    for (int i=1; i<=started; i++){
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+}
+
+TokenArr* tokenize_all_parallel(Lexer* l, int n_threads){
+    size_t len = l->source_len-l->curr;
+    if (n_threads<=1 || len<PARALLEL_LEX_MIN){
+        return tokenize_all(l);
+    }
+
+    //a few chunks per thread so uneven chunks even out
+    size_t chunk_size = len/((size_t)n_threads*4);
+    if (chunk_size<PARALLEL_LEX_CHUNK) chunk_size=PARALLEL_LEX_CHUNK;
+    int max_chunks = (int)(len/chunk_size)+1;
+
+    LexChunk* chunks = (LexChunk*)malloc(sizeof(LexChunk)*max_chunks);
+    if (!chunks){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int n_chunks=0;
+    size_t pos = l->curr;
+    while (pos<l->source_len){
+        size_t end = pos+chunk_size;
+        if (end>=l->source_len || n_chunks==max_chunks-1){
+            end=l->source_len;
+        } else {
+            end = scan_line_end(l->source, end, l->source_len);
+            if (end<l->source_len) end++;//keep the newline in this chunk
+        }
+
+        LexChunk* c = &chunks[n_chunks++];
+        c->lexer = *l;
+        c->lexer.curr = pos;
+        c->lexer.source_len = end;
+        c->lexer.line = 1;
+        c->tokens = NULL;
+
+        pos=end;
+    }
+
+    LexJob job;
+    job.chunks=chunks;
+    job.n_chunks=n_chunks;
+    job.copy_phase=0;
+    run_lex_job(&job, n_threads);
+
+    //stop after the first chunk with an error, like the sequential lexer
+    int line = l->line;
+    size_t total = 0;
+    int used = n_chunks;
+    for (int i=0; i<n_chunks; i++){
+        LexChunk* c = &chunks[i];
+        c->line_offset = line-1;
+        c->out_offset = total;
+
+        if (c->lexer.had_error){
+            total+=c->tokens->count;
+            l->had_error=1;
+            l->error_msg=c->lexer.error_msg;
+            used=i+1;
+            break;
+        }
+
+        total+=c->tokens->count-(i<n_chunks-1 ? 1 : 0);
+        line+=c->lexer.line-1;
+    }
+
+    LexChunk* last = &chunks[used-1];
+    l->curr = last->lexer.curr;
+    l->line = last->lexer.line+last->line_offset;
+
+    TokenArr* out = init_token_arr(total);
+    out->source = l->source;
+    out->count = total;
+
+    job.n_chunks=used;
+    job.copy_phase=1;
+    job.out=out;
+    //an erroring chunk keeps its ERR_TOK, so it is copied as if it were last
+    run_lex_job(&job, n_threads);
+
+    for (int i=0; i<n_chunks; i++){
+        free_token_arr(chunks[i].tokens);
+    }
+    free(chunks);
+
+    return out;
+}
+
+void free_token_arr(TokenArr *arr){
+    if (!arr) return;
+
+    free(arr->kinds);
+    free(arr->vals);
+    free(arr->lines);
 
     free(arr);
 }
@@ -2,6 +2,7 @@
 #define LEXER_H
 
 #include <ctype.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -12,6 +13,7 @@ typedef enum{
     PRINT_TOK,
     PRINTLN_TOK,
     FOR_TOK,//for loop
+    PARALLEL_TOK,//parallel for
 
     ID_TOK,
     NUM_TOK,
@@ -41,34 +43,67 @@ typedef enum{
     ERR_TOK,
 } TokenT;
 
+typedef struct{//view into the lexer source, no ownership
+    uint32_t offset;
+    uint32_t len;
+} StrView;
+
+typedef union{
+    double num;
+    StrView str;//ID_TOK, ERR_TOK
+} TokenVal;
+
 typedef struct{
     TokenT type;
-    union {
-        double num;
-        char* str;
-    } val;
+    TokenVal val;
     int line;
 } Token;
 
 typedef struct {
     const char* source;
     size_t source_len;
-    int curr;
+    size_t curr;
     int line;
     int had_error;
+    const char* error_msg;
 } Lexer;
 
+#define PARALLEL_LEX_MIN (4<<20)//bytes, smaller sources are lexed on one thread
+#define PARALLEL_LEX_CHUNK (256<<10)
+
+//structure of arrays: the parser mostly checks kinds, so those are packed
+//one byte per token and payloads/lines are only touched when consumed
 typedef struct{
-    Token* tokens;
+    uint8_t* kinds;//TokenT
+    TokenVal* vals;
+    int* lines;
     size_t count;
     size_t capacity;
+    const char* source;//ID_TOK/ERR_TOK views point here
 } TokenArr;
 
+static inline Token token_at(const TokenArr* arr, size_t i){
+    Token tok;
+    tok.type=(TokenT)arr->kinds[i];
+    tok.val=arr->vals[i];
+    tok.line=arr->lines[i];
+    return tok;
+}
+
+static inline void token_put(TokenArr* arr, size_t i, Token tok){
+    arr->kinds[i]=(uint8_t)tok.type;
+    arr->vals[i]=tok.val;
+    arr->lines[i]=tok.line;
+}
+
 Lexer init_lexer(const char* source);
+Lexer init_lexer_len(const char* source, size_t len);//source need not be NUL terminated
 Token scan_tok(Lexer* l);
-void free_tok(Token tok);
-void print_tok(Token tok);
+void print_tok(Token tok, const char* source);
+int tok_str_eq(const char* source, StrView str, const char* cmp);
+TokenArr* init_token_arr(size_t initial_capacity);
 TokenArr* tokenize_all(Lexer* l);
+TokenArr* tokenize_all_parallel(Lexer* l, int n_threads);//falls back to tokenize_all below PARALLEL_LEX_MIN
 void free_token_arr(TokenArr* arr);
 
 #endif
@@ -2,52 +2,33 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "ast.h"
-#include "map.h"
 #include "lexer.h"
 #include "parser.h"
+#include "resolve.h"
+#include "typecheck.h"
+#include "optimize.h"
 #include "main.h"
-
-Map* m;
-
-extern ScopeData* curr_scope;
-
-extern Var* get_ref(const char id[VAR_LEN]){
-    if (curr_scope){
-        Var* var=get_var_from_scope(curr_scope, id);
-        if (var) return var;
-    }
-
-    Var* res = get_var(m, id);
-    if (!res){
-        fprintf(stderr, "error: variable '%s' not found in scope\n", id);
-        exit(EXIT_FAILURE);
-    }
-
-    return res;
-}
-
-void add_var_num(double x, const char id[VAR_LEN]){
-    Var* n = (Var*)malloc(sizeof(Var));
-    n->type=NUM;
-    n->val.num=x;
-    n->next=NULL;
-
-    strcpy(n->id, id);
-
-    insert_var(m, n);
-}
-
-
+#include "watch.h"
+#include "vm.h"
+#include "jit.h"
+#include "emit.h"
+#include "batch.h"
+#include "par.h"
 
 void debug_tokens(TokenArr* tokens) {
     printf("\n--- TOKEN DUMP ---\n");
     for (size_t i = 0; i < tokens->count; i++) {
-        Token t = tokens->tokens[i];
+        Token t = token_at(tokens, i);
         printf("%zu: ", i);
-        print_tok(t);
+        print_tok(t, tokens->source);
     }
     printf("--- END TOKEN DUMP ---\n\n");
 }
@@ -64,6 +45,7 @@ void debug_print_node_type(ASTNode* node) {
         case NUM_VAL: type_str = "NUM_VAL"; break;
         //case BOOL_VAL: type_str = "BOOL_VAL"; break;
         case B_OP: type_str = "B_OP"; break;
+        case N_OP: type_str = "N_OP"; break;
         case NUM_DEC: type_str = "NUM_DEC"; break;
         //case BOOL_DEC: type_str = "BOOL_DEC"; break;
         case NUM_REF: type_str = "NUM_REF"; break;
@@ -74,13 +56,19 @@ void debug_print_node_type(ASTNode* node) {
         case SCOPE: type_str = "SCOPE"; break;
         case BLOCK: type_str = "BLOCK"; break;
         case LOOP: type_str = "LOOP"; break;
+        case PRINT_NUM: type_str = "PRINT_NUM"; break;
+        case PRINT_BOOL: type_str = "PRINT_BOOL"; break;
+        case IF_NUM: type_str = "IF_NUM"; break;
+        case IF_BOOL: type_str = "IF_BOOL"; break;
+        case NUM_SET: type_str = "NUM_SET"; break;
+        case BOOL_SET: type_str = "BOOL_SET"; break;
     }
 
     printf("Node type: %s\n", type_str);
 
     if (node->type == NUM_DEC || node->type == BOOL_DEC ||
         node->type == NUM_REF || node->type == BOOL_REF) {
-        printf("  Variable name: %s\n", node->val.id);
+        printf("  Variable name: %s\n", sym_name(node->sym));
     }
 
     if (node->type == SCOPE || node->type == BLOCK) {
@@ -88,6 +76,78 @@ void debug_print_node_type(ASTNode* node) {
     }
 }
 
+static const char* node_names[] = {
+    "NUM_VAL", "BOOL_VAL", "B_OP", "N_OP", "NUM_DEC", "BOOL_DEC", "NUM_REF", "BOOL_REF",
+    "VAR_REF", "MACRO", "COND", "IF", "SCOPE", "BLOCK", "LOOP", "NUM_REASSIGN",
+    "BOOL_REASSIGN", "PRINT_NUM", "PRINT_BOOL", "IF_NUM", "IF_BOOL", "NUM_SET", "BOOL_SET",
+    "HOIST", "INDUCTION", "NATIVE", "BATCH",
+};
+static const char* bin_op_names[] = {"+", "-", "*", "/", "**"};
+static const char* cond_names[] = {"==", "<", ">"};
+
+//--dump-ast, one node per line, children indented below it
+void dump_ast(ASTNode* node, int indent){
+    printf("%*s", indent*2, "");
+    if (!node){
+        printf("NULL\n");
+        return;
+    }
+
+    printf("%s", node_names[node->type]);
+    switch (node->type){
+        case NUM_VAL: printf(" %g", node->val.num); break;
+        case BOOL_VAL: printf(" %s", node->val.bool_val ? "true" : "false"); break;
+        case B_OP: printf(" %s", bin_op_names[node->op]); break;
+        case COND: printf(" %s", cond_names[node->op]); break;
+        case MACRO:
+        case PRINT_NUM:
+        case PRINT_BOOL: printf(" %s", node->op==PRINTLN ? "println" : "print"); break;
+        case LOOP: printf(" %s ->%g%s", sym_name(node->sym), node->val.num, node->op&LOOP_PARALLEL ? " parallel" : ""); break;
+        case INDUCTION: printf(" degree %u", node->val.ind->degree); break;
+        case N_OP: {
+            NaryData* nary = node->val.nary;
+            printf(" %s", bin_op_names[node->op]);
+            for (uint32_t i=1; i<nary->count; i++) printf(" %s", bin_op_names[nary->ops[i]]);
+        } break;
+        case NUM_DEC:
+        case BOOL_DEC:
+        case NUM_REF:
+        case BOOL_REF:
+        case VAR_REF:
+        case NUM_REASSIGN:
+        case BOOL_REASSIGN:
+        case NUM_SET:
+        case BOOL_SET: printf(" %s", sym_name(node->sym)); break;
+        default: break;
+    }
+    printf("\n");
+
+    switch (node->type){
+        case N_OP:
+            for (uint32_t i=0; i<node->val.nary->count; i++) dump_ast(ast_node(node->val.nary->args[i]), indent+1);
+            break;
+        case SCOPE:
+        case BLOCK:
+            for (int i=0; i<node->val.scope->stmt_count; i++) dump_ast(ast_node(node->val.scope->statements[i]), indent+1);
+            break;
+        case LOOP:
+        case HOIST:
+        case INDUCTION://their right is the loop's list, LOOP's left its head
+            dump_ast(ast_node(node->type==LOOP ? node->right : node->left), indent+1);
+            break;
+        case NUM_VAL:
+        case BOOL_VAL:
+        case NUM_REF:
+        case BOOL_REF:
+        case VAR_REF:
+            break;
+        default:
+            if (node->left) dump_ast(ast_node(node->left), indent+1);
+            if (node->right) dump_ast(ast_node(node->right), indent+1);
+            break;
+    }
+}
+
 
 //TEST
 void run_interpreter(const char* source, const char* description){
@@ -113,6 +173,21 @@ void run_interpreter(const char* source, const char* description){
         return;
     }
 
+    resolve_program(program);
+    int type_errors = typecheck_unoptimized(program, 0);
+    if (!type_errors){
+        optimize_program(program, OPT_DEFAULT);
+        resolve_program(program);
+        type_errors=typecheck_program(program);
+    }
+
+    if (type_errors){
+        printf("type errors!!!!!!\n");
+        free_ast(program);
+        free_token_arr(tokens);
+        return;
+    }
+
     printf("\nEXECUTING\n");
     ExecutionContext* ctx = create_execution_context();
     execute(program, ctx);
@@ -144,93 +219,293 @@ void test2(){
     run_interpreter(source, "TEST2");
 }
 
-char* read_file(const char* filename){
-    FILE* file = fopen(filename, "r");
-    if (!file){
+//pipes, stdin and anything else that cannot be mapped
+static int read_stream(int fd, const char* filename, Source* src){
+    size_t capacity = 1<<16;
+    char* buffer = (char*)malloc(capacity);
+    if (!buffer){
+        fprintf(stderr, "error: memory allocation failed\n");
+        return 0;
+    }
+
+    size_t len = 0;
+    while (1){
+        if (len==capacity){
+            capacity*=2;
+            char* grown = (char*)realloc(buffer, capacity);
+            if (!grown){
+                fprintf(stderr, "error: memory allocation failed\n");
+                free(buffer);
+                return 0;
+            }
+            buffer=grown;
+        }
+
+        ssize_t n = read(fd, buffer+len, capacity-len);
+        if (n==0) break;
+        if (n<0){
+            fprintf(stderr, "error: could not read '%s'\n", filename);
+            free(buffer);
+            return 0;
+        }
+        len+=n;
+    }
+
+    src->data=buffer;
+    src->len=len;
+    src->mapped=0;
+    return 1;
+}
+
+//regular files are mapped read-only and lexed in place
+int load_source(const char* filename, Source* src){
+    if (strcmp(filename, "-")==0){
+        return read_stream(STDIN_FILENO, "<stdin>", src);
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd<0){
         fprintf(stderr, "error: could not open file '%s'\n", filename);
-        return NULL;
+        return 0;
     }
 
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    rewind(file);
+    struct stat st;
+    if (fstat(fd, &st)<0){
+        fprintf(stderr, "error: could not stat file '%s'\n", filename);
+        close(fd);
+        return 0;
+    }
 
-    char* buffer = (char*)malloc(file_size+1);
-    if (!buffer){
-        fprintf(stderr, "error: memory allocation failed\n");
-        fclose(file);
-        return NULL;
+    int ok;
+    if (S_ISREG(st.st_mode) && st.st_size>0){
+        void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data==MAP_FAILED){
+            ok = read_stream(fd, filename, src);
+        } else {
+            madvise(data, st.st_size, MADV_SEQUENTIAL);
+            src->data=(char*)data;
+            src->len=st.st_size;
+            src->mapped=1;
+            ok=1;
+        }
+    } else {
+        ok = read_stream(fd, filename, src);
     }
 
-    size_t bytes_read = fread(buffer, 1, file_size, file);
-    if (bytes_read<file_size){
-        fprintf(stderr, "error: could not read eniter file\n");
-        free(buffer);
-        fclose(file);
-        return NULL;
+    close(fd);
+
+    if (ok && src->len>UINT32_MAX){//token views hold 32-bit offsets
+        fprintf(stderr, "error: file '%s' is too large\n", filename);
+        free_source(src);
+        return 0;
     }
 
-    buffer[file_size]='\0';
+    return ok;
+}
 
-    fclose(file);
-    return buffer;
+void free_source(Source* src){
+    if (src->mapped){
+        munmap(src->data, src->len);
+    } else {
+        free(src->data);
+    }
+    src->data=NULL;
+    src->len=0;
 }
 
 
 int main(int argc, char* argv[]){
     clock_t start = clock();
 
-    m=create_map();
-    if (argc < 2){
-        printf("usage: %s <filename.pavo>\n", argv[0]);
-    } else {
-        const char* filename = argv[1];
+    const char* filename = NULL;
+    int stream = 0;//pull tokens on demand instead of tokenizing up front
+    int threads = 1;
+    int watch = 0;//re-run on every change to the file
+    int parallel_parse = 0;//parse top-level statements on --threads workers
+    int opt_level = OPT_DEFAULT;//-O0 .. -O2
+    int dump = 0;//print the tree instead of running it
+    int vm = 0;//--engine=vm, compile to bytecode instead of walking the tree
+    int jit = 0;//compile loops to machine code
+    int emit = 0;//print the program as C instead of running it
+    int build = 0;//compile that C to an executable next to the source
+
+    for (int i=1; i<argc; i++){
+        if (strcmp(argv[i], "--stream")==0){
+            stream=1;
+        } else if (strcmp(argv[i], "--watch")==0){
+            watch=1;
+        } else if (strcmp(argv[i], "--parallel-parse")==0){
+            parallel_parse=1;
+        } else if (strcmp(argv[i], "--dump-ast")==0){
+            dump=1;
+        } else if (strcmp(argv[i], "--jit")==0){
+            jit=1;
+        } else if (strcmp(argv[i], "--emit-c")==0){
+            emit=1;
+        } else if (strcmp(argv[i], "--build")==0){
+            build=1;
+        } else if (strncmp(argv[i], "--engine=", 9)==0){
+            if (strcmp(argv[i]+9, "vm")==0){
+                vm=1;
+            } else if (strcmp(argv[i]+9, "tree")==0){
+                vm=0;
+            } else {
+                fprintf(stderr, "error: unknown engine '%s'\n", argv[i]+9);
+                return EXIT_FAILURE;
+            }
+        } else if (argv[i][0]=='-' && argv[i][1]=='O' && argv[i][2]>='0' && argv[i][2]<='2' && argv[i][3]=='\0'){
+            opt_level=argv[i][2]-'0';
+        } else if (strncmp(argv[i], "--threads=", 10)==0){
+            char* end;
+            long n = strtol(argv[i]+10, &end, 10);
+            if (end==argv[i]+10 || *end!='\0' || n<0 || n>1024){
+                fprintf(stderr, "error: invalid thread count '%s'\n", argv[i]+10);
+                return EXIT_FAILURE;
+            }
+            threads = n==0 ? (int)sysconf(_SC_NPROCESSORS_ONLN) : (int)n;//0 uses every core
+            if (threads<1) threads=1;
+        } else if (argv[i][0]=='-' && argv[i][1]!='\0'){
+            fprintf(stderr, "error: unknown option '%s'\n", argv[i]);
+            return EXIT_FAILURE;
+        } else {
+            filename=argv[i];
+        }
+    }
 
+    if (!filename){
+        printf("usage: %s [--stream] [--threads=N] [--parallel-parse] [-O0|-O1|-O2] [--dump-ast] [--engine=tree|vm] [--jit] [--emit-c] [--build] [--watch] <filename.pavo | ->\n", argv[0]);
+    } else {
         const char* ext = strchr(filename, '.');
-        if (!ext || strcmp(ext, ".pavo")!=0){
+        if (strcmp(filename, "-")!=0 && (!ext || strcmp(ext, ".pavo")!=0)){
             fprintf(stderr, "error: file must have .pavo extension\n");
-            free_map(m);
             return EXIT_FAILURE;
         }
 
-        char* source = read_file(filename);
-        if (!source){
-            free_map(m);
+        if (vm && jit){
+            fprintf(stderr, "error: --jit runs on the tree engine only\n");
+            return EXIT_FAILURE;
+        }
+
+        if ((emit || build) && (vm || jit || watch || dump)){
+            fprintf(stderr, "error: --emit-c and --build cannot be combined with --engine=vm, --jit, --watch or --dump-ast\n");
+            return EXIT_FAILURE;
+        }
+
+        if (build && strcmp(filename, "-")==0){
+            fprintf(stderr, "error: cannot build stdin\n");
+            return EXIT_FAILURE;
+        }
+
+        if (watch){
+            if (vm || jit){
+                fprintf(stderr, "error: --watch runs on the tree engine only, without --jit\n");
+                return EXIT_FAILURE;
+            }
+            if (strcmp(filename, "-")==0){
+                fprintf(stderr, "error: cannot watch stdin\n");
+                return EXIT_FAILURE;
+            }
+
+            int status = watch_file(filename, opt_level);
+            return status;
+        }
+
+        Source source;
+        if (!load_source(filename, &source)){
             return EXIT_FAILURE;
         }
 
         //printf("\n=======RUNNING FILE=======\n");
-        Lexer l = init_lexer(source);
-        TokenArr* tokens = tokenize_all(&l);
+        Lexer l = init_lexer_len(source.data, source.len);
+        TokenArr* tokens = NULL;
+        ASTNode* program = NULL;
+
+        if (!stream){
+            tokens = tokenize_all_parallel(&l, threads);
+        } else {
+            program = parse_stream(&l);
+        }
 
         if (l.had_error){
             printf("lexer errors in file '%s'\n", filename);
+            free_ast(program);
             free_token_arr(tokens);
-            free(source);
-            free_map(m);
+            free_source(&source);
             return EXIT_FAILURE;
         }
 
-        ASTNode* program = parse(tokens);
+        if (!stream){
+            program = parallel_parse ? parse_parallel(tokens, threads) : parse(tokens);
+        }
 
         if (!program){
             printf("parser errors in file '%s'\n", filename);
             free_token_arr(tokens);
-            free(source);
-            free_map(m);
+            free_source(&source);
+            return EXIT_FAILURE;
+        }
+
+        //type errors count in code -O1 drops, so they are looked for first
+        int type_errors = 0;
+        if (opt_level>=1){
+            resolve_program(program);
+            type_errors=typecheck_unoptimized(program, 0);
+            if (!type_errors) optimize_program(program, opt_level);
+        }
+        if (!type_errors){
+            resolve_program(program);
+            type_errors=typecheck_program(program);
+        }
+
+        if (type_errors){
+            printf("type errors in file '%s'\n", filename);
+            free_ast(program);
+            free_token_arr(tokens);
+            free_source(&source);
             return EXIT_FAILURE;
         }
 
-        ExecutionContext* ctx = create_execution_context();
-        execute(program, ctx);
+        if (emit || build){
+            int status = build ? build_c(program, filename) : emit_c(program, stdout);
+            free_ast(program);
+            free_token_arr(tokens);
+            free_source(&source);
+            return status==0 ? 0 : EXIT_FAILURE;
+        }
+
+        if (!vm) par_program(program, threads, opt_level>=1);
+        if (jit) jit_program(program);
+        if (!vm && opt_level>=1) batch_program(program, threads);
+
+        if (dump){
+            dump_ast(program, 0);
+            jit_free();
+            batch_free();
+            par_free();
+            free_ast(program);
+            free_token_arr(tokens);
+            free_source(&source);
+            return 0;
+        }
+
+        if (vm){
+            VmProgram* code = vm_compile(program);
+            vm_run(code);
+            vm_free(code);
+        } else {
+            ExecutionContext* ctx = create_execution_context();
+            execute(program, ctx);
+            free_execution_context(ctx);
+        }
 
+        jit_free();
+        batch_free();
+        par_free();
         free_ast(program);
-        free_execution_context(ctx);
         free_token_arr(tokens);
-        free(source);
+        free_source(&source);
     }
 
-    free_map(m);
 
 
     clock_t end = clock();
@@ -1,9 +1,15 @@
 #ifndef MAIN_H
 #define MAIN_H
 
-#include "map.h"
+#include <stddef.h>
 
-Var* get_ref(const char id[VAR_LEN]);
-void add_var_num(double x, const char id[VAR_LEN]);
+typedef struct {
+    char* data;//not NUL terminated when mapped
+    size_t len;
+    int mapped;
+} Source;
+
+int load_source(const char* filename, Source* src);//"-" reads stdin
+void free_source(Source* src);
 
 #endif
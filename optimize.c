@@ -0,0 +1,666 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "optimize.h"
+#include "ast.h"
+
+typedef struct {
+    NodeId* stack;//expression nodes still to visit
+    uint8_t* done;//children already visited
+    size_t stack_count;
+    size_t stack_capacity;
+    int level;
+
+    //loop pass
+    uint32_t* written;//per symbol, stamp of the last loop body that writes it
+    uint32_t stamp;
+    uint8_t* invariant;//per node id, only valid inside one hoist_expr()
+    size_t invariant_count;
+    SymId iter;
+    uint32_t iter_writes;//declarations and reassignments of the iterator
+    int iter_nonneg;
+    double iter_start;
+    double iter_max;//largest |iterator| the loop or its differences reach
+} Optimizer;
+
+#define EXACT_LIMIT 9007199254740992.0//2^53, integers below it are exact doubles
+#define MAX_DEGREE 3
+#define MAX_POLY_DEPTH 32
+
+static void push_node(Optimizer* o, NodeId n, uint8_t done){
+    if (o->stack_count==o->stack_capacity){
+        o->stack_capacity = o->stack_capacity ? o->stack_capacity*2 : 64;
+        o->stack=(NodeId*)realloc(o->stack, sizeof(NodeId)*o->stack_capacity);
+        o->done=(uint8_t*)realloc(o->done, o->stack_capacity);
+        if (!o->stack || !o->done){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    o->stack[o->stack_count]=n;
+    o->done[o->stack_count++]=done;
+}
+
+static int is_num(NodeId id){
+    return ast_node(id)->type==NUM_VAL;
+}
+
+static int is_ref(NodeId id){
+    ASTNodeT t = ast_node(id)->type;
+    return t==VAR_REF || t==NUM_REF || t==BOOL_REF;
+}
+
+//same arithmetic as num_evaluate_ast(), 0 if it would fail at runtime
+static int fold_op(BinOpT op, double a, double b, double* res){
+    switch (op){
+        case PLUS: *res=a+b; return 1;
+        case MINUS: *res=a-b; return 1;
+        case MULT: *res=a*b; return 1;
+        case DIV:
+            if (b==0) return 0;
+            *res=a/b;
+            return 1;
+        case POW: *res=pow(a, b); return 1;
+        default: return 0;
+    }
+}
+
+static void make_num(ASTNode* n, double x){
+    n->type=NUM_VAL;
+    n->op=0;
+    n->val.num=x;
+    n->left=0;
+    n->right=0;
+}
+
+//x**k as x*x*...*x, the variable node is shared by every factor
+static void reduce_pow(ASTNode* n){
+    ASTNode* exp = ast_node(n->right);
+    double k = exp->val.num;
+    if (k!=2 && k!=3 && k!=4) return;
+
+    NodeId x = n->left;
+    NodeId product = create_bin_op_node(MULT, x, x);
+    for (int i=2; i<k; i++) product=create_bin_op_node(MULT, product, x);
+
+    *n=*ast_node(product);
+}
+
+//an N_OP runs left to right, so a prefix of literals folds into one
+static void fold_nary(ASTNode* n){
+    NaryData* nary = n->val.nary;
+    if (!is_num(nary->args[0])) return;
+
+    double acc = ast_node(nary->args[0])->val.num;
+    uint32_t i=1;
+    for (; i<nary->count && is_num(nary->args[i]); i++){
+        double v = ast_node(nary->args[i])->val.num;
+        double res;
+        //POW args are stored right to left, see NaryData
+        int ok = nary->ops[i]==POW ? fold_op(POW, v, acc, &res) : fold_op(nary->ops[i], acc, v, &res);
+        if (!ok) break;
+        acc=res;
+    }
+
+    if (i==nary->count){
+        make_num(n, acc);
+        return;
+    }
+    if (i==1) return;
+
+    ast_node(nary->args[0])->val.num=acc;
+    uint32_t kept = 1;
+    for (; i<nary->count; i++, kept++){
+        nary->args[kept]=nary->args[i];
+        nary->ops[kept]=nary->ops[i];
+    }
+    nary->count=kept;
+}
+
+static void fold_node(Optimizer* o, ASTNode* n){
+    switch (n->type){
+        case B_OP: {
+            if (is_num(n->left) && is_num(n->right)){
+                double res;
+                if (fold_op(n->op, ast_node(n->left)->val.num, ast_node(n->right)->val.num, &res)){
+                    make_num(n, res);
+                }
+            } else if (o->level>=2 && n->op==POW && is_ref(n->left) && is_num(n->right)){
+                reduce_pow(n);
+            }
+        } break;
+        case N_OP:
+            fold_nary(n);
+            break;
+        case COND: {
+            if (!is_num(n->left) || !is_num(n->right)) break;
+
+            double a = ast_node(n->left)->val.num;
+            double b = ast_node(n->right)->val.num;
+            int res;
+            switch (n->op){
+                case EQ: res = a==b; break;
+                case SMALLER_THAN: res = a<b; break;
+                case BIGGER_THAN: res = a>b; break;
+                default: return;
+            }
+
+            n->type=BOOL_VAL;
+            n->op=0;
+            n->val.bool_val=res;
+            n->left=0;
+            n->right=0;
+        } break;
+        default: break;
+    }
+}
+
+//children first, explicit stack, expressions can be deeper than the C stack
+static void fold_expr(Optimizer* o, NodeId id){
+    if (!id) return;
+
+    size_t base = o->stack_count;
+    push_node(o, id, 0);
+
+    while (o->stack_count>base){
+        size_t top = o->stack_count-1;
+        ASTNode* n = ast_node(o->stack[top]);
+
+        if (o->done[top]){
+            o->stack_count--;
+            fold_node(o, n);
+            continue;
+        }
+        o->done[top]=1;
+
+        switch (n->type){
+            case B_OP:
+            case COND:
+                if (n->left) push_node(o, n->left, 0);
+                if (n->right) push_node(o, n->right, 0);
+                break;
+            case N_OP:
+                for (uint32_t i=0; i<n->val.nary->count; i++){
+                    if (n->val.nary->args[i]) push_node(o, n->val.nary->args[i], 0);
+                }
+                break;
+            default: break;
+        }
+    }
+}
+
+static void optimize_scope(Optimizer* o, ScopeData* scope);
+
+//what execute_if() would decide, -1 if it depends on the run
+static int literal_condition(ASTNode* cond){
+    if (cond->type==BOOL_VAL) return cond->val.bool_val==1;
+    if (cond->type==NUM_VAL) return cond->val.num!=0;
+    return -1;
+}
+
+static NodeId optimize_node(Optimizer* o, NodeId id){
+    ASTNode* n = ast_node(id);
+    if (!n) return 0;
+
+    switch (n->type){
+        case NUM_DEC:
+        case BOOL_DEC:
+        case NUM_REASSIGN:
+        case BOOL_REASSIGN:
+        case MACRO:
+            fold_expr(o, n->left);
+            return id;
+        case IF: {
+            fold_expr(o, n->left);
+            optimize_node(o, n->right);
+
+            int taken = literal_condition(ast_node(n->left));
+            if (taken==0) return 0;
+            if (taken==1) return n->right;
+            return id;
+        }
+        case LOOP:
+            optimize_node(o, n->right);
+            return id;
+        case SCOPE:
+        case BLOCK:
+            optimize_scope(o, n->val.scope);
+            return id;
+        default:
+            return id;//expression statements are never evaluated
+    }
+}
+
+static void optimize_scope(Optimizer* o, ScopeData* scope){
+    int kept = 0;
+    for (int i=0; i<scope->stmt_count; i++){
+        NodeId stmt = optimize_node(o, scope->statements[i]);
+        if (stmt) scope->statements[kept++]=stmt;
+    }
+    scope->stmt_count=kept;
+}
+
+//loop-invariant code motion and induction variables (-O2)
+
+//what a loop body declares or reassigns, at any depth
+static void mark_writes(Optimizer* o, ScopeData* body){
+    for (int i=0; i<body->stmt_count; i++){
+        ASTNode* n = ast_node(body->statements[i]);
+        if (!n) continue;
+
+        switch (n->type){
+            case NUM_DEC:
+            case BOOL_DEC:
+            case NUM_REASSIGN:
+            case BOOL_REASSIGN:
+                o->written[n->sym]=o->stamp;
+                if (n->sym==o->iter) o->iter_writes++;
+                break;
+            case IF:
+            case LOOP:
+                mark_writes(o, ast_node(n->right)->val.scope);
+                break;
+            case SCOPE:
+            case BLOCK:
+                mark_writes(o, n->val.scope);
+                break;
+            default: break;
+        }
+    }
+}
+
+typedef void (*ExprFn)(Optimizer* o, NodeId expr, ASTNode* loop);
+
+//every expression a statement of the body (at any depth) evaluates
+static void each_expr(Optimizer* o, ScopeData* body, ExprFn fn, ASTNode* loop){
+    for (int i=0; i<body->stmt_count; i++){
+        ASTNode* n = ast_node(body->statements[i]);
+        if (!n) continue;
+
+        switch (n->type){
+            case NUM_DEC:
+            case BOOL_DEC:
+            case NUM_REASSIGN:
+            case BOOL_REASSIGN:
+            case MACRO:
+                fn(o, n->left, loop);
+                break;
+            case IF:
+                fn(o, n->left, loop);
+                each_expr(o, ast_node(n->right)->val.scope, fn, loop);
+                break;
+            case LOOP:
+                if (n->op&LOOP_PARALLEL) break;//its workers cannot share hoisted values
+                each_expr(o, ast_node(n->right)->val.scope, fn, loop);
+                break;
+            case SCOPE:
+            case BLOCK:
+                each_expr(o, n->val.scope, fn, loop);
+                break;
+            default: break;
+        }
+    }
+}
+
+//marks every node of the expression that no write in the loop body can
+//change. HOISTs and INDUCTIONs of enclosing loops are constant in here
+static void mark_invariant(Optimizer* o, NodeId root){
+    size_t size = (size_t)ast_pool->chunk_count<<NODE_CHUNK_SHIFT;
+    if (o->invariant_count<size){
+        o->invariant=(uint8_t*)realloc(o->invariant, size);
+        if (!o->invariant){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        o->invariant_count=size;
+    }
+
+    size_t base = o->stack_count;
+    push_node(o, root, 0);
+
+    while (o->stack_count>base){
+        size_t top = o->stack_count-1;
+        NodeId id = o->stack[top];
+        ASTNode* n = ast_node(id);
+
+        if (!o->done[top]){
+            o->done[top]=1;
+            switch (n->type){
+                case B_OP:
+                case COND:
+                    push_node(o, n->left, 0);
+                    push_node(o, n->right, 0);
+                    break;
+                case N_OP:
+                    for (uint32_t i=0; i<n->val.nary->count; i++) push_node(o, n->val.nary->args[i], 0);
+                    break;
+                default: break;
+            }
+            continue;
+        }
+        o->stack_count--;
+
+        uint8_t inv = 0;
+        switch (n->type){
+            case NUM_VAL:
+            case BOOL_VAL:
+            case HOIST:
+            case INDUCTION: inv=1; break;
+            case VAR_REF:
+            case NUM_REF:
+            case BOOL_REF: inv = o->written[n->sym]!=o->stamp; break;
+            case B_OP:
+            case COND: inv = o->invariant[n->left] && o->invariant[n->right]; break;
+            case N_OP:
+                inv=1;
+                for (uint32_t i=0; i<n->val.nary->count; i++) inv&=o->invariant[n->val.nary->args[i]];
+                break;
+            default: break;
+        }
+        o->invariant[id]=inv;
+    }
+}
+
+//largest invariant arithmetic subtrees become HOISTs. they are evaluated
+//where they were, on first use, so one inside a branch that never runs
+//still fails or not exactly as before
+static void hoist_expr(Optimizer* o, NodeId root, ASTNode* loop){
+    if (!root) return;
+    mark_invariant(o, root);
+
+    size_t base = o->stack_count;
+    push_node(o, root, 0);
+
+    while (o->stack_count>base){
+        NodeId id = o->stack[--o->stack_count];
+        ASTNode* n = ast_node(id);
+
+        if ((n->type==B_OP || n->type==N_OP) && o->invariant[id]){
+            NodeId moved = copy_node(id);
+            *n=*ast_node(create_hoist_node(moved));
+            n->right=loop->left;
+            loop->left=id;
+            continue;
+        }
+
+        switch (n->type){
+            case B_OP:
+            case COND:
+                push_node(o, n->left, 0);
+                push_node(o, n->right, 0);
+                break;
+            case N_OP:
+                for (uint32_t i=0; i<n->val.nary->count; i++) push_node(o, n->val.nary->args[i], 0);
+                break;
+            default: break;
+        }
+    }
+}
+
+//a polynomial in the iterator with integer coefficients, and a bound on the
+//magnitude of every value computed on the way to it
+typedef struct {
+    double c[MAX_DEGREE+1];
+    double bound[MAX_DEGREE+1];//coefficients of the absolute values
+    int degree;
+    int nonneg;//never negative, so a product with it cannot be -0
+} Poly;
+
+static double poly_at(const double* c, int degree, double x){
+    double r = c[degree];
+    for (int k=degree-1; k>=0; k--) r=r*x+c[k];
+    return r+0.0;//no -0
+}
+
+static int poly_add(Poly* a, const Poly* b, int sub){
+    int degree = a->degree>b->degree ? a->degree : b->degree;
+    for (int k=0; k<=degree; k++){
+        double ck = k<=b->degree ? b->c[k] : 0;
+        double bk = k<=b->degree ? b->bound[k] : 0;
+        if (k>a->degree){
+            a->c[k]=0;
+            a->bound[k]=0;
+        }
+        a->c[k] = sub ? a->c[k]-ck : a->c[k]+ck;
+        a->bound[k]+=bk;
+    }
+    a->degree=degree;
+    a->nonneg = a->nonneg && b->nonneg && !sub;
+    return 1;
+}
+
+static int poly_mul(Poly* a, const Poly* b){
+    int positive_a = a->degree==0 && a->c[0]>0;
+    int positive_b = b->degree==0 && b->c[0]>0;
+    if (!(a->nonneg && b->nonneg) && !positive_a && !positive_b) return 0;//x*0 could be -0
+    if (a->degree+b->degree>MAX_DEGREE) return 0;
+
+    Poly r;
+    memset(&r, 0, sizeof(r));
+    r.degree=a->degree+b->degree;
+    for (int i=0; i<=a->degree; i++){
+        for (int j=0; j<=b->degree; j++){
+            r.c[i+j]+=a->c[i]*b->c[j];
+            r.bound[i+j]+=a->bound[i]*b->bound[j];
+        }
+    }
+    r.nonneg = a->nonneg && b->nonneg;
+
+    *a=r;
+    return 1;
+}
+
+static int integer_literal(ASTNode* n){
+    double v = n->val.num;
+    return n->type==NUM_VAL && v==floor(v) && fabs(v)<EXACT_LIMIT && !(v==0 && signbit(v));
+}
+
+static int poly_of(Optimizer* o, NodeId id, Poly* p, int depth){
+    ASTNode* n = ast_node(id);
+    if (depth>MAX_POLY_DEPTH) return 0;
+
+    memset(p, 0, sizeof(*p));
+    switch (n->type){
+        case NUM_VAL:
+            if (!integer_literal(n)) return 0;
+            p->c[0]=n->val.num;
+            p->bound[0]=fabs(n->val.num);
+            p->nonneg = n->val.num>=0;
+            break;
+        case VAR_REF:
+        case NUM_REF:
+            if (n->sym!=o->iter) return 0;
+            p->degree=1;
+            p->c[1]=1;
+            p->bound[1]=1;
+            p->nonneg=o->iter_nonneg;
+            break;
+        case B_OP: {
+            Poly r;
+            if (!poly_of(o, n->left, p, depth+1)) return 0;
+
+            if (n->op==POW){
+                ASTNode* e = ast_node(n->right);
+                if (!integer_literal(e) || e->val.num<1 || e->val.num>MAX_DEGREE) return 0;
+
+                Poly base = *p;
+                int even = ((int)e->val.num)%2==0;
+                base.nonneg=1;//pow() of a base that is never -0 is not -0 either
+                Poly acc = base;
+                for (int k=1; k<(int)e->val.num; k++){
+                    if (!poly_mul(&acc, &base)) return 0;
+                }
+                acc.nonneg = p->nonneg || even;
+                *p=acc;
+                break;
+            }
+
+            if (!poly_of(o, n->right, &r, depth+1)) return 0;
+            if (n->op==PLUS || n->op==MINUS){
+                poly_add(p, &r, n->op==MINUS);
+            } else if (n->op==MULT){
+                if (!poly_mul(p, &r)) return 0;
+            } else {
+                return 0;
+            }
+        } break;
+        case N_OP: {
+            NaryData* nary = n->val.nary;
+            if (n->op==POW) return 0;
+            if (!poly_of(o, nary->args[0], p, depth+1)) return 0;
+
+            for (uint32_t i=1; i<nary->count; i++){
+                Poly r;
+                if (!poly_of(o, nary->args[i], &r, depth+1)) return 0;
+                if (nary->ops[i]==PLUS || nary->ops[i]==MINUS){
+                    poly_add(p, &r, nary->ops[i]==MINUS);
+                } else if (nary->ops[i]==MULT){
+                    if (!poly_mul(p, &r)) return 0;
+                } else {
+                    return 0;
+                }
+            }
+        } break;
+        default: return 0;
+    }
+
+    //every value on the way is an integer below 2^53, so the original
+    //evaluation is exact and the differences reproduce it bit for bit
+    return poly_at(p->bound, p->degree, o->iter_max)<EXACT_LIMIT;
+}
+
+//largest polynomials in the iterator become INDUCTIONs
+static void induce_expr(Optimizer* o, NodeId root, ASTNode* loop){
+    if (!root) return;
+
+    size_t base = o->stack_count;
+    push_node(o, root, 0);
+
+    while (o->stack_count>base){
+        NodeId id = o->stack[--o->stack_count];
+        ASTNode* n = ast_node(id);
+        Poly p;
+
+        if ((n->type==B_OP || n->type==N_OP) && poly_of(o, id, &p, 0) && p.degree>=1){
+            //differences at the first iteration, from the values at the first degree+1
+            double init[MAX_DEGREE+1] = {0};
+            for (int k=0; k<=p.degree; k++) init[k]=poly_at(p.c, p.degree, o->iter_start+k);
+            for (int k=1; k<=p.degree; k++){
+                for (int j=p.degree; j>=k; j--) init[j]=init[j]-init[j-1]+0.0;
+            }
+
+            NodeId moved = copy_node(id);
+            *n=*ast_node(create_induction_node(moved, init, p.degree));
+            n->right=loop->left;
+            loop->left=id;
+            continue;
+        }
+
+        switch (n->type){
+            case B_OP:
+            case COND:
+                push_node(o, n->left, 0);
+                push_node(o, n->right, 0);
+                break;
+            case N_OP:
+                for (uint32_t i=0; i<n->val.nary->count; i++) push_node(o, n->val.nary->args[i], 0);
+                break;
+            default: break;
+        }
+    }
+}
+
+static void optimize_loop(Optimizer* o, ASTNode* loop){
+    if (!o->written){
+        o->written=(uint32_t*)calloc(ast_pool->sym_count, sizeof(uint32_t));
+        if (!o->written){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    ScopeData* body = ast_node(loop->right)->val.scope;
+    o->stamp++;
+    o->iter=loop->sym;
+    o->iter_writes=0;
+    mark_writes(o, body);
+
+    each_expr(o, body, hoist_expr, loop);
+
+    //the iterator only moves by the loop's own increment, from start up to end
+    double start = ast_node(ast_node(body->statements[0])->left)->val.num;
+    double end = loop->val.num;
+    if (o->iter_writes!=1 || end<=start) return;
+
+    o->iter_start=start;
+    o->iter_nonneg = start>=0;
+    o->iter_max = fmax(fabs(start), fabs(end))+MAX_DEGREE;
+    each_expr(o, body, induce_expr, loop);
+}
+
+//outermost first, so an expression invariant in several nested loops is
+//hoisted out of the outermost one
+static void optimize_loops(Optimizer* o, ScopeData* scope){
+    for (int i=0; i<scope->stmt_count; i++){
+        ASTNode* n = ast_node(scope->statements[i]);
+        if (!n) continue;
+
+        switch (n->type){
+            case LOOP:
+                if (n->op&LOOP_PARALLEL) break;//nor loops inside it, the workers would share their HOISTs
+                optimize_loop(o, n);
+                optimize_loops(o, ast_node(n->right)->val.scope);
+                break;
+            case IF:
+                optimize_loops(o, ast_node(n->right)->val.scope);
+                break;
+            case SCOPE:
+            case BLOCK:
+                optimize_loops(o, n->val.scope);
+                break;
+            default: break;
+        }
+    }
+}
+
+static void free_optimizer(Optimizer* o){
+    free(o->stack);
+    free(o->done);
+    free(o->written);
+    free(o->invariant);
+}
+
+NodeId optimize_stmt(NodeId stmt, int level){
+    if (level<=0) return stmt;
+
+    Optimizer o;
+    memset(&o, 0, sizeof(o));
+    o.level=level;
+
+    NodeId res = optimize_node(&o, stmt);
+
+    ASTNode* n = ast_node(res);
+    if (level>=2 && n && !(n->type==LOOP && (n->op&LOOP_PARALLEL))){
+        if (n->type==LOOP) optimize_loop(&o, n);
+        if (n->type==LOOP || n->type==IF) optimize_loops(&o, ast_node(n->right)->val.scope);
+        if (n->type==SCOPE || n->type==BLOCK) optimize_loops(&o, n->val.scope);
+    }
+
+    free_optimizer(&o);
+    return res;
+}
+
+void optimize_program(ASTNode* program, int level){
+    if (!program || level<=0) return;
+
+    Optimizer o;
+    memset(&o, 0, sizeof(o));
+    o.level=level;
+
+    optimize_scope(&o, program->val.scope);
+    if (level>=2) optimize_loops(&o, program->val.scope);
+
+    free_optimizer(&o);
+}
@@ -0,0 +1,25 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "ast.h"
+
+//tree rewrites run after typecheck_unoptimized() and before the resolve()
+//and typecheck() the program runs with:
+//-O1 folds literal arithmetic and comparisons, drops `if` statements whose
+//condition is a false literal and replaces ones with a true literal by their
+//body. results are bit-identical to evaluating at runtime, a division by a
+//literal 0 is left to fail when (if) it runs.
+//-O2 also turns x**2, x**3 and x**4 of a variable into multiplications,
+//which can differ from pow() in the last bit, and optimizes for loops:
+//arithmetic that nothing in the body writes to becomes a HOIST, computed
+//once per run of the loop, and polynomials in the iterator with integer
+//coefficients become an INDUCTION updated by adding finite differences.
+//the latter only where every value stays an integer below 2^53 over the
+//loop's range, so they are exact
+
+#define OPT_DEFAULT 1
+
+void optimize_program(ASTNode* program, int level);
+NodeId optimize_stmt(NodeId stmt, int level);//returns what replaces it, 0 if it is gone
+
+#endif
@@ -0,0 +1,609 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "par.h"
+#include "ast.h"
+
+//scopes from the loop body (level 0) down to the statement being looked at,
+//with the slots each has declared so far in this iteration
+typedef struct {
+    ScopeData* scope;
+    uint8_t* declared;
+} DepLevel;
+
+typedef struct {
+    DepLevel* levels;
+    uint32_t level_capacity;
+    NodeId* stack;//expressions still to visit
+    size_t stack_count;
+    size_t stack_capacity;
+    uint32_t iter_slot;//of the loop being checked, in the body
+    int why;//PAR_*, the first conflict found
+    SymId sym;
+} Dep;
+
+static void dep_conflict(Dep* d, int why, SymId sym){
+    if (d->why) return;
+    d->why=why;
+    d->sym=sym;
+}
+
+//a name read or written from a statement at level
+static void dep_var(Dep* d, ASTNode* n, uint32_t level, int write){
+    uint32_t depth = n->val.var.depth;
+    if (depth==VAR_UNRESOLVED) return;//fails the same in every iteration
+
+    if (depth>level){
+        if (write) dep_conflict(d, PAR_WRITES_OUTER, n->sym);
+        return;
+    }
+
+    //not declared yet, it still falls through to whatever the slot held
+    if (!d->levels[level-depth].declared[n->val.var.slot]){
+        dep_conflict(d, write ? PAR_WRITES_OUTER : PAR_READS_EARLIER, n->sym);
+    } else if (write && level==depth && n->val.var.slot==d->iter_slot){
+        dep_conflict(d, PAR_WRITES_ITERATOR, n->sym);
+    }
+}
+
+static void dep_push(Dep* d, NodeId id){
+    if (!id) return;
+    if (d->stack_count==d->stack_capacity){
+        d->stack_capacity = d->stack_capacity ? d->stack_capacity*2 : 64;
+        d->stack=(NodeId*)realloc(d->stack, sizeof(NodeId)*d->stack_capacity);
+        if (!d->stack){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    d->stack[d->stack_count++]=id;
+}
+
+static void dep_expr(Dep* d, NodeId id, uint32_t level){
+    dep_push(d, id);
+
+    while (d->stack_count){
+        ASTNode* n = ast_node(d->stack[--d->stack_count]);
+
+        switch (n->type){
+            case VAR_REF:
+            case NUM_REF:
+            case BOOL_REF:
+                dep_var(d, n, level, 0);
+                break;
+            case B_OP:
+            case COND:
+                dep_push(d, n->left);
+                dep_push(d, n->right);
+                break;
+            case N_OP:
+                for (uint32_t i=0; i<n->val.nary->count; i++) dep_push(d, n->val.nary->args[i]);
+                break;
+            case HOIST:
+            case INDUCTION:
+                dep_conflict(d, PAR_STATEFUL, 0);
+                break;
+            default: break;
+        }
+    }
+}
+
+static void dep_scope(Dep* d, ScopeData* scope, uint32_t level);
+
+static void dep_stmt(Dep* d, NodeId id, uint32_t level){
+    ASTNode* n = ast_node(id);
+    if (!n) return;
+
+    switch (n->type){
+        case NUM_DEC:
+        case BOOL_DEC:
+            dep_expr(d, n->left, level);
+            if (level==0 && n->val.var.slot==d->iter_slot && d->levels[0].declared[d->iter_slot]){
+                dep_conflict(d, PAR_WRITES_ITERATOR, n->sym);//redeclared in the body, the same slot
+            }
+            d->levels[level].declared[n->val.var.slot]=1;
+            break;
+        case NUM_REASSIGN:
+        case NUM_SET:
+        case BOOL_REASSIGN:
+        case BOOL_SET:
+            dep_expr(d, n->left, level);
+            dep_var(d, n, level, 1);
+            break;
+        case MACRO:
+        case PRINT_NUM:
+        case PRINT_BOOL:
+            dep_expr(d, n->left, level);
+            break;
+        case IF:
+        case IF_NUM:
+        case IF_BOOL:
+            dep_expr(d, n->left, level);
+            dep_stmt(d, n->right, level);
+            break;
+        case LOOP:
+            if (n->left) dep_conflict(d, PAR_STATEFUL, 0);
+            dep_stmt(d, n->right, level);
+            break;
+        case SCOPE:
+        case BLOCK:
+            dep_scope(d, n->val.scope, level+1);
+            break;
+        case NATIVE:
+        case BATCH:
+            dep_conflict(d, PAR_STATEFUL, 0);
+            break;
+        default: break;//expression statements are never evaluated
+    }
+}
+
+static void dep_scope(Dep* d, ScopeData* scope, uint32_t level){
+    if (level>=d->level_capacity){
+        d->level_capacity = d->level_capacity ? d->level_capacity*2 : 16;
+        d->levels=(DepLevel*)realloc(d->levels, sizeof(DepLevel)*d->level_capacity);
+        if (!d->levels){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    //a scope entered again starts over, what it declared before is stale
+    DepLevel* l = &d->levels[level];
+    l->scope=scope;
+    l->declared=(uint8_t*)calloc(scope->slot_count+1, 1);
+    if (!l->declared){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i=0; i<scope->stmt_count && !d->why; i++){
+        dep_stmt(d, scope->statements[i], level);
+    }
+
+    free(d->levels[level].declared);
+}
+
+//iterations are independent if each one only writes variables it declared
+//itself and only reads them after declaring them, anything else may see
+//another iteration's values
+int par_conflict(ASTNode* loop, SymId* sym){
+    ASTNode* body = ast_node(loop->right);
+    if (body->type!=SCOPE && body->type!=BLOCK) return PAR_STATEFUL;
+
+    Dep d;
+    memset(&d, 0, sizeof(d));
+    if (loop->left) d.why=PAR_STATEFUL;
+
+    ASTNode* iter_dec = ast_node(body->val.scope->statements[0]);
+    if (!iter_dec || iter_dec->type!=NUM_DEC) d.why=PAR_STATEFUL;
+    else d.iter_slot=iter_dec->val.var.slot;
+
+    if (!d.why) dep_scope(&d, body->val.scope, 0);
+
+    free(d.levels);
+    free(d.stack);
+
+    if (sym) *sym=d.sym;
+    return d.why;
+}
+
+static double scope_work(ScopeData* data);
+
+//statements run by the loop and the loops nested in it
+static double loop_work(ASTNode* loop){
+    ASTNode* body = ast_node(loop->right);
+    if (body->type!=SCOPE && body->type!=BLOCK) return 0;
+
+    ASTNode* iter_dec = ast_node(body->val.scope->statements[0]);
+    if (!iter_dec || iter_dec->type!=NUM_DEC || ast_node(iter_dec->left)->type!=NUM_VAL) return 0;
+
+    double trips = loop->val.num-ast_node(iter_dec->left)->val.num;
+    if (!(trips>0)) return 0;
+    return trips*scope_work(body->val.scope);
+}
+
+static double scope_work(ScopeData* data){
+    double work = 0;
+    for (int i=0; i<data->stmt_count; i++){
+        ASTNode* n = ast_node(data->statements[i]);
+        if (!n) continue;
+
+        work++;
+        if (n->type==LOOP){
+            work+=loop_work(n);
+        } else if (n->type==SCOPE || n->type==BLOCK){
+            work+=scope_work(n->val.scope);
+        } else if ((n->type==IF || n->type==IF_NUM || n->type==IF_BOOL) &&
+                   (ast_node(n->right)->type==SCOPE || ast_node(n->right)->type==BLOCK)){
+            work+=scope_work(ast_node(n->right)->val.scope);
+        }
+    }
+    return work;
+}
+
+//a frame per worker for the scope and every scope inside it. their parents
+//are wired up front so workers entering them find nothing to write
+static void split_frames(ScopeData* data, ScopeData* parent, int threads){
+    if (parent) data->parent=parent;
+
+    if (!data->worker_stride && data->slot_count){
+        uint32_t count = data->slot_count;
+        Slot* frame = (Slot*)arena_alloc(data->arena, sizeof(Slot)*count*threads);
+        if (!frame){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+
+        memcpy(frame, data->frame, sizeof(Slot)*count);//worker 0 is the thread that runs the program
+        for (uint32_t i=count; i<count*threads; i++) frame[i].v=VAL_UNDEF;
+
+        data->frame=frame;
+        data->slot_capacity=count;
+        data->worker_stride=count;
+    }
+
+    for (int i=0; i<data->stmt_count; i++){
+        ASTNode* n = ast_node(data->statements[i]);
+        if (!n) continue;
+
+        ASTNode* body = NULL;
+        switch (n->type){
+            case IF:
+            case IF_NUM:
+            case IF_BOOL:
+            case LOOP: body=ast_node(n->right); break;
+            case SCOPE:
+            case BLOCK: body=n; break;
+            default: break;
+        }
+        if (body && (body->type==SCOPE || body->type==BLOCK)) split_frames(body->val.scope, data, threads);
+    }
+}
+
+static int pool_threads;//workers including the thread running the program, set by par_program()
+
+static void par_scope(ScopeData* data, int automatic){
+    for (int i=0; i<data->stmt_count; i++){
+        ASTNode* n = ast_node(data->statements[i]);
+        if (!n) continue;
+
+        switch (n->type){
+            case LOOP: {
+                ASTNode* body = ast_node(n->right);
+                if (body->type!=SCOPE && body->type!=BLOCK) break;
+
+                if (automatic && !(n->op&LOOP_PARALLEL) && loop_work(n)>=PAR_MIN_WORK &&
+                    par_conflict(n, NULL)==PAR_INDEPENDENT){
+                    n->op|=LOOP_PARALLEL;
+                }
+
+                if (pool_threads<=1 || ((n->op&LOOP_PARALLEL) && par_conflict(n, NULL)!=PAR_INDEPENDENT)){
+                    n->op&=~LOOP_PARALLEL;//runs as a plain loop, which jit and batch may still take
+                }
+
+                if (n->op&LOOP_PARALLEL){
+                    split_frames(body->val.scope, NULL, pool_threads);
+                } else {
+                    par_scope(body->val.scope, automatic);
+                }
+            } break;
+            case IF:
+            case IF_NUM:
+            case IF_BOOL: {
+                ASTNode* body = ast_node(n->right);
+                if (body->type==SCOPE || body->type==BLOCK) par_scope(body->val.scope, automatic);
+            } break;
+            case SCOPE:
+            case BLOCK:
+                par_scope(n->val.scope, automatic);
+                break;
+            default: break;
+        }
+    }
+}
+
+void par_program(ASTNode* program, int threads, int automatic){
+    if (!program) return;
+    pool_threads = threads>1 ? threads : 1;
+    if (pool_threads<=1) automatic=0;
+    par_scope(program->val.scope, automatic);
+}
+
+//a run of iterations and what they printed
+typedef struct {
+    OutBuf out;
+    int done;
+} ParChunk;
+
+//chunks [lo, hi) a worker has left, thieves take from hi
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t lo;
+    uint32_t hi;
+} ParDeque;
+
+typedef struct {
+    ScopeData* body;
+    ScopeData* scope;//running the loop
+    AstPool* pool;
+    uint32_t iter_slot;
+    double start;
+    uint64_t trips;
+    uint64_t chunk_size;
+    uint32_t n_chunks;
+    uint32_t workers;
+    ParChunk* chunks;
+    ParDeque* deques;
+
+    pthread_mutex_t flush_lock;
+    uint32_t flushed;//chunks written to stdout so far
+    uint32_t error_chunk;//first chunk that failed, n_chunks if none did
+    char error[sizeof(((RuntimeTrap*)0)->msg)];
+} ParJob;
+
+typedef struct {
+    pthread_t* threads;
+    uint32_t started;//threads running besides the calling one
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    uint64_t generation;//one per job
+    uint32_t busy;
+    ParJob* job;
+    int quit;
+} ParPool;
+
+static ParPool pool = {
+    .lock=PTHREAD_MUTEX_INITIALIZER,
+    .wake=PTHREAD_COND_INITIALIZER,
+    .idle=PTHREAD_COND_INITIALIZER,
+};
+
+static int take_chunk(ParJob* job, uint32_t w, uint32_t* chunk){
+    ParDeque* own = &job->deques[w];
+    pthread_mutex_lock(&own->lock);
+    if (own->lo<own->hi){
+        *chunk=own->lo++;
+        pthread_mutex_unlock(&own->lock);
+        return 1;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    //steal the back half of the first worker that has any left
+    for (uint32_t i=1; i<job->workers; i++){
+        ParDeque* victim = &job->deques[(w+i)%job->workers];
+        pthread_mutex_lock(&victim->lock);
+        uint32_t left = victim->hi-victim->lo;
+        if (!left){
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+
+        uint32_t hi = victim->hi;
+        uint32_t lo = hi-(left+1)/2;
+        victim->hi=lo;
+        pthread_mutex_unlock(&victim->lock);
+
+        pthread_mutex_lock(&own->lock);
+        own->lo=lo+1;
+        own->hi=hi;
+        pthread_mutex_unlock(&own->lock);
+
+        *chunk=lo;
+        return 1;
+    }
+    return 0;
+}
+
+//writes out finished chunks in order, up to the first that failed
+static void flush_chunks(ParJob* job){
+    while (job->flushed<job->error_chunk && job->chunks[job->flushed].done){
+        OutBuf* b = &job->chunks[job->flushed].out;
+        fwrite(b->data, 1, b->count, stdout);
+        free(b->data);
+        b->data=NULL;
+        job->flushed++;
+    }
+}
+
+static void run_chunk(ParJob* job, uint32_t c, ExecutionContext* ctx){
+    ScopeData* body = job->body;
+    Slot* iter_var = &body->frame[job->iter_slot+ctx->worker*body->worker_stride];
+
+    uint64_t lo = c*job->chunk_size;
+    uint64_t hi = lo+job->chunk_size<job->trips ? lo+job->chunk_size : job->trips;
+    for (uint64_t k=lo; k<hi; k++){
+        iter_var->v=num_value(job->start+(double)k);
+
+        ctx->curr_scope=body;
+        for (int i=1; i<body->stmt_count; i++){
+            execute(ast_node(body->statements[i]), ctx);
+        }
+        ctx->curr_scope=job->scope;
+    }
+}
+
+//0 if the chunk failed, with the message in trap
+static int run_trapped(ParJob* job, uint32_t c, ExecutionContext* ctx, RuntimeTrap* trap){
+    runtime_trap=trap;
+    if (setjmp(trap->env)){
+        runtime_trap=NULL;
+        return 0;
+    }
+
+    run_chunk(job, c, ctx);
+    runtime_trap=NULL;
+    return 1;
+}
+
+static void run_worker(ParJob* job, uint32_t w){
+    ast_pool=job->pool;
+
+    ExecutionContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.worker=w;
+
+    RuntimeTrap trap;
+    uint32_t c;
+    while (take_chunk(job, w, &c)){
+        ParChunk* chunk = &job->chunks[c];
+
+        //past an error nothing runs, sequentially the program would have stopped
+        if (c<__atomic_load_n(&job->error_chunk, __ATOMIC_RELAXED)){
+            ctx.curr_scope=job->scope;
+            ctx.out=&chunk->out;
+            if (!run_trapped(job, c, &ctx, &trap)){
+                pthread_mutex_lock(&job->flush_lock);
+                if (c<job->error_chunk){
+                    __atomic_store_n(&job->error_chunk, c, __ATOMIC_RELAXED);
+                    memcpy(job->error, trap.msg, sizeof(job->error));
+                }
+                pthread_mutex_unlock(&job->flush_lock);
+            }
+        }
+
+        pthread_mutex_lock(&job->flush_lock);
+        chunk->done=1;
+        flush_chunks(job);
+        pthread_mutex_unlock(&job->flush_lock);
+    }
+}
+
+static void* pool_thread(void* arg){
+    uint32_t w = (uint32_t)(uintptr_t)arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&pool.lock);
+    while (1){
+        while (!pool.quit && pool.generation==seen) pthread_cond_wait(&pool.wake, &pool.lock);
+        if (pool.quit) break;
+        seen=pool.generation;
+
+        ParJob* job = pool.job;
+        pthread_mutex_unlock(&pool.lock);
+        run_worker(job, w);
+        pthread_mutex_lock(&pool.lock);
+
+        if (--pool.busy==0) pthread_cond_signal(&pool.idle);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+//threads are started on the first parallel loop and wait for the next one
+static uint32_t start_pool(){
+    if (pool.threads) return pool.started+1;
+
+    pool.threads=(pthread_t*)malloc(sizeof(pthread_t)*pool_threads);
+    if (!pool.threads){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i=1; i<pool_threads; i++){//the calling thread is worker 0
+        if (pthread_create(&pool.threads[i], NULL, pool_thread, (void*)(uintptr_t)i)!=0) break;
+        pool.started=i;
+    }
+    return pool.started+1;
+}
+
+int par_run(ASTNode* loop, ExecutionContext* ctx){
+    //a worker runs nested parallel loops itself, and --watch needs every write undoable
+    if (pool_threads<=1 || ctx->out || ctx->undo || ctx->worker) return 0;
+
+    ScopeData* body = ast_node(loop->right)->val.scope;
+    if (body->slot_count && !body->worker_stride) return 0;
+
+    uint32_t iter_slot = ast_node(body->statements[0])->val.var.slot;
+    double start = value_num(body->frame[iter_slot].v);
+    double trips = ceil(loop->val.num-start);
+    if (!(trips>=2)) return 0;
+
+    uint32_t workers = start_pool();
+    if (workers<=1) return 0;
+
+    ParJob job;
+    memset(&job, 0, sizeof(job));
+    job.body=body;
+    job.scope=ctx->curr_scope;
+    job.pool=ast_pool;
+    job.iter_slot=iter_slot;
+    job.start=start;
+    job.trips=(uint64_t)trips;
+    job.workers=workers;
+
+    uint64_t want = (uint64_t)workers*PAR_CHUNKS_PER_WORKER;
+    job.chunk_size=(job.trips+want-1)/want;
+    job.n_chunks=(uint32_t)((job.trips+job.chunk_size-1)/job.chunk_size);
+    job.error_chunk=job.n_chunks;
+
+    job.chunks=(ParChunk*)calloc(job.n_chunks, sizeof(ParChunk));
+    job.deques=(ParDeque*)malloc(sizeof(ParDeque)*workers);
+    if (!job.chunks || !job.deques){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t w=0; w<workers; w++){
+        pthread_mutex_init(&job.deques[w].lock, NULL);
+        job.deques[w].lo=(uint32_t)((uint64_t)job.n_chunks*w/workers);
+        job.deques[w].hi=(uint32_t)((uint64_t)job.n_chunks*(w+1)/workers);
+    }
+    pthread_mutex_init(&job.flush_lock, NULL);
+
+    pthread_mutex_lock(&pool.lock);
+    pool.job=&job;
+    pool.generation++;
+    pool.busy=workers-1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_worker(&job, 0);
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.busy) pthread_cond_wait(&pool.idle, &pool.lock);
+    pool.job=NULL;
+    pthread_mutex_unlock(&pool.lock);
+
+    ast_pool=job.pool;
+    ctx->curr_scope=job.scope;
+    body->frame[iter_slot].v=num_value(start+trips);
+
+    //what the failing iteration printed before it failed
+    int failed = job.error_chunk<job.n_chunks;
+    if (failed){
+        OutBuf* b = &job.chunks[job.error_chunk].out;
+        fwrite(b->data, 1, b->count, stdout);
+    }
+    for (uint32_t c=0; c<job.n_chunks; c++) free(job.chunks[c].out.data);
+    free(job.chunks);
+
+    for (uint32_t w=0; w<workers; w++) pthread_mutex_destroy(&job.deques[w].lock);
+    free(job.deques);
+    pthread_mutex_destroy(&job.flush_lock);
+
+    if (failed){
+        fflush(stdout);
+        runtime_error("%s", job.error);
+    }
+    return 1;
+}
+
+void par_free(){
+    if (!pool.threads) return;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.quit=1;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (uint32_t i=1; i<=pool.started; i++){
+        pthread_join(pool.threads[i], NULL);
+    }
+
+    free(pool.threads);
+    pool.threads=NULL;
+    pool.started=0;
+    pool.quit=0;
+}
@@ -0,0 +1,30 @@
+#ifndef PAR_H
+#define PAR_H
+
+#include "ast.h"
+
+//parallel for loops: `parallel for`, and with --threads above 1 any loop
+//whose iterations provably do not depend on each other, run on a pool of
+//--threads workers. iterations are cut into chunks, each worker starts on
+//its own share and steals half of another's when it runs out. every worker
+//has its own copy of the frames inside the loop, and what it prints is
+//buffered per chunk and written out in iteration order, so output is that
+//of the sequential loop. a runtime error ends the program after the output
+//of the iterations before it, as it would sequentially
+
+#define PAR_CHUNKS_PER_WORKER 16//so uneven iterations even out
+#define PAR_MIN_WORK 65536//statements run, under which a loop is not parallelized automatically
+
+//why iterations of a loop cannot run in any order
+#define PAR_INDEPENDENT 0
+#define PAR_WRITES_OUTER 1//assigns a variable declared outside the loop
+#define PAR_READS_EARLIER 2//reads a variable inside the loop before this iteration declares it
+#define PAR_STATEFUL 3//holds nodes that keep state across iterations (HOIST, INDUCTION, NATIVE, BATCH)
+#define PAR_WRITES_ITERATOR 4//assigns its own iterator, which decides the iterations that follow
+
+int par_conflict(ASTNode* loop, SymId* sym);//after resolve(), sym is the variable behind the conflict
+void par_program(ASTNode* program, int threads, int automatic);//after typecheck(), before jit_program() and batch_program()
+int par_run(ASTNode* loop, ExecutionContext* ctx);//after the iterator is declared, 0 if the loop has to run sequentially
+void par_free();
+
+#endif
@@ -1,11 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include "parser.h"
 #include "ast.h"
 #include "lexer.h"
-#include "map.h"
 
 static Parser* init_parser(TokenArr* tokens){
     Parser* p = (Parser*)malloc(sizeof(Parser));
@@ -15,40 +15,109 @@ static Parser* init_parser(TokenArr* tokens){
     }
 
     p->tokens=tokens;
+    p->source=tokens->source;
     p->curr=0;
+    p->avail=tokens->count;
+    p->limit=(size_t)-1;
+    p->mask=(size_t)-1;
+    p->lexer=NULL;
+    p->vals=NULL;
+    p->val_count=0;
+    p->val_capacity=0;
+    p->ops=NULL;
+    p->op_count=0;
+    p->op_capacity=0;
     p->had_error=0;
+    p->errors=0;
+    p->quiet=0;
     p->error_msg[0]='\0';
 
     return p;
 }
 
+//streaming: tokens are pulled from the lexer on demand into a small ring,
+//so memory does not grow with the source size
+Parser* init_stream_parser(Lexer* l){
+    TokenArr* ring = init_token_arr(PARSER_RING);
+    ring->source=l->source;
+
+    Parser* p = init_parser(ring);
+    p->mask=PARSER_RING-1;
+    p->lexer=l;
+
+    return p;
+}
+
+void free_parser(Parser* p){
+    if (p->lexer){
+        free_token_arr(p->tokens);
+    }
+    free(p->vals);
+    free(p->ops);
+    free(p);
+}
+
+static void pull_token(Parser* p){
+    TokenArr* ring = p->tokens;
+    Token tok;
+
+    size_t last = (p->avail-1) & p->mask;
+    if (p->avail && (ring->kinds[last]==EOF_TOK || ring->kinds[last]==ERR_TOK)){//nothing past the end
+        tok=token_at(ring, last);
+        tok.type=EOF_TOK;
+    } else {
+        tok=scan_tok(p->lexer);
+    }
+
+    token_put(ring, p->avail & p->mask, tok);
+    p->tok_end[p->avail & p->mask]=p->lexer->curr;
+    p->avail++;
+    ring->count=p->avail;
+}
+
+//slot of token i, pulling from the lexer when streaming
+static size_t tok_idx(Parser* p, size_t i){
+    while (i>=p->avail) pull_token(p);
+    return i & p->mask;
+}
+
 static void parser_error(Parser* p, const char* msg){
     p->had_error=1;
+    p->errors++;
     strncpy(p->error_msg, msg, sizeof(p->error_msg)-1);
     p->error_msg[sizeof(p->error_msg)-1] = '\0';
-    fprintf(stderr, "parser error: %s at line %d\n", msg, p->tokens->tokens[p->curr].line);
+    if (!p->quiet) fprintf(stderr, "parser error: %s at line %d\n", msg, p->tokens->lines[tok_idx(p, p->curr)]);
+}
+
+//kinds only, payloads are read through prev_val() once a token is consumed
+static TokenT peek(Parser* p){
+    if (p->curr>=p->limit) return EOF_TOK;
+    return (TokenT)p->tokens->kinds[tok_idx(p, p->curr)];
 }
 
-static Token peek(Parser* p){
-    return p->tokens->tokens[p->curr];
+static TokenT prev(Parser* p){
+    return (TokenT)p->tokens->kinds[tok_idx(p, p->curr-1)];
 }
 
-static Token prev(Parser* p){
-    return p->tokens->tokens[p->curr-1];
+static const TokenVal* prev_val(Parser* p){
+    return &p->tokens->vals[tok_idx(p, p->curr-1)];
 }
 
 static int is_at_end(Parser* p){
-    return peek(p).type==EOF_TOK;
+    return peek(p)==EOF_TOK;
 }
 
-static Token advance(Parser* p){
+static void advance(Parser* p){
     if (!is_at_end(p)) p->curr++;
-    return prev(p);
+}
+
+static const char* tok_str(Parser* p, StrView str){
+    return p->source+str.offset;
 }
 
 static int check(Parser* p, TokenT type){
     if (is_at_end(p)) return 0;
-    return peek(p).type==type;
+    return peek(p)==type;
 }
 
 static int match(Parser* p, TokenT type){
@@ -80,10 +149,10 @@ static void eat(Parser* p, TokenT type, const char* msg){
 }
 
 
-static ASTNode* parse_expression(Parser* p);
-static ASTNode* parse_declaration(Parser* p);
-static ASTNode* parse_stmt(Parser* p);
-static ASTNode* parse_block(Parser* p);
+static NodeId parse_expression(Parser* p);
+static NodeId parse_declaration(Parser* p);
+static NodeId parse_stmt(Parser* p);
+static NodeId parse_block(Parser* p);
 
 // static VarT infer_var_type(const char* id, ExecutionContext* ctx){//num as fallback
 //     if (ctx->curr_scope){
@@ -97,101 +166,175 @@ static ASTNode* parse_block(Parser* p);
 //     return NUM;
 // }
 
-static ASTNode* parse_primary(Parser* p){//nums, bools, parentheses
-    if (match(p, NUM_TOK)) return create_num_node(prev(p).val.num);
+static NodeId parse_primary(Parser* p){//nums, bools, names
+    if (match(p, NUM_TOK)) return create_num_node(prev_val(p)->num);
     if (match(p, TRUE_TOK)) return create_bool_node(1);
     if (match(p, FALSE_TOK)) return create_bool_node(0);
     if (match(p, ID_TOK)) {
-        char* id = prev(p).val.str;
+        StrView id = prev_val(p)->str;
 
-        return create_var_ref_node(id);
-    }
-    if (match(p, LPAREN_TOK)){
-        ASTNode* expr = parse_expression(p);
-        eat(p, RPAREN_TOK, "expected ')' after expression");
-        return expr;
+        return create_var_ref_node(tok_str(p, id), id.len);
     }
 
     parser_error(p, "expected expression\n");
-    return NULL;
+    return 0;
 }
 
-static ASTNode* parse_pow(Parser* p){
-    ASTNode* expr = parse_primary(p);
+//binding power of a binary operator token, 0 for anything else
+static int op_prec(TokenT t){
+    switch (t){
+        case EQ_TOK:
+        case SMALLER_THAN_TOK:
+        case BIGGER_THAN_TOK: return 1;
+        case PLUS_TOK:
+        case MINUS_TOK: return 2;
+        case MULT_TOK:
+        case DIV_TOK: return 3;
+        case POW_TOK: return 4;//right associative
+        default: return 0;
+    }
+}
 
-    while (match(p, POW_TOK)){
-        ASTNode* right = parse_pow(p);
-        expr = create_bin_op_node(POW, expr, right);
+static void push_val(Parser* p, NodeId n){
+    if (p->val_count==p->val_capacity){
+        p->val_capacity = p->val_capacity ? p->val_capacity*2 : 64;
+        p->vals=(NodeId*)realloc(p->vals, sizeof(NodeId)*p->val_capacity);
+        if (!p->vals){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
     }
 
-    return expr;
+    p->vals[p->val_count++]=n;
 }
 
-static ASTNode* parse_factor(Parser* p){
-    ASTNode* expr = parse_pow(p);
-
-    while (match(p, MULT_TOK) || match(p, DIV_TOK)){
-        BinOpT op = prev(p).type == MULT_TOK ? MULT : DIV;
-        ASTNode* right = parse_pow(p);
-        expr = create_bin_op_node(op, expr, right);
+static void push_op(Parser* p, TokenT t){
+    if (p->op_count==p->op_capacity){
+        p->op_capacity = p->op_capacity ? p->op_capacity*2 : 64;
+        p->ops=(uint8_t*)realloc(p->ops, p->op_capacity);
+        if (!p->ops){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
     }
 
-    return expr;
+    p->ops[p->op_count++]=(uint8_t)t;
 }
 
-static ASTNode* parse_term(Parser* p){
-    ASTNode* expr = parse_factor(p);
+//pops the top operator and its two operands, pushes the combined node
+static void reduce(Parser* p){
+    TokenT t = (TokenT)p->ops[--p->op_count];
+    NodeId right = p->vals[--p->val_count];
+    NodeId left = p->vals[--p->val_count];
+    NodeId n = 0;
+
+    switch (t){
+        case PLUS_TOK: n = create_bin_op_node(PLUS, left, right); break;
+        case MINUS_TOK: n = create_bin_op_node(MINUS, left, right); break;
+        case MULT_TOK: n = create_bin_op_node(MULT, left, right); break;
+        case DIV_TOK: n = create_bin_op_node(DIV, left, right); break;
+        case POW_TOK: n = create_bin_op_node(POW, left, right); break;
+        case EQ_TOK: n = create_cond_node(EQ, left, right); break;
+        case SMALLER_THAN_TOK: n = create_cond_node(SMALLER_THAN, left, right); break;
+        case BIGGER_THAN_TOK: n = create_cond_node(BIGGER_THAN, left, right); break;
+        default: break;
+    }
 
-    while (match(p, PLUS_TOK) || match(p, MINUS_TOK)){
-        BinOpT op = prev(p).type == PLUS_TOK ? PLUS : MINUS;
-        ASTNode* right = parse_factor(p);
-        expr = create_bin_op_node(op, expr, right);
+    push_val(p, n);
+}
+
+//comparisons do not chain, and nothing but ')' or the end of the
+//expression reduces one, so a pending one means this group already has it
+static int group_has_cond(Parser* p, size_t op_base){
+    for (size_t i=p->op_count; i>op_base; i--){
+        TokenT t = (TokenT)p->ops[i-1];
+        if (t==LPAREN_TOK) return 0;
+        if (op_prec(t)==1) return 1;
     }
 
-    return expr;
+    return 0;
 }
 
-static ASTNode* parse_comparison(Parser* p){
-    ASTNode* expr = parse_term(p);
+//operator precedence parsing on explicit stacks, so neither nesting depth
+//nor chain length grows the C stack
+static NodeId parse_expression(Parser* p){
+    size_t val_base = p->val_count;
+    size_t op_base = p->op_count;
+    int open_groups = 0;
+
+    while (1){
+        while (match(p, LPAREN_TOK)){
+            push_op(p, LPAREN_TOK);
+            open_groups++;
+        }
+
+        NodeId operand = parse_primary(p);
+        if (!operand){
+            p->val_count=val_base;
+            p->op_count=op_base;
+            return 0;
+        }
+        push_val(p, operand);
+
+        while (open_groups && check(p, RPAREN_TOK)){
+            advance(p);
+            while (p->ops[p->op_count-1]!=LPAREN_TOK) reduce(p);
+            p->op_count--;
+            open_groups--;
+        }
+
+        TokenT t = peek(p);
+        int prec = op_prec(t);
+        if (!prec) break;
+        if (prec==1 && group_has_cond(p, op_base)) break;
+
+        advance(p);
+        while (p->op_count>op_base){
+            TokenT top = (TokenT)p->ops[p->op_count-1];
+            if (top==LPAREN_TOK) break;
 
-    if (match(p, EQ_TOK)){
-        ASTNode* right = parse_term(p);
-        return create_cond_node(EQ, expr, right);
-    } else if (match(p, SMALLER_THAN_TOK)){
-        ASTNode* right = parse_term(p);
-        return create_cond_node(SMALLER_THAN, expr, right);
-    } else if (match(p, BIGGER_THAN_TOK)){
-        ASTNode* right = parse_term(p);
-        return create_cond_node(BIGGER_THAN, expr, right);
+            int top_prec = op_prec(top);
+            if (top_prec<prec || (top_prec==prec && t==POW_TOK)) break;
+            reduce(p);
+        }
+        push_op(p, t);
     }
 
-    return expr;
-}
+    if (open_groups) parser_error(p, "expected ')' after expression");
 
-static ASTNode* parse_expression(Parser* p){
-    return parse_comparison(p);
+    while (p->op_count>op_base){
+        if (p->ops[p->op_count-1]==LPAREN_TOK){
+            p->op_count--;
+        } else {
+            reduce(p);
+        }
+    }
+
+    NodeId expr = p->vals[--p->val_count];
+    p->val_count=val_base;
+    return expr;
 }
 
-static ASTNode* parse_var_declaration(Parser* p){
+static NodeId parse_var_declaration(Parser* p){
     if (!check(p, ID_TOK)){
         parser_error(p, "expected variable name");
-        return NULL;
+        return 0;
     }
 
-    char id[VAR_LEN];
-    strncpy(id, peek(p).val.str, VAR_LEN-1);
-    id[VAR_LEN-1]='\0';
     advance(p);
+    StrView id_str = prev_val(p)->str;
+    const char* id = tok_str(p, id_str);
+    size_t id_len = id_str.len;
 
     //let x := 9;
     if (match(p, COLON_ASSIGN_TOK)){
-        ASTNode* initializer = parse_expression(p);
+        NodeId initializer = parse_expression(p);
         eat(p, SEMICOLON_TOK, "expected ';' after variable declaration");
 
-        if (initializer->type==BOOL_VAL){
-            return create_dec_node_bool(initializer, id);
+        if (ast_node(initializer)->type==BOOL_VAL){
+            return create_dec_node_bool(initializer, id, id_len);
         } else {
-            return create_dec_node_num(initializer, id);
+            return create_dec_node_num(initializer, id, id_len);
         }
     }
 
@@ -199,191 +342,380 @@ static ASTNode* parse_var_declaration(Parser* p){
 
         //let x: num = 9;
         if (check(p, ID_TOK)){
-            const char* type_name = peek(p).val.str;
             advance(p);
+            StrView type_name = prev_val(p)->str;
 
             eat(p, ASSIGN_TOK, "expected '=' after type in variable declaration");
-            ASTNode* initializer = parse_expression(p);
+            NodeId initializer = parse_expression(p);
             eat(p, SEMICOLON_TOK, "expected ';' after variable declaration");
 
-            if (strcmp(type_name, "num")==0){
-                return create_dec_node_num(initializer, id);
-            } else if (strcmp(type_name, "bool")==0){
-                return create_dec_node_bool(initializer, id);
+            if (tok_str_eq(p->source, type_name, "num")){
+                return create_dec_node_num(initializer, id, id_len);
+            } else if (tok_str_eq(p->source, type_name, "bool")){
+                return create_dec_node_bool(initializer, id, id_len);
             } else {
                 parser_error(p, "unknown variable");
-                return NULL;
+                return 0;
             }
         } else {
             parser_error(p, "expected type name after ':'");
-            return NULL;
+            return 0;
         }
     } else if (match(p, ASSIGN_TOK)){
-        ASTNode* initializer = parse_expression(p);
+        NodeId initializer = parse_expression(p);
         eat(p, SEMICOLON_TOK, "expected ';' after variable declaration");
 
-        if (initializer->type==BOOL_VAL){
-            return create_dec_node_bool(initializer, id);
+        if (ast_node(initializer)->type==BOOL_VAL){
+            return create_dec_node_bool(initializer, id, id_len);
         } else {
-            return create_dec_node_num(initializer, id);
+            return create_dec_node_num(initializer, id, id_len);
         }
     } else {
         parser_error(p, "expected ':' or '=' after variable name");
-        return NULL;
+        return 0;
     }
 }
 
-static ASTNode* parse_if_statement(Parser* p){
-    ASTNode* cond = parse_expression(p);
-    ASTNode* body = parse_block(p);
+static NodeId parse_if_statement(Parser* p){
+    NodeId cond = parse_expression(p);
+    NodeId body = parse_block(p);
 
     return create_if_node(cond, body);
 }
 
-static ASTNode* parse_for_loop(Parser* p){
+static NodeId parse_for_loop(Parser* p){
     if (!match(p, ID_TOK)){
         parser_error(p, "expected loop variable name");
-        return NULL;
+        return 0;
     }
 
-    char iter_name[VAR_LEN];
-    strncpy(iter_name, prev(p).val.str, VAR_LEN-1);
-    iter_name[VAR_LEN-1]='\0';
+    StrView iter_name = prev_val(p)->str;
 
     eat(p, COLON_TOK, "expected ':' after loop variable");
 
     if (!match(p, NUM_TOK)){
         parser_error(p, "expected num start value");
-        return NULL;
+        return 0;
     }
 
-    int start = (int)prev(p).val.num;
+    int start = (int)prev_val(p)->num;
 
     eat(p, ARROW_TOK, "expected '->' between loop bounds");
 
     if (!match(p, NUM_TOK)){
         parser_error(p, "expected num start value");
-        return NULL;
+        return 0;
     }
 
-    int end = (int)prev(p).val.num;
+    int end = (int)prev_val(p)->num;
 
-    ASTNode* body = parse_block(p);
+    NodeId body = parse_block(p);
 
-    return create_loop_node(body, iter_name, start, end);
+    return create_loop_node(body, tok_str(p, iter_name), iter_name.len, start, end);
 }
 
-static ASTNode* parse_print_statement(Parser* p){
+static NodeId parse_print_statement(Parser* p){
     MacroT type;
 
-    if (prev(p).type==PRINT_TOK){
+    if (prev(p)==PRINT_TOK){
         type=PRINT;
     } else {
         type=PRINTLN;
     }
 
-    ASTNode* val = parse_expression(p);
+    NodeId val = parse_expression(p);
     eat(p, SEMICOLON_TOK, "expected ';' after print statement");
 
     return create_macro_node(type, val);
 }
 
-static ASTNode* parse_block(Parser* p){
+static NodeId parse_block(Parser* p){
     eat(p, LBRACE_TOK, "expected '{' before block");
 
-    ASTNode** statements = NULL;
-    int stmt_count = 0;
+    NodeId block = create_block_node(NULL, 0, NULL);
 
     while (!check(p, RBRACE_TOK) && !is_at_end(p)){
-        ASTNode* stmt = parse_stmt(p);
+        NodeId stmt = parse_stmt(p);
 
         if (stmt){
-            stmt_count++;
-            statements=(ASTNode**)realloc(statements, sizeof(ASTNode*) * stmt_count);
-            if (!statements){
-                fprintf(stderr, "memory allocation failed");
-                exit(EXIT_FAILURE);
-            }
-
-            statements[stmt_count-1] = stmt;
+            add_stmt_to_scope(block, stmt);
         }
     }
 
     eat(p, RBRACE_TOK, "expected '}' after block");
 
-    if (stmt_count==0){
-        ASTNode* empty_block = create_block_node(statements, stmt_count, NULL);
-        free(statements);
-        return empty_block;
-    }
-
-    return create_block_node(statements, stmt_count, NULL);
+    return block;
 }
 
-static ASTNode* parse_assignment(Parser* p){
+static NodeId parse_assignment(Parser* p){
     if (check(p, ID_TOK)){
         size_t curr_pos = p->curr;
 
-        Token id_tok = advance(p);
-        char* id = id_tok.val.str;
+        advance(p);
+        StrView id_str = prev_val(p)->str;
+        const char* id = tok_str(p, id_str);
+        size_t id_len = id_str.len;
 
         if (match(p, ASSIGN_TOK)){
-            ASTNode* expr = parse_expression(p);
+            NodeId expr = parse_expression(p);
             eat(p, SEMICOLON_TOK, "expected ';' after statement");
 
-            if (expr->type==BOOL_VAL || expr->type==BOOL_REF || expr->type==COND){
-                return create_reassign_node_bool(id, expr);
+            ASTNodeT type = ast_node(expr)->type;
+            if (type==BOOL_VAL || type==BOOL_REF || type==COND){
+                return create_reassign_node_bool(id, id_len, expr);
             } else {
-                return create_reassign_node_num(id, expr);
+                return create_reassign_node_num(id, id_len, expr);
             }
         } else {
             p->curr = curr_pos;
         }
     }
 
-    return NULL;
+    return 0;
 }
 
-static ASTNode* parse_stmt(Parser* p){
-    ASTNode* assign_stmt = parse_assignment(p);
+static NodeId parse_stmt(Parser* p){
+    NodeId assign_stmt = parse_assignment(p);
     if (assign_stmt) return assign_stmt;
 
     if (match(p, LET_TOK)) return parse_var_declaration(p);
     if (match(p, IF_TOK)) return parse_if_statement(p);
     if (match(p, PRINT_TOK) || match(p,PRINTLN_TOK)) return parse_print_statement(p);
     if (match(p, FOR_TOK)) return parse_for_loop(p);
+    if (match(p, PARALLEL_TOK)){
+        eat(p, FOR_TOK, "expected 'for' after 'parallel'");
+        NodeId loop = parse_for_loop(p);
+        if (loop) ast_node(loop)->op=LOOP_PARALLEL;
+        return loop;
+    }
 
-    ASTNode* expr = parse_expression(p);
+    NodeId expr = parse_expression(p);
     eat(p, SEMICOLON_TOK, "expected ';' after expression");
     return expr;
 }
 
-static ASTNode* parse_declaration(Parser* p){
+static NodeId parse_declaration(Parser* p){
     return parse_stmt(p);
 }
 
-ASTNode* parse(TokenArr* tokens){
-    Parser* p = init_parser(tokens);
+//one top-level statement, on errors everything up to the next ';' is skipped
+static NodeId parse_top_level(Parser* p){
+    NodeId decl = parse_declaration(p);
 
-    ASTNode* program = create_scope_node(NULL); //global scope
+    if (p->had_error){
+        while (!is_at_end(p) && !match(p, SEMICOLON_TOK)){
+            advance(p);
+        }
+
+        p->had_error=0;
+    }
+
+    return decl;
+}
+
+static NodeId parse_program(Parser* p){
+    NodeId program = create_program_node(); //global scope
 
     while (!is_at_end(p)){
-        ASTNode* decl = parse_declaration(p);
+        NodeId decl = parse_top_level(p);
         if (decl) {
             add_stmt_to_scope(program, decl);
         }
+    }
+
+    return program;
+}
 
-        if (p->had_error){
-            while (!is_at_end(p) && !match(p, SEMICOLON_TOK)){
-                advance(p);
+int parser_done(Parser* p){
+    return is_at_end(p);
+}
+
+//streaming only, *end is the source offset just past the statement
+NodeId parse_next_stmt(Parser* p, size_t* end){
+    NodeId stmt = parse_top_level(p);
+    *end = p->curr ? p->tok_end[(p->curr-1) & p->mask] : p->lexer->curr;
+
+    return stmt;
+}
+
+ASTNode* parse(TokenArr* tokens){
+    Parser* p = init_parser(tokens);
+    NodeId program = parse_program(p);
+
+    free_parser(p);
+    return ast_node(program);
+}
+
+//parallel parsing: a top-level statement only depends on its own tokens and
+//ends at a ';' or '}' at brace depth 0, so the token array is cut there into
+//slices that workers parse concurrently, spliced back into the program in order.
+//any error sends the program back through the sequential parser, which
+//reports errors in order and recovers the same way it always does
+
+typedef struct {
+    size_t begin;
+    size_t end;
+    NodeId* stmts;
+    size_t count;
+    size_t capacity;
+    int errors;
+} ParseSlice;
+
+typedef struct {
+    TokenArr* tokens;
+    AstPool* program;
+    ParseSlice* slices;
+    int n_slices;
+    int next;//next slice to claim
+} ParseJob;
+
+static ParseSlice* cut_slices(TokenArr* tokens, size_t min_len, int* count){
+    size_t n = tokens->count-1;//EOF_TOK ends the last slice
+    int capacity = (int)(n/min_len)+1;
+    ParseSlice* slices = (ParseSlice*)calloc(capacity, sizeof(ParseSlice));
+    if (!slices){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    int c=0;
+    size_t begin=0;
+    long depth=0;
+    for (size_t i=0; i<n; i++){
+        uint8_t k = tokens->kinds[i];
+        int boundary=0;
+
+        if (k==LBRACE_TOK){
+            depth++;
+        } else if (k==RBRACE_TOK){
+            boundary = --depth==0;
+        } else if (k==SEMICOLON_TOK){
+            boundary = depth==0;
+        }
+
+        if (boundary && i+1-begin>=min_len && c<capacity-1){
+            slices[c].begin=begin;
+            slices[c++].end=i+1;
+            begin=i+1;
+        }
+    }
+
+    if (begin<n || !c){
+        slices[c].begin=begin;
+        slices[c++].end=n;
+    } else {
+        slices[c-1].end=n;
+    }
+
+    *count=c;
+    return slices;
+}
+
+static void parse_slice(Parser* p, ParseSlice* s){
+    p->curr=s->begin;
+    p->limit=s->end;
+    p->errors=0;
+
+    while (!is_at_end(p)){
+        NodeId decl = parse_top_level(p);
+        if (!decl) continue;
+
+        if (s->count==s->capacity){
+            s->capacity = s->capacity ? s->capacity*2 : 256;
+            s->stmts=(NodeId*)realloc(s->stmts, sizeof(NodeId)*s->capacity);
+            if (!s->stmts){
+                fprintf(stderr, "memory allocation failed\n");
+                exit(EXIT_FAILURE);
             }
+        }
+        s->stmts[s->count++]=decl;
+    }
+
+    s->errors=p->errors;
+}
+
+static void* parse_worker(void* arg){
+    ParseJob* job = (ParseJob*)arg;
+    join_ast_pool(job->program);
+
+    Parser* p = init_parser(job->tokens);
+    p->quiet=1;
+
+    while (1){
+        int i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED);
+        if (i>=job->n_slices) break;
+
+        parse_slice(p, &job->slices[i]);
+    }
 
-            p->had_error=0;
+    free_parser(p);
+    return NULL;
+}
+
+static void run_parse_job(ParseJob* job, int n_threads){
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t)*n_threads);
+    if (!threads){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    job->next=0;
+    int started=0;
+    for (int i=1; i<n_threads; i++){//the calling thread is worker 0
+        if (pthread_create(&threads[i], NULL, parse_worker, job)!=0) break;
+        started=i;
+    }
+
+    parse_worker(job);
+
+    for (int i=1; i<=started; i++){
+        pthread_join(threads[i], NULL);
+    }
+
+    free(threads);
+    ast_pool=job->program;
+}
+
+ASTNode* parse_parallel(TokenArr* tokens, int n_threads){
+    //a few slices per thread so uneven ones even out
+    size_t min_len = tokens->count/((size_t)n_threads*4);
+    if (min_len<PARALLEL_PARSE_SLICE) min_len=PARALLEL_PARSE_SLICE;
+    if (n_threads<=1 || tokens->count<2*min_len) return parse(tokens);
+
+    ParseJob job;
+    job.tokens=tokens;
+    job.slices=cut_slices(tokens, min_len, &job.n_slices);
+
+    NodeId program = create_program_node();
+    job.program=ast_pool;
+    run_parse_job(&job, n_threads);
+
+    int errors=0;
+    for (int i=0; i<job.n_slices; i++){
+        ParseSlice* s = &job.slices[i];
+        errors+=s->errors;
+
+        for (size_t j=0; j<s->count; j++){
+            add_stmt_to_scope(program, s->stmts[j]);
         }
+        free(s->stmts);
     }
+    free(job.slices);
 
-    free(p);
-    return program;
+    if (errors){
+        free_ast(ast_node(program));
+        return parse(tokens);
+    }
+
+    return ast_node(program);
+}
+
+ASTNode* parse_stream(Lexer* l){
+    Parser* p = init_stream_parser(l);
+    NodeId program = parse_program(p);
+
+    free_parser(p);
+    return ast_node(program);
 }
 
 ASTNode* parse_file(const char* source){
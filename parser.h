@@ -4,14 +4,39 @@
 #include "lexer.h"
 #include "ast.h"
 
+#define PARSER_RING 16 //power of 2, must cover the parser's lookbehind
+#define PARALLEL_PARSE_SLICE (64*1024)//min tokens per slice handed to a parse worker
+
 typedef struct {
-    TokenArr* tokens;
+    TokenArr* tokens;//whole program, or a PARSER_RING sized window when streaming
+    const char* source;
     size_t curr;
-    int had_error;
+    size_t avail;//tokens scanned so far
+    size_t limit;//reads as EOF_TOK from here on, slice end when parsing in parallel
+    size_t mask;//index mask into tokens, all ones unless streaming
+    Lexer* lexer;//pull source in streaming mode, NULL otherwise
+    size_t tok_end[PARSER_RING];//source offset past each ring token, streaming only
+    NodeId* vals;//expression operands, reused across expressions
+    size_t val_count;
+    size_t val_capacity;
+    uint8_t* ops;//pending operator tokens, LPAREN_TOK opens a group
+    size_t op_count;
+    size_t op_capacity;
+    int had_error;//cleared after each top-level statement
+    int errors;
+    int quiet;//count errors without printing them
     char error_msg[256];
 } Parser;
 
 ASTNode* parse(TokenArr* tokens);
+ASTNode* parse_stream(Lexer* l);
+ASTNode* parse_parallel(TokenArr* tokens, int n_threads);
 ASTNode* parse_file(const char* source);
 
+//statement at a time over a lexer, build into an existing program (watch mode)
+Parser* init_stream_parser(Lexer* l);
+void free_parser(Parser* p);
+int parser_done(Parser* p);
+NodeId parse_next_stmt(Parser* p, size_t* end);
+
 #endif
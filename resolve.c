@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resolve.h"
+#include "ast.h"
+
+//a name visible while walking the tree, each symbol has a stack of them
+typedef struct {
+    SymId sym;
+    uint32_t level;//nesting of the declaring scope, the program is 0
+    uint32_t slot;
+    uint32_t prev;//binding it hides, 0 for none
+} Binding;
+
+typedef struct {
+    uint32_t* head;//innermost binding per symbol, 0 for none
+    Binding* bindings;//[0] unused
+    uint32_t binding_count;
+    uint32_t binding_capacity;
+    NodeId* stack;//expression nodes still to visit
+    size_t stack_count;
+    size_t stack_capacity;
+} Resolver;
+
+static void push_binding(Resolver* r, SymId sym, uint32_t level, uint32_t slot){
+    if (r->binding_count==r->binding_capacity){
+        r->binding_capacity*=2;
+        r->bindings=(Binding*)realloc(r->bindings, sizeof(Binding)*r->binding_capacity);
+        if (!r->bindings){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uint32_t b = r->binding_count++;
+    r->bindings[b].sym=sym;
+    r->bindings[b].level=level;
+    r->bindings[b].slot=slot;
+    r->bindings[b].prev=r->head[sym];
+    r->head[sym]=b;
+}
+
+static void push_node(Resolver* r, NodeId n){
+    if (r->stack_count==r->stack_capacity){
+        r->stack_capacity = r->stack_capacity ? r->stack_capacity*2 : 64;
+        r->stack=(NodeId*)realloc(r->stack, sizeof(NodeId)*r->stack_capacity);
+        if (!r->stack){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    r->stack[r->stack_count++]=n;
+}
+
+//outgrown frames stay in the arena
+static uint32_t add_slot(ScopeData* scope, SymId sym){
+    if (scope->slot_count==scope->slot_capacity){
+        uint32_t capacity = scope->slot_capacity ? scope->slot_capacity*2 : 4;
+        Slot* frame = (Slot*)arena_alloc(scope->arena, sizeof(Slot)*capacity);
+        SlotInfo* info = (SlotInfo*)arena_alloc(scope->arena, sizeof(SlotInfo)*capacity);
+
+        if (scope->slot_count){
+            memcpy(frame, scope->frame, sizeof(Slot)*scope->slot_count);
+            memcpy(info, scope->slot_info, sizeof(SlotInfo)*scope->slot_count);
+        }
+        for (uint32_t i=scope->slot_count; i<capacity; i++) frame[i].v=VAL_UNDEF;
+
+        scope->frame=frame;
+        scope->slot_info=info;
+        scope->slot_capacity=capacity;
+    }
+
+    scope->slot_info[scope->slot_count].sym=sym;
+    scope->slot_info[scope->slot_count].type=0;
+    return scope->slot_count++;
+}
+
+//links the slot to the binding it will hide, then binds it
+static void bind_slot(Resolver* r, ScopeData* scope, uint32_t slot, uint32_t level){
+    SlotInfo* info = &scope->slot_info[slot];
+    uint32_t outer = r->head[info->sym];
+
+    info->outer_depth = outer ? level-r->bindings[outer].level : 0;
+    info->outer_slot = outer ? r->bindings[outer].slot : 0;
+
+    push_binding(r, info->sym, level, slot);
+}
+
+static void resolve_name(Resolver* r, ASTNode* n, uint32_t level){
+    uint32_t b = r->head[n->sym];
+    if (!b){
+        n->val.var.depth=VAR_UNRESOLVED;//a runtime error if it ever runs
+        n->val.var.slot=0;
+        return;
+    }
+
+    n->val.var.depth=level-r->bindings[b].level;
+    n->val.var.slot=r->bindings[b].slot;
+}
+
+//explicit stack, expressions can be deeper than the C stack
+static void resolve_expr(Resolver* r, NodeId id, uint32_t level){
+    if (!id) return;
+
+    size_t base = r->stack_count;
+    push_node(r, id);
+
+    while (r->stack_count>base){
+        ASTNode* n = ast_node(r->stack[--r->stack_count]);
+
+        switch (n->type){
+            case VAR_REF:
+            case NUM_REF:
+            case BOOL_REF:
+                resolve_name(r, n, level);
+                break;
+            case B_OP:
+            case COND:
+                if (n->left) push_node(r, n->left);
+                if (n->right) push_node(r, n->right);
+                break;
+            case HOIST:
+            case INDUCTION://right links the loop's list, not an operand
+                push_node(r, n->left);
+                break;
+            case N_OP:
+                for (uint32_t i=0; i<n->val.nary->count; i++){
+                    if (n->val.nary->args[i]) push_node(r, n->val.nary->args[i]);
+                }
+                break;
+            default: break;
+        }
+    }
+}
+
+static void resolve_scope(Resolver* r, ScopeData* scope, uint32_t level, int first);
+
+static void resolve_stmt(Resolver* r, NodeId id, uint32_t level){
+    ASTNode* n = ast_node(id);
+    if (!n) return;
+
+    switch (n->type){
+        case NUM_DEC:
+        case BOOL_DEC:
+            resolve_expr(r, n->left, level);
+            n->val.var.depth=0;
+            n->val.var.slot=r->bindings[r->head[n->sym]].slot;
+            break;
+        case NUM_REASSIGN:
+        case BOOL_REASSIGN:
+        case NUM_SET:
+        case BOOL_SET:
+            resolve_expr(r, n->left, level);
+            resolve_name(r, n, level);
+            break;
+        case MACRO:
+        case PRINT_NUM:
+        case PRINT_BOOL:
+            resolve_expr(r, n->left, level);
+            break;
+        case IF:
+        case IF_NUM:
+        case IF_BOOL:
+            resolve_expr(r, n->left, level);
+            resolve_stmt(r, n->right, level);
+            break;
+        case LOOP:
+            resolve_stmt(r, n->right, level);
+            break;
+        case SCOPE:
+        case BLOCK:
+            resolve_scope(r, n->val.scope, level+1, 0);
+            break;
+        default:
+            resolve_expr(r, id, level);
+            break;
+    }
+}
+
+//every name the scope declares is bound from its first statement on,
+//lookup_slot() falls back to the outer one until the declaration runs.
+//statements before first are only walked again if the scope gained names
+static void resolve_scope(Resolver* r, ScopeData* scope, uint32_t level, int first){
+    uint32_t mark = r->binding_count;
+    uint32_t known = scope->slot_count;
+
+    for (uint32_t i=0; i<scope->slot_count; i++){
+        bind_slot(r, scope, i, level);
+    }
+
+    for (int i=0; i<scope->stmt_count; i++){
+        ASTNode* n = ast_node(scope->statements[i]);
+        if (!n || (n->type!=NUM_DEC && n->type!=BOOL_DEC)) continue;
+
+        uint32_t b = r->head[n->sym];
+        if (b && r->bindings[b].level==level) continue;
+
+        bind_slot(r, scope, add_slot(scope, n->sym), level);
+    }
+
+    if (scope->slot_count!=known) first=0;
+    for (int i=first; i<scope->stmt_count; i++){
+        resolve_stmt(r, scope->statements[i], level);
+    }
+
+    while (r->binding_count>mark){
+        Binding* b = &r->bindings[--r->binding_count];
+        r->head[b->sym]=b->prev;
+    }
+}
+
+void resolve_program(ASTNode* program){
+    resolve_from(program, 0);
+}
+
+void resolve_from(ASTNode* program, int first){
+    if (!program) return;
+
+    Resolver r;
+    r.head=(uint32_t*)calloc(program->val.scope->pool->sym_count, sizeof(uint32_t));
+    r.binding_capacity=256;
+    r.binding_count=1;
+    r.bindings=(Binding*)malloc(sizeof(Binding)*r.binding_capacity);
+    r.stack=NULL;
+    r.stack_count=0;
+    r.stack_capacity=0;
+    if (!r.head || !r.bindings){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    resolve_scope(&r, program->val.scope, 0, first);
+
+    free(r.head);
+    free(r.bindings);
+    free(r.stack);
+}
@@ -0,0 +1,15 @@
+#ifndef RESOLVE_H
+#define RESOLVE_H
+
+#include "ast.h"
+
+//name resolution, run after parsing: every scope gets a frame with a slot
+//per name declared directly in it, and every declaration, reference and
+//reassignment a (depth, slot) pair, so execution never looks names up.
+//slots are only ever appended, resolving a tree again (watch mode) keeps
+//the values already in its frames
+
+void resolve_program(ASTNode* program);
+void resolve_from(ASTNode* program, int first);//after top-level statements from first on changed
+
+#endif
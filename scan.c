@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+typedef size_t (*WspaceFn)(const char*, size_t, size_t, int*);
+typedef size_t (*RunFn)(const char*, size_t, size_t);
+
+static size_t wspace_scalar(const char* s, size_t i, size_t len, int* newlines){
+    int nl=0;
+    while (i<len){
+        char c = s[i];
+        if (c=='\n'){
+            nl++;
+        } else if (c!=' ' && c!='\t' && c!='\r'){
+            break;
+        }
+        i++;
+    }
+
+    *newlines+=nl;
+    return i;
+}
+
+static size_t ident_scalar(const char* s, size_t i, size_t len){
+    while (i<len && scan_is_ident((unsigned char)s[i])) i++;
+    return i;
+}
+
+static size_t digits_scalar(const char* s, size_t i, size_t len){
+    while (i<len && (unsigned char)(s[i]-'0')<10) i++;
+    return i;
+}
+
+#ifdef SCAN_X86
+
+//unsigned range checks on bytes: bias by 0x80 and use the signed compare
+#define RANGE_BIAS(lo) ((char)(0x80-(lo)))
+#define RANGE_LIMIT(n) ((char)(-128+(n)))
+
+__attribute__((target("sse2")))
+static size_t wspace_sse2(const char* s, size_t i, size_t len, int* newlines){
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i nl = _mm_set1_epi8('\n');
+
+    while (i+16<=len){
+        __m128i v = _mm_loadu_si128((const __m128i*)(s+i));
+        __m128i is_nl = _mm_cmpeq_epi8(v, nl);
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, cr), is_nl));
+
+        unsigned int ws_mask = (unsigned int)_mm_movemask_epi8(ws);
+        unsigned int nl_mask = (unsigned int)_mm_movemask_epi8(is_nl);
+
+        if (ws_mask!=0xFFFFu){
+            unsigned int stop = __builtin_ctz(~ws_mask);
+            *newlines+=__builtin_popcount(nl_mask & ((1u<<stop)-1));
+            return i+stop;
+        }
+
+        *newlines+=__builtin_popcount(nl_mask);
+        i+=16;
+    }
+
+    return wspace_scalar(s, i, len, newlines);
+}
+
+__attribute__((target("sse2")))
+static size_t ident_sse2(const char* s, size_t i, size_t len){
+    while (i+16<=len){
+        __m128i v = _mm_loadu_si128((const __m128i*)(s+i));
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+        __m128i alpha = _mm_cmplt_epi8(_mm_add_epi8(lower, _mm_set1_epi8(RANGE_BIAS('a'))), _mm_set1_epi8(RANGE_LIMIT(26)));
+        __m128i digit = _mm_cmplt_epi8(_mm_add_epi8(v, _mm_set1_epi8(RANGE_BIAS('0'))), _mm_set1_epi8(RANGE_LIMIT(10)));
+        __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), under));
+        if (mask!=0xFFFFu) return i+__builtin_ctz(~mask);
+
+        i+=16;
+    }
+
+    return ident_scalar(s, i, len);
+}
+
+__attribute__((target("sse2")))
+static size_t digits_sse2(const char* s, size_t i, size_t len){
+    while (i+16<=len){
+        __m128i v = _mm_loadu_si128((const __m128i*)(s+i));
+        __m128i digit = _mm_cmplt_epi8(_mm_add_epi8(v, _mm_set1_epi8(RANGE_BIAS('0'))), _mm_set1_epi8(RANGE_LIMIT(10)));
+
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(digit);
+        if (mask!=0xFFFFu) return i+__builtin_ctz(~mask);
+
+        i+=16;
+    }
+
+    return digits_scalar(s, i, len);
+}
+
+__attribute__((target("avx2")))
+static size_t wspace_avx2(const char* s, size_t i, size_t len, int* newlines){
+    const __m256i sp = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i nl = _mm256_set1_epi8('\n');
+
+    while (i+32<=len){
+        __m256i v = _mm256_loadu_si256((const __m256i*)(s+i));
+        __m256i is_nl = _mm256_cmpeq_epi8(v, nl);
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, tab)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), is_nl));
+
+        unsigned int ws_mask = (unsigned int)_mm256_movemask_epi8(ws);
+        unsigned int nl_mask = (unsigned int)_mm256_movemask_epi8(is_nl);
+
+        if (ws_mask!=0xFFFFFFFFu){
+            unsigned int stop = __builtin_ctz(~ws_mask);
+            *newlines+=__builtin_popcount(nl_mask & ((1u<<stop)-1));
+            return i+stop;
+        }
+
+        *newlines+=__builtin_popcount(nl_mask);
+        i+=32;
+    }
+
+    return wspace_sse2(s, i, len, newlines);
+}
+
+__attribute__((target("avx2")))
+static size_t ident_avx2(const char* s, size_t i, size_t len){
+    while (i+32<=len){
+        __m256i v = _mm256_loadu_si256((const __m256i*)(s+i));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i alpha = _mm256_cmpgt_epi8(_mm256_set1_epi8(RANGE_LIMIT(26)), _mm256_add_epi8(lower, _mm256_set1_epi8(RANGE_BIAS('a'))));
+        __m256i digit = _mm256_cmpgt_epi8(_mm256_set1_epi8(RANGE_LIMIT(10)), _mm256_add_epi8(v, _mm256_set1_epi8(RANGE_BIAS('0'))));
+        __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), under));
+        if (mask!=0xFFFFFFFFu) return i+__builtin_ctz(~mask);
+
+        i+=32;
+    }
+
+    return ident_sse2(s, i, len);
+}
+
+__attribute__((target("avx2")))
+static size_t digits_avx2(const char* s, size_t i, size_t len){
+    while (i+32<=len){
+        __m256i v = _mm256_loadu_si256((const __m256i*)(s+i));
+        __m256i digit = _mm256_cmpgt_epi8(_mm256_set1_epi8(RANGE_LIMIT(10)), _mm256_add_epi8(v, _mm256_set1_epi8(RANGE_BIAS('0'))));
+
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(digit);
+        if (mask!=0xFFFFFFFFu) return i+__builtin_ctz(~mask);
+
+        i+=32;
+    }
+
+    return digits_sse2(s, i, len);
+}
+
+#endif
+
+static WspaceFn wspace_fn = wspace_scalar;
+static RunFn ident_fn = ident_scalar;
+static RunFn digits_fn = digits_scalar;
+static const char* impl_name = "scalar";
+
+//PAVO_SCAN=scalar|sse2 caps the selection, mainly for testing the fallbacks
+void scan_init(){
+    static int done = 0;
+    if (done) return;
+    done=1;
+
+#ifdef SCAN_X86
+    const char* force = getenv("PAVO_SCAN");
+    if (force && strcmp(force, "scalar")==0) return;
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && !(force && strcmp(force, "sse2")==0)){
+        wspace_fn=wspace_avx2;
+        ident_fn=ident_avx2;
+        digits_fn=digits_avx2;
+        impl_name="avx2";
+    } else if (__builtin_cpu_supports("sse2")){
+        wspace_fn=wspace_sse2;
+        ident_fn=ident_sse2;
+        digits_fn=digits_sse2;
+        impl_name="sse2";
+    }
+#endif
+}
+
+const char* scan_impl_name(){
+    return impl_name;
+}
+
+size_t scan_wspace_bulk(const char* s, size_t i, size_t len, int* newlines){
+    return wspace_fn(s, i, len, newlines);
+}
+
+//glibc's memchr is already vectorized
+size_t scan_line_end(const char* s, size_t i, size_t len){
+    if (i>=len) return len;
+
+    const char* nl = (const char*)memchr(s+i, '\n', len-i);
+    return nl ? (size_t)(nl-s) : len;
+}
+
+size_t scan_ident_bulk(const char* s, size_t i, size_t len){
+    return ident_fn(s, i, len);
+}
+
+size_t scan_digits_bulk(const char* s, size_t i, size_t len){
+    return digits_fn(s, i, len);
+}
@@ -0,0 +1,57 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+//byte-run scanners used by the lexer, each returns the index of the first
+//byte at or after i (and before len) that is not part of the run.
+//the bulk implementation (AVX2, SSE2 or scalar) is picked once by scan_init()
+
+#define SCAN_SHORT 8 //bytes checked inline before calling the bulk scanner
+
+void scan_init();
+
+size_t scan_wspace_bulk(const char* s, size_t i, size_t len, int* newlines);
+size_t scan_ident_bulk(const char* s, size_t i, size_t len);
+size_t scan_digits_bulk(const char* s, size_t i, size_t len);
+size_t scan_line_end(const char* s, size_t i, size_t len);//stops at '\n'
+
+const char* scan_impl_name();
+
+static inline int scan_is_ident(unsigned char c){
+    return (unsigned char)((c|0x20)-'a')<26 || (unsigned char)(c-'0')<10 || c=='_';
+}
+
+//' ', '\t', '\r', '\n', newlines are added to *newlines
+static inline size_t scan_wspace(const char* s, size_t i, size_t len, int* newlines){
+    for (int k=0; k<SCAN_SHORT && i<len; k++, i++){
+        char c = s[i];
+        if (c=='\n'){
+            (*newlines)++;
+        } else if (c!=' ' && c!='\t' && c!='\r'){
+            return i;
+        }
+    }
+
+    return i<len ? scan_wspace_bulk(s, i, len, newlines) : i;
+}
+
+//[A-Za-z0-9_]
+static inline size_t scan_ident(const char* s, size_t i, size_t len){
+    for (int k=0; k<SCAN_SHORT && i<len; k++, i++){
+        if (!scan_is_ident((unsigned char)s[i])) return i;
+    }
+
+    return i<len ? scan_ident_bulk(s, i, len) : i;
+}
+
+//[0-9]
+static inline size_t scan_digits(const char* s, size_t i, size_t len){
+    for (int k=0; k<SCAN_SHORT && i<len; k++, i++){
+        if ((unsigned char)(s[i]-'0')>=10) return i;
+    }
+
+    return i<len ? scan_digits_bulk(s, i, len) : i;
+}
+
+#endif
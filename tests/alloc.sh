@@ -0,0 +1,31 @@
+#!/bin/sh
+# a loop's steady state allocates nothing: declaring variables in the body
+# reuses its frame, so a run makes as many heap allocations at 200000
+# iterations as at 100000, on every engine (both are past what --jit and
+# --threads wait for before they set up)
+here=$PWD
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+${CC:-cc} -O2 -shared -fPIC alloc_count.c -o "$dir/alloc_count.so" || exit 1
+sed 's/@N@/100000/' alloc_loop.pavo > "$dir/short.pavo"
+sed 's/@N@/200000/' alloc_loop.pavo > "$dir/long.pavo"
+cd "$dir" || exit 1 #relative names, pavo takes the first dot of a path as its extension
+
+#prints "<allocations> <output>" of one run, nothing if it failed
+count(){
+    out=$(LD_PRELOAD="$dir/alloc_count.so" "$PAVO" "$@" 2>err) || return
+    echo "$(sed -n 's/^alloc_count: //p' err) $(echo "$out" | head -n 1)"
+}
+
+status=0
+for flags in -O0 -O1 -O2 --engine=vm --jit --threads=4; do
+    short=$(count $flags short.pavo)
+    long=$(count $flags long.pavo)
+    if [ "${short% *}" != "${long% *}" ] || [ "${short#* }" != 5000049990.000000 ] || [ "${long#* }" != 20000099990.000000 ]; then
+        echo "alloc: $flags allocates per iteration (100000 iterations: $short, 200000: $long)"
+        status=1
+    fi
+done
+cd "$here"
+exit $status
@@ -0,0 +1,30 @@
+//LD_PRELOAD shim for alloc.sh: counts malloc, calloc and realloc calls and
+//reports the total on stderr when the program exits
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stddef.h>
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* p, size_t size);
+
+static long allocs;
+
+void* malloc(size_t size){
+    __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size){
+    __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size){
+    __atomic_fetch_add(&allocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(p, size);
+}
+
+__attribute__((destructor)) static void report(){
+    fprintf(stderr, "alloc_count: %ld\n", allocs);
+}
@@ -0,0 +1,53 @@
+#!/bin/sh
+# every program in conformance/ prints the same output and errors and exits
+# the same way wherever it runs: on the tree walker and the bytecode vm at
+# every -O, and through the -O2 rewrites (batched loops, --jit, --threads)
+# as on the unoptimized tree walker. where conformance/<name>.err exists,
+# it is what the program must print on stderr
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+cd conformance || exit 1
+
+#runs one program into $dir/<name>.{out,err,status}
+run(){
+    name=$1
+    shift
+    timeout 10 "$PAVO" "$@" >"$dir/$name.raw" 2>"$dir/$name.err"
+    echo $? >"$dir/$name.status"
+    grep -v 'execution time' "$dir/$name.raw" >"$dir/$name.out"
+}
+
+status=0
+
+#differ <file> <what> <expected run> <actual run>
+differ(){
+    for part in out err status; do
+        if ! cmp -s "$dir/$3.$part" "$dir/$4.$part"; then
+            echo "conformance: $1 $2: differ in $part"
+            diff "$dir/$3.$part" "$dir/$4.$part" | head -n 10
+            status=1
+        fi
+    done
+}
+
+for f in *.pavo; do
+    for O in -O0 -O1 -O2; do
+        run tree $O "$f"
+        run vm --engine=vm $O "$f"
+        differ "$f" "tree and vm at $O" tree vm
+    done
+
+    run base -O0 "$f"
+    if [ -f "${f%.pavo}.err" ] && ! cmp -s "${f%.pavo}.err" "$dir/base.err"; then
+        echo "conformance: $f: stderr is not ${f%.pavo}.err"
+        diff "${f%.pavo}.err" "$dir/base.err" | head -n 10
+        status=1
+    fi
+    run opt -O2 "$f"
+    differ "$f" "-O2 and -O0" base opt
+    run jit --jit -O2 "$f"
+    differ "$f" "--jit -O2 and -O0" base jit
+    run threads --threads=2 -O2 "$f"
+    differ "$f" "--threads=2 -O2 and -O0" base threads
+done
+exit $status
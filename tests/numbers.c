@@ -0,0 +1,124 @@
+//round trip of the lexer's number literals against strtod: every literal
+//must lex to one NUM_TOK whose value is bit for bit what strtod returns
+//  cc numbers.c ../lexer.c ../scan.c -pthread && ./a.out [count] [seed]
+#include "../lexer.h"
+#include <inttypes.h>
+
+static uint64_t rng_state;
+
+static uint64_t rng(){//xorshift64*
+    rng_state^=rng_state>>12;
+    rng_state^=rng_state<<25;
+    rng_state^=rng_state>>27;
+    return rng_state*0x2545F4914F6CDD1DULL;
+}
+
+static int below(int n){
+    return (int)(rng()%(uint64_t)n);
+}
+
+static int put_digits(char* out, int n){
+    for (int i=0; i<n; i++) out[i]=(char)('0'+below(10));
+    return n;
+}
+
+//literals around the edges of the fast paths, then random ones
+static const char* fixed[] = {
+    "0", "00", "0.0", "1", "9007199254740991", "9007199254740992",
+    "9007199254740993", "18014398509481985", "1e22", "1e23", "9e22",
+    "1.7976931348623157e308", "1.7976931348623159e308", "1e309",
+    "2.2250738585072014e-308", "4.9e-324", "2.4e-324", "1e-400",
+    "0.1", "0.2", "0.3", "123456789012345678901234567890",
+    "1234e25", "9007199254740991e15", "9007199254740991e16",
+    "0.000000000000000000000000000001", "10000000000000000000000",
+    "99999999999999999999e-20", "0x0", "0x1F", "0xFFFFFFFFFFFFFFFF",
+    "0x1FFFFFFFFFFFFF", "0x20000000000001", "0x10000000000000000",
+    "1e-22", "1e-23", "123.456e-22", "7e+22", "8.5E-3",
+};
+
+static void random_literal(char* out){
+    int n=0;
+
+    switch (below(6)){
+        case 0://short decimal, the common case
+            n+=put_digits(out+n, 1+below(6));
+            if (below(2)){
+                out[n++]='.';
+                n+=put_digits(out+n, 1+below(6));
+            }
+            break;
+        case 1://up to and past 2^53 and 19 digits
+            n+=put_digits(out+n, 1+below(25));
+            if (below(2)){
+                out[n++]='.';
+                n+=put_digits(out+n, 1+below(25));
+            }
+            break;
+        case 2://leading zeros
+            for (int z=below(20); z>0; z--) out[n++]='0';
+            n+=put_digits(out+n, 1+below(20));
+            if (below(2)){
+                out[n++]='.';
+                for (int z=below(20); z>0; z--) out[n++]='0';
+                n+=put_digits(out+n, 1+below(20));
+            }
+            break;
+        case 3://hex
+            out[n++]='0';
+            out[n++]=below(2) ? 'x' : 'X';
+            for (int d=1+below(20); d>0; d--) out[n++]="0123456789abcdefABCDEF"[below(22)];
+            break;
+        default://exponents, around the exact powers and the double range
+            n+=put_digits(out+n, 1+below(20));
+            if (below(2)){
+                out[n++]='.';
+                n+=put_digits(out+n, 1+below(20));
+            }
+            out[n++]=below(2) ? 'e' : 'E';
+            switch (below(3)){
+                case 0: break;
+                case 1: out[n++]='+'; break;
+                default: out[n++]='-'; break;
+            }
+            n+=sprintf(out+n, "%d", below(3) ? below(45) : below(400));
+            break;
+    }
+
+    out[n]='\0';
+}
+
+static int check(const char* lit){
+    Lexer l = init_lexer(lit);
+    Token tok = scan_tok(&l);
+    double want = strtod(lit, NULL);
+
+    if (tok.type!=NUM_TOK || l.curr!=strlen(lit)){
+        fprintf(stderr, "numbers: '%s' did not lex as one number\n", lit);
+        return 1;
+    }
+    if (memcmp(&tok.val.num, &want, sizeof(double))!=0){
+        fprintf(stderr, "numbers: '%s' lexed as %.17g, strtod gives %.17g\n", lit, tok.val.num, want);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv){
+    long count = argc>1 ? atol(argv[1]) : 1000000;
+    rng_state = argc>2 ? strtoull(argv[2], NULL, 10) : 0x9E3779B97F4A7C15ULL;
+    if (!rng_state) rng_state=1;
+
+    int failed=0;
+    for (size_t i=0; i<sizeof(fixed)/sizeof(fixed[0]); i++){
+        failed+=check(fixed[i]);
+    }
+
+    char lit[128];
+    for (long i=0; i<count && failed<20; i++){
+        random_literal(lit);
+        failed+=check(lit);
+    }
+
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,7 @@
+#!/bin/sh
+# the lexer's number literals round to the same double as strtod
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+
+${CC:-cc} -O2 numbers.c ../lexer.c ../scan.c -o "$dir/numbers" -pthread || exit 1
+"$dir/numbers" 1000000
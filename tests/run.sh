@@ -0,0 +1,24 @@
+#!/bin/sh
+# runs every tests/*.sh against one interpreter build
+#   tests/run.sh [path/to/pavo]    (default: builds tests/pavo)
+cd "$(dirname "$0")" || exit 1
+
+PAVO=${1:-}
+if [ -z "$PAVO" ]; then
+    PAVO=$PWD/pavo
+    (cd .. && ${CC:-cc} -O2 ast.c main.c parser.c lexer.c scan.c arena.c watch.c resolve.c typecheck.c optimize.c vm.c jit.c emit.c batch.c par.c -o "$PAVO" -lm -pthread) || exit 1
+fi
+case $PAVO in /*) ;; *) PAVO=$OLDPWD/$PAVO ;; esac
+export PAVO
+
+failed=0
+for t in *.sh; do
+    [ "$t" = run.sh ] && continue
+    if sh "./$t"; then
+        echo "ok   $t"
+    else
+        echo "FAIL $t"
+        failed=1
+    fi
+done
+exit $failed
@@ -0,0 +1,38 @@
+#!/bin/sh
+# parser stress: a 1M-term expression and 100000 nested parentheses parse
+# on the explicit operator stacks and evaluate right on every engine
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+cd "$dir" || exit 1 #relative names, pavo takes the first dot of a path as its extension
+
+#1M terms chained left to right
+awk 'BEGIN{printf "println 1"; for(i=1;i<1000000;i++) printf "+1"; print ";"}' > sum.pavo
+echo 1000000.000000 > sum.expected
+
+#1M terms across three precedence levels
+awk 'BEGIN{printf "let x := 3;\nprintln 0"; for(i=0;i<333333;i++) printf "+x*2-5"; print ";"}' > mixed.pavo
+echo 333333.000000 > mixed.expected
+
+#100000 parentheses around one number
+awk 'BEGIN{n=100000; printf "println "; for(i=0;i<n;i++) printf "("; printf "1"; for(i=0;i<n;i++) printf ")"; print ";"}' > parens.pavo
+echo 1.000000 > parens.expected
+
+#100000 parentheses, each holding an operator, nested to the right
+awk 'BEGIN{n=100000; printf "println "; for(i=0;i<n;i++) printf "(1+"; printf "0"; for(i=0;i<n;i++) printf ")"; print ";"}' > nested.pavo
+echo 100000.000000 > nested.expected
+
+#a missing ')' 100000 levels down is an error, not a crash
+awk 'BEGIN{n=100000; printf "println "; for(i=0;i<n;i++) printf "(1+"; printf "0"; for(i=1;i<n;i++) printf ")"; print ";"}' > unclosed.pavo
+echo "parser error: expected ')' after expression at line 1" > unclosed.expected
+
+status=0
+for f in *.pavo; do
+    for flags in -O0 -O2 --engine=vm --stream; do
+        timeout 60 "$PAVO" $flags "$f" 2>&1 | grep -v 'execution time' | head -n 1 > out
+        if ! cmp -s out "${f%.pavo}.expected"; then
+            echo "stress: $f $flags printed '$(cat out)', expected '$(cat "${f%.pavo}.expected")'"
+            status=1
+        fi
+    done
+done
+exit $status
@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "typecheck.h"
+#include "ast.h"
+#include "par.h"
+
+typedef struct {
+    ScopeData** scopes;//enclosing scopes by nesting level
+    uint32_t scope_capacity;
+    NodeId* stack;//expressions still to visit
+    uint8_t* wants;//TY_NUM or TY_BOOL, how each of them gets evaluated
+    size_t stack_count;
+    size_t stack_capacity;
+    int specialize;//0 only reports errors, the tree stays as it is
+    int errors;
+} Checker;
+
+static void type_error(Checker* c, const char* msg, ASTNode* n){
+    fprintf(stderr, "type error: %s '%s'\n", msg, sym_name(n->sym));
+    c->errors++;
+}
+
+static void push_expr(Checker* c, NodeId n, uint8_t want){
+    if (c->stack_count==c->stack_capacity){
+        c->stack_capacity = c->stack_capacity ? c->stack_capacity*2 : 64;
+        c->stack=(NodeId*)realloc(c->stack, sizeof(NodeId)*c->stack_capacity);
+        c->wants=(uint8_t*)realloc(c->wants, c->stack_capacity);
+        if (!c->stack || !c->wants){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    c->stack[c->stack_count]=n;
+    c->wants[c->stack_count++]=want;
+}
+
+//the types declared into each slot, nested scopes only below statement first
+static void slot_types(ScopeData* scope, int first){
+    for (uint32_t i=0; i<scope->slot_count; i++){
+        scope->slot_info[i].type=0;
+    }
+
+    for (int i=0; i<scope->stmt_count; i++){
+        ASTNode* n = ast_node(scope->statements[i]);
+        if (!n) continue;
+
+        if (n->type==NUM_DEC) scope->slot_info[n->val.var.slot].type|=TY_NUM;
+        if (n->type==BOOL_DEC) scope->slot_info[n->val.var.slot].type|=TY_BOOL;
+        if (i<first) continue;
+
+        ASTNode* body = NULL;
+        switch (n->type){
+            case IF:
+            case IF_NUM:
+            case IF_BOOL:
+            case LOOP: body=ast_node(n->right); break;
+            case SCOPE:
+            case BLOCK: body=n; break;
+            default: break;
+        }
+
+        if (body && (body->type==SCOPE || body->type==BLOCK)) slot_types(body->val.scope, 0);
+    }
+}
+
+//everything a resolved name can read: its slot, and the outer slots it
+//falls back to while that one is not declared yet. 0 if unresolved
+static uint8_t ref_type(Checker* c, ASTNode* n, uint32_t level){
+    if (n->val.var.depth==VAR_UNRESOLVED) return 0;
+
+    uint32_t l = level-n->val.var.depth;
+    uint32_t slot = n->val.var.slot;
+    uint8_t type = 0;
+
+    while (1){
+        SlotInfo* info = &c->scopes[l]->slot_info[slot];
+        type|=info->type;
+        if (!info->outer_depth) return type;
+
+        l-=info->outer_depth;
+        slot=info->outer_slot;
+    }
+}
+
+//what printing or branching on n works with, 0 if only known at runtime
+static uint8_t operand_type(Checker* c, ASTNode* n, uint32_t level){
+    switch (n->type){
+        case NUM_VAL:
+        case B_OP:
+        case N_OP:
+        case HOIST:
+        case INDUCTION: return TY_NUM;
+        case BOOL_VAL:
+        case COND: return TY_BOOL;
+        case VAR_REF:
+        case NUM_REF:
+        case BOOL_REF: {
+            uint8_t t = ref_type(c, n, level);
+            return t==TY_ANY ? 0 : t;
+        }
+        default: return 0;
+    }
+}
+
+//an expression evaluated as want. explicit stack, expressions can be deeper
+//than the C stack
+static void check_expr(Checker* c, NodeId id, uint8_t want, uint32_t level){
+    if (!id) return;
+
+    size_t base = c->stack_count;
+    push_expr(c, id, want);
+
+    while (c->stack_count>base){
+        c->stack_count--;
+        ASTNode* n = ast_node(c->stack[c->stack_count]);
+        uint8_t w = c->wants[c->stack_count];
+
+        switch (n->type){
+            case NUM_VAL: n->vtype=TY_NUM; break;
+            case BOOL_VAL: n->vtype=TY_BOOL; break;
+            case B_OP://right first, so left pops first and errors come out in source order
+                n->vtype=TY_NUM;
+                push_expr(c, n->right, TY_NUM);
+                push_expr(c, n->left, TY_NUM);
+                break;
+            case N_OP:
+                n->vtype=TY_NUM;
+                if (n->op==POW){//its args are stored right to left
+                    for (uint32_t i=0; i<n->val.nary->count; i++){
+                        push_expr(c, n->val.nary->args[i], TY_NUM);
+                    }
+                } else {
+                    for (uint32_t i=n->val.nary->count; i>0; i--){
+                        push_expr(c, n->val.nary->args[i-1], TY_NUM);
+                    }
+                }
+                break;
+            case COND:
+                n->vtype=TY_BOOL;
+                if (w==TY_NUM) break;//a number never evaluates a comparison, it reads as 0
+                push_expr(c, n->right, TY_NUM);
+                push_expr(c, n->left, TY_NUM);
+                break;
+            case HOIST:
+                n->vtype=TY_NUM;
+                push_expr(c, n->left, TY_NUM);
+                break;
+            case INDUCTION: n->vtype=TY_NUM; break;
+            case VAR_REF:
+            case NUM_REF:
+            case BOOL_REF: {
+                uint8_t t = ref_type(c, n, level);
+                if (t==TY_BOOL && w!=TY_BOOL) type_error(c, "expected numeric variable", n);
+                if (!c->specialize) break;
+
+                n->vtype=t;
+                n->type = t==TY_NUM ? NUM_REF : t==TY_BOOL && w==TY_BOOL ? BOOL_REF : VAR_REF;
+            } break;
+            default: break;
+        }
+    }
+}
+
+//`parallel for` whose iterations could see each other's writes
+static void check_parallel(Checker* c, ASTNode* loop){
+    SymId sym;
+    switch (par_conflict(loop, &sym)){
+        case PAR_WRITES_OUTER:
+            fprintf(stderr, "type error: parallel loop writes outer variable '%s'\n", sym_name(sym));
+            break;
+        case PAR_READS_EARLIER:
+            fprintf(stderr, "type error: parallel loop reads '%s' before declaring it\n", sym_name(sym));
+            break;
+        case PAR_WRITES_ITERATOR:
+            fprintf(stderr, "type error: parallel loop assigns its iterator '%s'\n", sym_name(sym));
+            break;
+        case PAR_STATEFUL:
+            fprintf(stderr, "type error: parallel loop keeps values across iterations\n");
+            break;
+        default: return;
+    }
+    c->errors++;
+}
+
+static void check_scope(Checker* c, ScopeData* scope, uint32_t level, int first);
+
+static void check_stmt(Checker* c, NodeId id, uint32_t level){
+    ASTNode* n = ast_node(id);
+    if (!n) return;
+
+    switch (n->type){
+        case NUM_DEC:
+            check_expr(c, n->left, TY_NUM, level);
+            break;
+        case BOOL_DEC:
+            check_expr(c, n->left, TY_BOOL, level);
+            break;
+        case NUM_REASSIGN:
+        case NUM_SET: {
+            check_expr(c, n->left, TY_NUM, level);
+
+            uint8_t t = ref_type(c, n, level);
+            if (t==TY_BOOL) type_error(c, "cannot assign numeric value to non-numeric variable", n);
+            if (c->specialize) n->type = t==TY_NUM ? NUM_SET : NUM_REASSIGN;
+        } break;
+        case BOOL_REASSIGN:
+        case BOOL_SET: {
+            check_expr(c, n->left, TY_BOOL, level);
+
+            uint8_t t = ref_type(c, n, level);
+            if (t==TY_NUM) type_error(c, "cannot assign boolean value to non-boolean variable", n);
+            if (c->specialize) n->type = t==TY_BOOL ? BOOL_SET : BOOL_REASSIGN;
+        } break;
+        case MACRO:
+        case PRINT_NUM:
+        case PRINT_BOOL: {
+            uint8_t t = operand_type(c, ast_node(n->left), level);
+            if (c->specialize) n->type = t==TY_NUM ? PRINT_NUM : t==TY_BOOL ? PRINT_BOOL : MACRO;
+            check_expr(c, n->left, t ? t : TY_BOOL, level);//the generic macro prints either
+        } break;
+        case IF:
+        case IF_NUM:
+        case IF_BOOL: {
+            uint8_t t = operand_type(c, ast_node(n->left), level);
+            if (c->specialize) n->type = t==TY_NUM ? IF_NUM : t==TY_BOOL ? IF_BOOL : IF;
+            check_expr(c, n->left, t ? t : TY_BOOL, level);
+            check_stmt(c, n->right, level);
+        } break;
+        case LOOP:
+            check_stmt(c, n->right, level);
+            if (n->op&LOOP_PARALLEL) check_parallel(c, n);
+            break;
+        case SCOPE:
+        case BLOCK:
+            check_scope(c, n->val.scope, level+1, 0);
+            break;
+        default: break;//expression statements are never evaluated
+    }
+}
+
+static void check_scope(Checker* c, ScopeData* scope, uint32_t level, int first){
+    if (level>=c->scope_capacity){
+        c->scope_capacity = c->scope_capacity ? c->scope_capacity*2 : 16;
+        c->scopes=(ScopeData**)realloc(c->scopes, sizeof(ScopeData*)*c->scope_capacity);
+        if (!c->scopes){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    c->scopes[level]=scope;
+
+    for (int i=first; i<scope->stmt_count; i++){
+        check_stmt(c, scope->statements[i], level);
+    }
+}
+
+static int typecheck_run(ASTNode* program, int first, int specialize){
+    if (!program) return 0;
+    ScopeData* root = program->val.scope;
+
+    //older statements only need another look if a top-level name changed type
+    uint8_t* before=(uint8_t*)malloc(root->slot_count+1);
+    if (!before){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i=0; i<root->slot_count; i++) before[i]=root->slot_info[i].type;
+
+    slot_types(root, first);
+
+    for (uint32_t i=0; i<root->slot_count; i++){
+        if (before[i]!=root->slot_info[i].type) first=0;
+    }
+
+    Checker c;
+    memset(&c, 0, sizeof(c));
+    c.specialize=specialize;
+    check_scope(&c, root, 0, first);
+
+    //the specializing run after optimize() has to see the same change
+    if (!specialize){
+        for (uint32_t i=0; i<root->slot_count; i++) root->slot_info[i].type=before[i];
+    }
+
+    free(before);
+    free(c.scopes);
+    free(c.stack);
+    free(c.wants);
+
+    return c.errors;
+}
+
+int typecheck_program(ASTNode* program){
+    return typecheck_run(program, 0, 1);
+}
+
+int typecheck_from(ASTNode* program, int first){
+    return typecheck_run(program, first, 1);
+}
+
+int typecheck_unoptimized(ASTNode* program, int first){
+    return typecheck_run(program, first, 0);
+}
@@ -0,0 +1,19 @@
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+
+#include "ast.h"
+
+//static types, run after resolve(): every slot gets the types declared into
+//it and every expression node its TY_*, errors that would stop execution
+//whenever the statement runs are reported up front, and statements whose
+//operand types are known become PRINT_NUM, IF_BOOL, NUM_SET etc. with
+//references turned into NUM_REF / BOOL_REF, so they run without type checks.
+//names declared as both num and bool keep the checked generic nodes
+
+int typecheck_program(ASTNode* program);//number of errors, reported on stderr
+int typecheck_from(ASTNode* program, int first);//after top-level statements from first on changed
+//the same errors, reported on the tree before optimize() drops any code, with
+//nothing specialized. resolve() and typecheck() run again on what it leaves
+int typecheck_unoptimized(ASTNode* program, int first);
+
+#endif
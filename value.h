@@ -0,0 +1,47 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <stdint.h>
+#include <string.h>
+
+//a runtime value in 64 bits: a double as itself, anything else in the
+//payload of a quiet NaN no arithmetic produces. NaNs from arithmetic are the
+//hardware default (0x7ff8... or 0xfff8...), which never have all of
+//VAL_QNAN's bits set, so they stay numbers
+
+typedef uint64_t Value;
+
+#define VAL_QNAN 0x7ffc000000000000ull
+#define VAL_UNDEF (VAL_QNAN|1)//a slot whose declaration has not run yet
+#define VAL_FALSE (VAL_QNAN|2)
+#define VAL_TRUE (VAL_QNAN|3)
+
+static inline Value num_value(double x){
+    Value v;
+    memcpy(&v, &x, sizeof(v));
+    return v;
+}
+
+static inline double value_num(Value v){
+    double x;
+    memcpy(&x, &v, sizeof(x));
+    return x;
+}
+
+static inline Value bool_value(int b){
+    return b ? VAL_TRUE : VAL_FALSE;
+}
+
+static inline int value_bool(Value v){
+    return v==VAL_TRUE;
+}
+
+static inline int value_is_num(Value v){
+    return (v&VAL_QNAN)!=VAL_QNAN;
+}
+
+static inline int value_is_bool(Value v){
+    return (v|1)==VAL_TRUE;
+}
+
+#endif
@@ -0,0 +1,793 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "vm.h"
+#include "ast.h"
+
+//name, operands. r is a run in refs, k a constant, h a hoist, d an
+//induction, t a jump target, s a symbol (for messages), ln print or println
+#define VM_OPS(X) \
+    X(CONST)            /* k         push consts[k] */ \
+    X(LOAD_NUM)         /* r s       NUM_REF */ \
+    X(LOAD_VAR_NUM)     /* r s       VAR_REF that has to be a num */ \
+    X(LOAD_BOOL)        /* r s       BOOL_REF as a bool */ \
+    X(LOAD_NUM_TRUTH)   /* r s       NUM_REF as a bool */ \
+    X(LOAD_VAR_BOOL)    /* r s       VAR_REF as a bool */ \
+    X(ADD) X(SUB) X(MUL) X(DIV) X(POW) \
+    X(RPOW)             /*           a b -> pow(b, a), N_OP args run right to left */ \
+    X(EQ) X(LT) X(GT) \
+    X(TRUTHY)           /*           x -> x!=0 */ \
+    X(HOIST)            /* h t       push the cached value and jump to t if there is one */ \
+    X(HOIST_SET)        /* h         cache the top */ \
+    X(HOIST_RESET)      /* h */ \
+    X(IND)              /* d         push the induction's value */ \
+    X(IND_INIT)         /* d */ \
+    X(IND_STEP)         /* d */ \
+    X(DECLARE)          /* r */ \
+    X(REASSIGN_NUM)     /* r s */ \
+    X(REASSIGN_BOOL)    /* r s */ \
+    X(SET_NUM)          /* r s */ \
+    X(SET_BOOL)         /* r s */ \
+    X(PRINT_NUM)        /* ln */ \
+    X(PRINT_BOOL)       /* ln */ \
+    X(PRINT_REF_NUM)    /* r ln      nothing if it does not exist */ \
+    X(PRINT_REF_BOOL)   /* r ln */ \
+    X(PRINT_VAR)        /* r ln      generic macro on a VAR_REF */ \
+    X(IF_VAR)           /* r s       generic if on a VAR_REF, pushes the condition */ \
+    X(IF_REF)           /* r s       IF_NUM / IF_BOOL on a reference */ \
+    X(JUMP_FALSE)       /* t */ \
+    X(JUMP)             /* t */ \
+    X(LOOP_TEST)        /* r k t     jump to t once the iterator reached consts[k] */ \
+    X(LOOP_NEXT)        /* r */ \
+    X(UNKNOWN)          /* type      a statement execute() does not run */ \
+    X(NULL_STMT) \
+    X(FAIL)             /* msg */ \
+    X(HALT)
+
+#define VM_ENUM(name) OP_##name,
+enum { VM_OPS(VM_ENUM) OP_COUNT };
+
+#define VM_FAIL_NON_BOOL 0
+#define VM_FAIL_IF_COND 1
+#define VM_FAIL_LOOP_SCOPE 2
+#define VM_FAIL_LOOP_ITER 3
+
+static const char* fail_msgs[] = {
+    "error: non-boolean expr\n",
+    "Error: Invalid condition type in if statement\n",
+    "loop must be a scope\n",
+    "first stmt in loop isnt num\n",
+};
+
+typedef struct {
+    VmProgram* vm;
+    ScopeData** scopes;//enclosing scopes by nesting level
+    uint32_t scope_capacity;
+    uint32_t depth;//value stack depth at this point of the code
+} Compiler;
+
+static void* grow(void* p, uint32_t* capacity, size_t count, size_t size){
+    if (count<*capacity) return p;
+
+    *capacity = *capacity ? *capacity*2 : 64;
+    p=realloc(p, size*(*capacity));
+    if (!p){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static size_t emit(Compiler* c, uint32_t word){
+    VmProgram* vm = c->vm;
+    if (vm->code_count==vm->code_capacity){
+        vm->code_capacity = vm->code_capacity ? vm->code_capacity*2 : 1024;
+        vm->code=(uint32_t*)realloc(vm->code, sizeof(uint32_t)*vm->code_capacity);
+        if (!vm->code){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    vm->code[vm->code_count]=word;
+    return vm->code_count++;
+}
+
+//net effect of an instruction on the value stack
+static void stack_effect(Compiler* c, int delta){
+    c->depth+=delta;
+    if (c->depth>c->vm->max_stack) c->vm->max_stack=c->depth;
+}
+
+static void enter_scope(Compiler* c, ScopeData* scope, uint32_t level){
+    c->scopes=(ScopeData**)grow(c->scopes, &c->scope_capacity, level, sizeof(ScopeData*));
+    c->scopes[level]=scope;
+}
+
+static uint32_t add_const(Compiler* c, Value x){
+    VmProgram* vm = c->vm;
+    vm->consts=(Value*)grow(vm->consts, &vm->const_capacity, vm->const_count, sizeof(Value));
+    vm->consts[vm->const_count]=x;
+    return vm->const_count++;
+}
+
+static void push_ref(Compiler* c, Slot* slot){
+    VmProgram* vm = c->vm;
+    vm->refs=(Slot**)grow(vm->refs, &vm->ref_capacity, vm->ref_count, sizeof(Slot*));
+    vm->refs[vm->ref_count++]=slot;
+}
+
+//the slots lookup_slot() would try for a resolved name, in order
+static uint32_t name_ref(Compiler* c, ASTNode* n, uint32_t level){
+    uint32_t r = c->vm->ref_count;
+
+    if (n->val.var.depth!=VAR_UNRESOLVED){
+        uint32_t l = level-n->val.var.depth;
+        uint32_t slot = n->val.var.slot;
+        while (1){
+            push_ref(c, &c->scopes[l]->frame[slot]);
+
+            SlotInfo* info = &c->scopes[l]->slot_info[slot];
+            if (!info->outer_depth) break;
+            l-=info->outer_depth;
+            slot=info->outer_slot;
+        }
+    }
+
+    push_ref(c, NULL);
+    return r;
+}
+
+static uint32_t slot_ref(Compiler* c, Slot* slot){
+    uint32_t r = c->vm->ref_count;
+    push_ref(c, slot);
+    push_ref(c, NULL);
+    return r;
+}
+
+static uint32_t hoist_index(Compiler* c, NodeId id){
+    VmProgram* vm = c->vm;
+    for (uint32_t h=0; h<vm->hoist_count; h++){
+        if (vm->hoists[h]==id) return h;
+    }
+
+    uint32_t capacity = vm->hoist_capacity;
+    vm->hoists=(NodeId*)grow(vm->hoists, &vm->hoist_capacity, vm->hoist_count, sizeof(NodeId));
+    if (capacity!=vm->hoist_capacity){
+        vm->hoist_val=(Value*)realloc(vm->hoist_val, sizeof(Value)*vm->hoist_capacity);
+        vm->hoist_valid=(uint8_t*)realloc(vm->hoist_valid, vm->hoist_capacity);
+        if (!vm->hoist_val || !vm->hoist_valid){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    vm->hoists[vm->hoist_count]=id;
+    vm->hoist_valid[vm->hoist_count]=0;
+    return vm->hoist_count++;
+}
+
+static uint32_t ind_index(Compiler* c, ASTNode* n){
+    VmProgram* vm = c->vm;
+    for (uint32_t d=0; d<vm->ind_count; d++){
+        if (vm->inds[d]==n->val.ind) return d;
+    }
+
+    vm->inds=(InductionData**)grow(vm->inds, &vm->ind_capacity, vm->ind_count, sizeof(InductionData*));
+    vm->inds[vm->ind_count]=n->val.ind;
+    return vm->ind_count++;
+}
+
+static void compile_bool(Compiler* c, NodeId id, uint32_t level);
+
+//same evaluation order and failures as num_evaluate_ast()
+static void compile_num(Compiler* c, NodeId id, uint32_t level){
+    ASTNode* n = ast_node(id);
+
+    switch (n->type){
+        case NUM_VAL:
+            emit(c, OP_CONST);
+            emit(c, add_const(c, num_value(n->val.num)));
+            stack_effect(c, 1);
+            break;
+        case B_OP: {
+            compile_num(c, n->left, level);
+            compile_num(c, n->right, level);
+
+            static const uint32_t ops[] = {OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW};
+            emit(c, ops[n->op]);
+            stack_effect(c, -1);
+        } break;
+        case N_OP: {
+            NaryData* nary = n->val.nary;
+            compile_num(c, nary->args[0], level);
+
+            static const uint32_t ops[] = {OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_RPOW};
+            for (uint32_t i=1; i<nary->count; i++){
+                compile_num(c, nary->args[i], level);
+                emit(c, ops[nary->ops[i]]);
+                stack_effect(c, -1);
+            }
+        } break;
+        case VAR_REF:
+        case NUM_REF:
+            emit(c, n->type==VAR_REF ? OP_LOAD_VAR_NUM : OP_LOAD_NUM);
+            emit(c, name_ref(c, n, level));
+            emit(c, n->sym);
+            stack_effect(c, 1);
+            break;
+        case HOIST: {
+            emit(c, OP_HOIST);
+            emit(c, hoist_index(c, id));
+            size_t skip = emit(c, 0);
+
+            compile_num(c, n->left, level);
+            emit(c, OP_HOIST_SET);
+            emit(c, hoist_index(c, id));
+            c->vm->code[skip]=c->vm->code_count;
+        } break;
+        case INDUCTION:
+            emit(c, OP_IND);
+            emit(c, ind_index(c, n));
+            stack_effect(c, 1);
+            break;
+        default://num_evaluate_ast() takes anything else as 0 without running it
+            emit(c, OP_CONST);
+            emit(c, add_const(c, num_value(0)));
+            stack_effect(c, 1);
+            break;
+    }
+}
+
+//bool_evaluate_ast()
+static void compile_bool(Compiler* c, NodeId id, uint32_t level){
+    ASTNode* n = ast_node(id);
+
+    switch (n->type){
+        case BOOL_VAL:
+            emit(c, OP_CONST);
+            emit(c, add_const(c, bool_value(n->val.bool_val)));
+            stack_effect(c, 1);
+            break;
+        case COND: {
+            compile_num(c, n->left, level);
+            compile_num(c, n->right, level);
+
+            static const uint32_t ops[] = {OP_EQ, OP_LT, OP_GT};
+            emit(c, ops[n->op]);
+            stack_effect(c, -1);
+        } break;
+        case BOOL_REF:
+        case NUM_REF:
+        case VAR_REF:
+            emit(c, n->type==BOOL_REF ? OP_LOAD_BOOL : n->type==NUM_REF ? OP_LOAD_NUM_TRUTH : OP_LOAD_VAR_BOOL);
+            emit(c, name_ref(c, n, level));
+            emit(c, n->sym);
+            stack_effect(c, 1);
+            break;
+        case NUM_VAL:
+        case B_OP:
+        case N_OP:
+        case HOIST:
+        case INDUCTION:
+            compile_num(c, id, level);
+            emit(c, OP_TRUTHY);
+            break;
+        default:
+            emit(c, OP_FAIL);
+            emit(c, VM_FAIL_NON_BOOL);
+            stack_effect(c, 1);
+            break;
+    }
+}
+
+static void compile_scope(Compiler* c, ScopeData* scope, uint32_t level, int first);
+
+static void compile_print(Compiler* c, ASTNode* n, uint32_t level){
+    ASTNode* val = ast_node(n->left);
+    uint32_t ln = n->op==PRINTLN;
+
+    if (n->type==PRINT_NUM || n->type==PRINT_BOOL){
+        uint32_t ref_kind = n->type==PRINT_NUM ? NUM_REF : BOOL_REF;
+        if (val->type==ref_kind){
+            emit(c, n->type==PRINT_NUM ? OP_PRINT_REF_NUM : OP_PRINT_REF_BOOL);
+            emit(c, name_ref(c, val, level));
+            emit(c, ln);
+            return;
+        }
+
+        if (n->type==PRINT_NUM) compile_num(c, n->left, level);
+        else compile_bool(c, n->left, level);
+        emit(c, n->type==PRINT_NUM ? OP_PRINT_NUM : OP_PRINT_BOOL);
+        emit(c, ln);
+        stack_effect(c, -1);
+        return;
+    }
+
+    //execute_macro()
+    if (val->type==VAR_REF){
+        emit(c, OP_PRINT_VAR);
+        emit(c, name_ref(c, val, level));
+        emit(c, ln);
+    } else if (val->type==NUM_VAL || val->type==NUM_REF || val->type==B_OP || val->type==N_OP){
+        compile_num(c, n->left, level);
+        emit(c, OP_PRINT_NUM);
+        emit(c, ln);
+        stack_effect(c, -1);
+    } else if (val->type==BOOL_VAL || val->type==BOOL_REF || val->type==COND){
+        compile_bool(c, n->left, level);
+        emit(c, OP_PRINT_BOOL);
+        emit(c, ln);
+        stack_effect(c, -1);
+    }
+}
+
+//pushes the condition of an IF, IF_NUM or IF_BOOL as 0 or 1
+static void compile_condition(Compiler* c, ASTNode* n, uint32_t level){
+    ASTNode* cond = ast_node(n->left);
+
+    if (n->type!=IF){//execute_if_typed()
+        if (cond->type==NUM_REF || cond->type==BOOL_REF){
+            emit(c, OP_IF_REF);
+            emit(c, name_ref(c, cond, level));
+            emit(c, cond->sym);
+            stack_effect(c, 1);
+        } else if (n->type==IF_NUM){
+            compile_num(c, n->left, level);
+            emit(c, OP_TRUTHY);
+        } else {
+            compile_bool(c, n->left, level);
+        }
+        return;
+    }
+
+    //execute_if()
+    switch (cond->type){
+        case VAR_REF:
+            emit(c, OP_IF_VAR);
+            emit(c, name_ref(c, cond, level));
+            emit(c, cond->sym);
+            stack_effect(c, 1);
+            break;
+        case COND:
+        case BOOL_REF:
+        case BOOL_VAL:
+            compile_bool(c, n->left, level);
+            break;
+        case NUM_REF:
+        case NUM_VAL:
+        case B_OP:
+        case N_OP:
+            compile_num(c, n->left, level);
+            emit(c, OP_TRUTHY);
+            break;
+        default:
+            emit(c, OP_FAIL);
+            emit(c, VM_FAIL_IF_COND);
+            stack_effect(c, 1);
+            break;
+    }
+}
+
+static void compile_loop(Compiler* c, ASTNode* n, uint32_t level){
+    ASTNode* scope_node = ast_node(n->right);
+    if (scope_node->type!=SCOPE && scope_node->type!=BLOCK){
+        emit(c, OP_FAIL);
+        emit(c, VM_FAIL_LOOP_SCOPE);
+        return;
+    }
+
+    ScopeData* body = scope_node->val.scope;
+    ASTNode* iter_dec = ast_node(body->statements[0]);
+    if (iter_dec->type!=NUM_DEC){
+        emit(c, OP_FAIL);
+        emit(c, VM_FAIL_LOOP_ITER);
+        return;
+    }
+
+    enter_scope(c, body, level+1);
+
+    uint32_t iter = slot_ref(c, &body->frame[iter_dec->val.var.slot]);
+    compile_num(c, iter_dec->left, level+1);
+    emit(c, OP_DECLARE);
+    emit(c, iter);
+    stack_effect(c, -1);
+
+    for (NodeId h=n->left; h; h=ast_node(h)->right){
+        ASTNode* m = ast_node(h);
+        if (m->type==HOIST){
+            emit(c, OP_HOIST_RESET);
+            emit(c, hoist_index(c, h));
+        } else {
+            emit(c, OP_IND_INIT);
+            emit(c, ind_index(c, m));
+        }
+    }
+
+    size_t top = emit(c, OP_LOOP_TEST);
+    emit(c, iter);
+    emit(c, add_const(c, num_value(n->val.num)));
+    size_t exit_target = emit(c, 0);
+
+    compile_scope(c, body, level+1, 1);
+
+    emit(c, OP_LOOP_NEXT);
+    emit(c, iter);
+    for (NodeId h=n->left; h && ast_node(h)->type==INDUCTION; h=ast_node(h)->right){
+        emit(c, OP_IND_STEP);
+        emit(c, ind_index(c, ast_node(h)));
+    }
+    emit(c, OP_JUMP);
+    emit(c, top);
+
+    c->vm->code[exit_target]=c->vm->code_count;
+}
+
+//execute()
+static void compile_stmt(Compiler* c, NodeId id, uint32_t level){
+    ASTNode* n = ast_node(id);
+    if (!n){
+        emit(c, OP_NULL_STMT);
+        return;
+    }
+
+    switch (n->type){
+        case NUM_DEC:
+        case BOOL_DEC:
+            if (n->type==NUM_DEC) compile_num(c, n->left, level);
+            else compile_bool(c, n->left, level);
+            emit(c, OP_DECLARE);
+            emit(c, slot_ref(c, &c->scopes[level]->frame[n->val.var.slot]));
+            stack_effect(c, -1);
+            break;
+        case NUM_REASSIGN:
+        case NUM_SET:
+        case BOOL_REASSIGN:
+        case BOOL_SET: {
+            int num = n->type==NUM_REASSIGN || n->type==NUM_SET;
+            if (num) compile_num(c, n->left, level);
+            else compile_bool(c, n->left, level);
+
+            uint32_t op = n->type==NUM_REASSIGN ? OP_REASSIGN_NUM : n->type==NUM_SET ? OP_SET_NUM :
+                          n->type==BOOL_REASSIGN ? OP_REASSIGN_BOOL : OP_SET_BOOL;
+            emit(c, op);
+            emit(c, name_ref(c, n, level));
+            emit(c, n->sym);
+            stack_effect(c, -1);
+        } break;
+        case MACRO:
+        case PRINT_NUM:
+        case PRINT_BOOL:
+            compile_print(c, n, level);
+            break;
+        case IF:
+        case IF_NUM:
+        case IF_BOOL: {
+            compile_condition(c, n, level);
+            emit(c, OP_JUMP_FALSE);
+            size_t skip = emit(c, 0);
+            stack_effect(c, -1);
+
+            compile_stmt(c, n->right, level);
+            c->vm->code[skip]=c->vm->code_count;
+        } break;
+        case SCOPE:
+        case BLOCK:
+            compile_scope(c, n->val.scope, level+1, 0);
+            break;
+        case LOOP:
+            compile_loop(c, n, level);
+            break;
+        default:
+            emit(c, OP_UNKNOWN);
+            emit(c, n->type);
+            break;
+    }
+}
+
+static void compile_scope(Compiler* c, ScopeData* scope, uint32_t level, int first){
+    enter_scope(c, scope, level);
+
+    for (int i=first; i<scope->stmt_count; i++){
+        compile_stmt(c, scope->statements[i], level);
+    }
+}
+
+VmProgram* vm_compile(ASTNode* program){
+    VmProgram* vm = (VmProgram*)calloc(1, sizeof(VmProgram));
+    if (!vm){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    Compiler c;
+    c.vm=vm;
+    c.scopes=NULL;
+    c.scope_capacity=0;
+    c.depth=0;
+
+    compile_scope(&c, program->val.scope, 0, 0);
+    emit(&c, OP_HALT);
+
+    free(c.scopes);
+    return vm;
+}
+
+static inline Slot* vm_lookup(Slot** run){
+    for (; *run; run++){
+        if ((*run)->v!=VAL_UNDEF) return *run;
+    }
+    return NULL;
+}
+
+static void vm_error(const char* fmt, uint32_t sym){
+    fprintf(stderr, fmt, sym_name(sym));
+    exit(EXIT_FAILURE);
+}
+
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO
+#endif
+
+void vm_run(VmProgram* vm){
+    const uint32_t* code = vm->code;
+    const uint32_t* pc = code;
+    const Value* consts = vm->consts;
+    Slot** refs = vm->refs;
+
+    Value* stack = (Value*)malloc(sizeof(Value)*(vm->max_stack+1));
+    if (!stack){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    Value* sp = stack;//next free
+
+#ifdef VM_COMPUTED_GOTO
+    #define VM_LABEL(name) &&op_##name,
+    static const void* labels[] = { VM_OPS(VM_LABEL) };
+    #define DISPATCH() goto *labels[*pc++]
+    #define CASE(name) op_##name:
+    DISPATCH();
+#else
+    #define DISPATCH() break
+    #define CASE(name) case OP_##name:
+    while (1) switch (*pc++){
+#endif
+
+    CASE(CONST){
+        *sp++=consts[*pc++];
+        DISPATCH();
+    }
+    CASE(LOAD_NUM){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (!var) vm_error("error: expecred numeric variable '%s'\n", pc[1]);
+        *sp++=var->v;
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(LOAD_VAR_NUM){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (!var || !value_is_num(var->v)) vm_error("error: expecred numeric variable '%s'\n", pc[1]);
+        *sp++=var->v;
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(LOAD_BOOL){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (!var) vm_error("error: expected boolean variable '%s'\n", pc[1]);
+        *sp++=var->v;
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(LOAD_NUM_TRUTH){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (!var) vm_error("error: expected boolean variable '%s'\n", pc[1]);
+        *sp++=bool_value(value_num(var->v)!=0);
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(LOAD_VAR_BOOL){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (var && value_is_bool(var->v)) *sp++=var->v;
+        else if (var && value_is_num(var->v)) *sp++=bool_value(value_num(var->v)!=0);
+        else vm_error("error: expected boolean variable '%s'\n", pc[1]);
+        pc+=2;
+        DISPATCH();
+    }
+    #define BINARY(expr) do { sp--; double a = value_num(sp[-1]), b = value_num(sp[0]); sp[-1]=(expr); } while (0)
+    CASE(ADD){ BINARY(num_value(a+b)); DISPATCH(); }
+    CASE(SUB){ BINARY(num_value(a-b)); DISPATCH(); }
+    CASE(MUL){ BINARY(num_value(a*b)); DISPATCH(); }
+    CASE(DIV){
+        if (value_num(sp[-1])==0){
+            fprintf(stderr, "error: division with 0!\n");
+            exit(EXIT_FAILURE);
+        }
+        BINARY(num_value(a/b));
+        DISPATCH();
+    }
+    CASE(POW){ BINARY(num_value(pow(a, b))); DISPATCH(); }
+    CASE(RPOW){ BINARY(num_value(pow(b, a))); DISPATCH(); }
+    CASE(EQ){ BINARY(bool_value(a==b)); DISPATCH(); }
+    CASE(LT){ BINARY(bool_value(a<b)); DISPATCH(); }
+    CASE(GT){ BINARY(bool_value(a>b)); DISPATCH(); }
+    CASE(TRUTHY){ sp[-1]=bool_value(value_num(sp[-1])!=0); DISPATCH(); }
+    CASE(HOIST){
+        if (vm->hoist_valid[pc[0]]){
+            *sp++=vm->hoist_val[pc[0]];
+            pc=code+pc[1];
+        } else {
+            pc+=2;
+        }
+        DISPATCH();
+    }
+    CASE(HOIST_SET){
+        vm->hoist_val[*pc]=sp[-1];
+        vm->hoist_valid[*pc]=1;
+        pc++;
+        DISPATCH();
+    }
+    CASE(HOIST_RESET){
+        vm->hoist_valid[*pc++]=0;
+        DISPATCH();
+    }
+    CASE(IND){
+        *sp++=num_value(vm->inds[*pc++]->v[0]);
+        DISPATCH();
+    }
+    CASE(IND_INIT){
+        InductionData* ind = vm->inds[*pc++];
+        memcpy(ind->v, ind->init, sizeof(ind->v));
+        DISPATCH();
+    }
+    CASE(IND_STEP){
+        InductionData* ind = vm->inds[*pc++];
+        for (uint32_t k=0; k<ind->degree; k++) ind->v[k]+=ind->v[k+1];
+        DISPATCH();
+    }
+    CASE(DECLARE){
+        refs[*pc++]->v=*--sp;
+        DISPATCH();
+    }
+    CASE(REASSIGN_NUM){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (!var) vm_error("error: varible '%s' not found\n", pc[1]);
+        if (!value_is_num(var->v)) vm_error("error: cannot assign numeric value to non-numeric variable '%s'\n", pc[1]);
+        var->v=*--sp;
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(REASSIGN_BOOL){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (!var) vm_error("error: variable '%s' not found for reassignment\n", pc[1]);
+        if (!value_is_bool(var->v)) vm_error("error: cannot assign boolean value to non-boolean variable '%s'\n", pc[1]);
+        var->v=*--sp;
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(SET_NUM){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (!var) vm_error("error: varible '%s' not found\n", pc[1]);
+        var->v=*--sp;
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(SET_BOOL){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (!var) vm_error("error: variable '%s' not found for reassignment\n", pc[1]);
+        var->v=*--sp;
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(PRINT_NUM){
+        printf(*pc++ ? "%f\n" : "%f", value_num(*--sp));
+        DISPATCH();
+    }
+    CASE(PRINT_BOOL){
+        printf(*pc++ ? "%s\n" : "%s", value_bool(*--sp) ? "true" : "false");
+        DISPATCH();
+    }
+    CASE(PRINT_REF_NUM){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (var) printf(pc[1] ? "%f\n" : "%f", value_num(var->v));
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(PRINT_REF_BOOL){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (var) printf(pc[1] ? "%s\n" : "%s", value_bool(var->v) ? "true" : "false");
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(PRINT_VAR){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (var){
+            if (value_is_bool(var->v)){
+                printf("%s", value_bool(var->v) ? "true" : "false");
+            } else if (value_is_num(var->v)){
+                printf("%f", value_num(var->v));
+            }
+            if (pc[1]) printf("\n");
+        }
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(IF_VAR){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (!var) vm_error("error: variable '%s' not found in scope\n", pc[1]);
+        if (value_is_bool(var->v)){
+            *sp++=var->v;
+        } else if (value_is_num(var->v)){
+            *sp++=bool_value(value_num(var->v)!=0);
+        } else {
+            fprintf(stderr, "invalid type for if\n");
+            exit(EXIT_FAILURE);
+        }
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(IF_REF){
+        Slot* var = vm_lookup(refs+pc[0]);
+        if (!var) vm_error("error: variable '%s' not found in scope\n", pc[1]);
+        *sp++ = value_is_bool(var->v) ? var->v : bool_value(value_num(var->v)!=0);
+        pc+=2;
+        DISPATCH();
+    }
+    CASE(JUMP_FALSE){
+        if (*--sp==VAL_FALSE) pc=code+*pc;
+        else pc++;
+        DISPATCH();
+    }
+    CASE(JUMP){
+        pc=code+*pc;
+        DISPATCH();
+    }
+    CASE(LOOP_TEST){
+        if (value_num(refs[pc[0]]->v)>=value_num(consts[pc[1]])){//start->end runs start..end-1
+            pc=code+pc[2];
+        } else {
+            pc+=3;
+        }
+        DISPATCH();
+    }
+    CASE(LOOP_NEXT){
+        Slot* iter = refs[*pc++];
+        iter->v=num_value(value_num(iter->v)+1);
+        DISPATCH();
+    }
+    CASE(UNKNOWN){
+        printf("Unknown node type: %d\n", (int)*pc++);
+        DISPATCH();
+    }
+    CASE(NULL_STMT){
+        printf("Error: NULL node passed to execute\n");
+        DISPATCH();
+    }
+    CASE(FAIL){
+        fprintf(stderr, "%s", fail_msgs[*pc]);
+        exit(EXIT_FAILURE);
+    }
+    CASE(HALT){
+        free(stack);
+        return;
+    }
+
+#ifndef VM_COMPUTED_GOTO
+    }
+#endif
+}
+
+void vm_free(VmProgram* vm){
+    if (!vm) return;
+
+    free(vm->code);
+    free(vm->consts);
+    free(vm->refs);
+    free(vm->hoists);
+    free(vm->hoist_val);
+    free(vm->hoist_valid);
+    free(vm->inds);
+    free(vm);
+}
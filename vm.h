@@ -0,0 +1,45 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdint.h>
+
+#include "ast.h"
+
+//--engine=vm: the resolved, typechecked tree compiled to bytecode for a
+//stack machine. every scope has a single frame, so variable operands are
+//the slots themselves: a reference is a NULL-terminated run of candidate
+//slots (the one resolve() picked, then its outer links) and the first live
+//one is it, exactly like lookup_slot(). the stack holds Values like the
+//slots do. output and errors match execute()
+
+typedef struct {
+    uint32_t* code;//opcode words, each followed by its operands
+    size_t code_count;
+    size_t code_capacity;
+
+    Value* consts;
+    uint32_t const_count;
+    uint32_t const_capacity;
+
+    Slot** refs;//candidate runs, see above
+    uint32_t ref_count;
+    uint32_t ref_capacity;
+
+    NodeId* hoists;//HOIST nodes, their cache is hoist_val/hoist_valid
+    Value* hoist_val;
+    uint8_t* hoist_valid;
+    uint32_t hoist_count;
+    uint32_t hoist_capacity;
+
+    InductionData** inds;
+    uint32_t ind_count;
+    uint32_t ind_capacity;
+
+    uint32_t max_stack;
+} VmProgram;
+
+VmProgram* vm_compile(ASTNode* program);//after resolve() and typecheck()
+void vm_run(VmProgram* vm);
+void vm_free(VmProgram* vm);
+
+#endif
@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "watch.h"
+#include "ast.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolve.h"
+#include "typecheck.h"
+#include "optimize.h"
+#include "main.h"
+
+typedef struct {
+    size_t start;//leading whitespace and comments included
+    size_t end;
+    NodeId stmt;//0 if nothing parsed
+    size_t undo_mark;//undo log length before it ran
+    int raw;//not optimized yet, statements are type checked as written first
+} Segment;
+
+typedef struct {
+    char* source;//private copy, the file changes under us
+    size_t len;
+    Segment* segs;
+    size_t count;
+    size_t capacity;
+    NodeId program;
+    ExecutionContext* ctx;
+    size_t dirty;//first statement kept from running by type errors, SIZE_MAX if none
+    int opt_level;
+} WatchState;
+
+static double now_ms(){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000.0+t.tv_nsec/1e6;
+}
+
+static int read_copy(const char* filename, char** data, size_t* len){
+    Source src;
+    if (!load_source(filename, &src)) return 0;
+
+    *data=(char*)malloc(src.len+1);
+    if (!*data){
+        fprintf(stderr, "memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(*data, src.data, src.len);
+    (*data)[src.len]='\0';
+    *len=src.len;
+
+    free_source(&src);
+    return 1;
+}
+
+static void push_seg(Segment** segs, size_t* count, size_t* capacity, Segment s){
+    if (*count==*capacity){
+        *capacity = *capacity ? *capacity*2 : 256;
+        *segs=(Segment*)realloc(*segs, sizeof(Segment)*(*capacity));
+        if (!*segs){
+            fprintf(stderr, "memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    (*segs)[(*count)++]=s;
+}
+
+static int line_at(const char* s, size_t offset){
+    int line=1;
+    const char* end = s+offset;
+    while ((s = memchr(s, '\n', end-s))){
+        line++;
+        s++;
+    }
+
+    return line;
+}
+
+//first segment ending past offset
+static size_t seg_after(WatchState* w, size_t offset){
+    size_t lo=0, hi=w->count;
+    while (lo<hi){
+        size_t mid = (lo+hi)/2;
+        if (w->segs[mid].end>offset) hi=mid; else lo=mid+1;
+    }
+
+    return lo;
+}
+
+//the program's statements from the segments, resolved from the returned
+//index of the first one to run (statement from) on
+static int build_root(WatchState* w, size_t from){
+    ASTNode* program = ast_node(w->program);
+    ScopeData* root = program->val.scope;
+    root->stmt_count=0;
+    int first = 0;
+    for (size_t i=0; i<w->count; i++){
+        if (i==from) first=root->stmt_count;
+        if (w->segs[i].stmt) add_stmt_to_scope(w->program, w->segs[i].stmt);
+    }
+    if (from>=w->count) first=root->stmt_count;
+
+    //new top-level names can move the root frame, the log points into it
+    Slot* frame = root->frame;
+    uint32_t slots = root->slot_count;
+    resolve_from(program, first);
+    if (frame && root->frame!=frame) undo_rebase(w->ctx, frame, root->frame, slots);
+
+    return first;
+}
+
+//statements only depend on their own tokens, so everything before the first
+//changed byte is kept, and once a reparsed statement ends on an old statement
+//boundary inside the unchanged tail, the old statements after it are kept too.
+//takes src. returns the index of the first statement to run, or -1 on lexer
+//or type errors
+static long reparse(WatchState* w, char* src, size_t len){
+    size_t max = w->len<len ? w->len : len;
+    size_t pre=0;
+    while (pre<max && w->source[pre]==src[pre]) pre++;
+    size_t suf=0;
+    while (suf<max-pre && w->source[w->len-1-suf]==src[len-1-suf]) suf++;
+
+    size_t k = seg_after(w, pre);
+    size_t start = k ? w->segs[k-1].end : 0;
+    ptrdiff_t delta = (ptrdiff_t)len-(ptrdiff_t)w->len;
+
+    Lexer l = init_lexer_len(src, len);
+    l.curr=start;
+    l.line=line_at(src, start);
+    Parser* p = init_stream_parser(&l);
+
+    Segment* segs = NULL;
+    size_t count=0, capacity=0;
+    for (size_t i=0; i<k; i++) push_seg(&segs, &count, &capacity, w->segs[i]);
+
+    size_t reuse = w->count;//first old statement kept after the reparsed ones
+    size_t pos = start;
+    while (!parser_done(p)){
+        size_t end;
+        NodeId stmt = parse_next_stmt(p, &end);
+
+        Segment s = {pos, end, stmt, 0, 1};
+        push_seg(&segs, &count, &capacity, s);
+        pos=end;
+
+        if (end>=len-suf){
+            size_t j = seg_after(w, end-delta-1);
+            if (j<w->count && w->segs[j].end==end-delta && j+1>=k){
+                reuse=j+1;
+                break;
+            }
+        }
+    }
+
+    free_parser(p);
+
+    if (l.had_error){
+        fprintf(stderr, "lexer error at line %d: %s\n", l.line, l.error_msg);
+        free(segs);
+        free(src);
+        return -1;
+    }
+
+    size_t from = k<w->dirty ? k : w->dirty;
+    undo_to(w->ctx, from<w->count ? w->segs[from].undo_mark : w->ctx->undo->count);
+
+    for (size_t i=reuse; i<w->count; i++){
+        Segment s = w->segs[i];
+        s.start+=delta;
+        s.end+=delta;
+        push_seg(&segs, &count, &capacity, s);
+    }
+
+    free(w->segs);
+    w->segs=segs;
+    w->count=count;
+    w->capacity=capacity;
+
+    free(w->source);
+    w->source=src;
+    w->len=len;
+
+    ASTNode* program = ast_node(w->program);
+    int first = build_root(w, from);
+    int type_errors = typecheck_unoptimized(program, first);
+
+    //-O1 can drop code with type errors, so it only sees checked statements
+    if (!type_errors && w->opt_level>=1){
+        for (size_t i=0; i<w->count; i++){
+            if (!w->segs[i].raw) continue;
+            w->segs[i].stmt=optimize_stmt(w->segs[i].stmt, w->opt_level);
+            w->segs[i].raw=0;
+        }
+        first=build_root(w, from);
+    }
+
+    if (type_errors || typecheck_from(program, first)){
+        //nothing from here on runs, so each of them starts from the current state
+        for (size_t i=from; i<w->count; i++) w->segs[i].undo_mark=w->ctx->undo->count;
+        w->dirty=from;
+        fprintf(stderr, "[watch] type errors, not running\n");
+        return -1;
+    }
+
+    w->dirty=SIZE_MAX;
+    return (long)from;
+}
+
+static void run_from(WatchState* w, size_t k){
+    ExecutionContext* ctx = w->ctx;
+    ctx->curr_scope=ast_node(w->program)->val.scope;
+
+    for (size_t i=k; i<w->count; i++){
+        w->segs[i].undo_mark=undo_checkpoint(ctx);
+        if (w->segs[i].stmt) execute(ast_node(w->segs[i].stmt), ctx);
+    }
+
+    ctx->curr_scope=NULL;
+    fflush(stdout);
+}
+
+static int same_stat(struct stat* a, struct stat* b){
+    return a->st_ino==b->st_ino && a->st_size==b->st_size &&
+           a->st_mtim.tv_sec==b->st_mtim.tv_sec && a->st_mtim.tv_nsec==b->st_mtim.tv_nsec;
+}
+
+int watch_file(const char* filename, int opt_level){
+    WatchState w;
+    w.source=(char*)calloc(1, 1);
+    w.len=0;
+    w.segs=NULL;
+    w.count=0;
+    w.capacity=0;
+    w.program=create_program_node();
+    w.ctx=create_execution_context();
+    w.dirty=SIZE_MAX;
+    w.opt_level=opt_level;
+    enable_undo(w.ctx);
+
+    struct stat last;
+    memset(&last, 0, sizeof(last));
+    int first=1;
+
+    while (1){
+        struct stat st;
+        if (stat(filename, &st)<0 || (!first && same_stat(&st, &last))){
+            struct timespec pause = {0, WATCH_POLL_MS*1000000L};
+            nanosleep(&pause, NULL);
+            continue;
+        }
+        last=st;
+
+        double t0 = now_ms();
+
+        char* src;
+        size_t len;
+        if (!read_copy(filename, &src, &len)){
+            if (first) return EXIT_FAILURE;
+            continue;
+        }
+
+        if (!first && len==w.len && memcmp(src, w.source, len)==0){
+            free(src);
+            continue;
+        }
+
+        int changed_line = 1;
+        if (!first){
+            size_t pre=0;
+            while (pre<len && pre<w.len && src[pre]==w.source[pre]) pre++;
+            changed_line = line_at(src, pre);
+            printf("--- line %d changed ---\n", changed_line);
+        }
+        first=0;
+
+        long k = reparse(&w, src, len);
+        if (k<0) continue;
+
+        run_from(&w, (size_t)k);
+
+        fprintf(stderr, "[watch] ran %zu of %zu statements in %.2f ms\n", w.count-(size_t)k, w.count, now_ms()-t0);
+    }
+}
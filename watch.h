@@ -0,0 +1,12 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+//--watch: runs the file, then on every change relexes and reparses only the
+//top-level statements around the edit and re-executes from the first one
+//that changed, rolling variables back to their state before it
+
+#define WATCH_POLL_MS 50
+
+int watch_file(const char* filename, int opt_level);//returns only on errors
+
+#endif